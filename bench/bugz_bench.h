@@ -0,0 +1,38 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#ifndef __BUGZ_BENCH_H__
+#define __BUGZ_BENCH_H__
+
+#include <time.h>
+
+#include "bugz.h"
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* one JSON object per line, so results can be diffed between commits */
+static inline void bench_report(const char *name, int iterations, double seconds, double bytes) {
+    fprintf(stdout, "{\"name\": \"%s\", \"iterations\": %d, \"seconds\": %.6f", 
+                    name, iterations, seconds);
+    if (bytes > 0)
+        fprintf(stdout, ", \"bytes\": %.0f, \"mb_per_sec\": %.2f", 
+                        bytes, bytes / seconds / (1024 * 1024));
+    fprintf(stdout, "}\n");
+}
+
+#endif/*__BUGZ_BENCH_H__*/
@@ -0,0 +1,402 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+/*
+ * End-to-end benchmarks, subcommands run against bugz_mock_server
+ * replaying generated fixtures. Every iteration runs in a forked child
+ * so peak RSS (wait4) and allocation counts are per command.
+ *
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "bugz_bench.h"
+
+#define _subcommand_macro_(n,d) extern int bugz_##n##_main(int, char**);
+#include "bugz_cmd.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/*
+ * Allocation counting, malloc and friends are interposed for the whole
+ * process (libcurl and json-c included) and counted into shared memory.
+ */
+struct bench_counters_t {
+    unsigned long allocs;
+    unsigned long bytes;
+    double seconds;
+};
+static struct bench_counters_t *bench_counters = NULL;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static inline void bench_count(size_t size) {
+    if (bench_counters) {
+        __atomic_fetch_add(&bench_counters->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bench_counters->bytes, size, __ATOMIC_RELAXED);
+    }
+}
+
+void *malloc(size_t size) {
+    bench_count(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+    bench_count(nmemb * size);
+    return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    bench_count(size);
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#endif
+
+static char bench_dir[PATH_MAX / 2]; /* leaves room for the fixture names */
+static char bench_base[128];
+static pid_t bench_server = 0;
+static pid_t bench_parent = 0;
+
+/* deterministic filler, so fixtures are the same on every run */
+static unsigned int bench_seed = 12345;
+static inline unsigned int bench_rand(void) {
+    bench_seed = bench_seed * 1103515245u + 12345u;
+    return bench_seed >> 8;
+}
+
+static FILE *bench_fopen(const char *name) {
+    char path[PATH_MAX];
+    FILE *fp;
+    snprintf(path, sizeof(path), "%s/%s", bench_dir, name);
+    if ((fp = fopen(path, "w")) == NULL) {
+        fprintf(stderr, "ERROR: unable to write %s\n", path);
+        exit(1);
+    }
+    return fp;
+}
+
+static void bench_link(const char *replay, const char *name) {
+    char from[PATH_MAX], to[PATH_MAX];
+    snprintf(from, sizeof(from), "%s/%s", replay, name);
+    snprintf(to, sizeof(to), "%s/%s", bench_dir, name);
+    if (symlink(from, to) < 0) {
+        fprintf(stderr, "ERROR: unable to link %s\n", to);
+        exit(1);
+    }
+}
+
+static void bench_text(FILE *fp, int words) {
+    static const char *dict[] = {
+        "crash", "when", "opening", "the", "project", "file", "with", "an", "empty",
+        "toolbar", "regression", "since", "version", "patch", "attached", "please",
+        "review", "reproduced", "on", "linux", "and", "windows", "backtrace", "follows"
+    };
+    int i;
+    for (i=0; i<words; i++)
+        fprintf(fp, "%s%s", i ? (i % 13 == 0 ? "\\n" : " ") : "",
+                dict[bench_rand() % (sizeof(dict)/sizeof(dict[0]))]);
+}
+
+static size_t bench_size(const char *name) {
+    char path[PATH_MAX];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", bench_dir, name);
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static void bench_fixtures(const char *replay, int nsearch, int ncomments, long attachment) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char path[PATH_MAX];
+    FILE *fp;
+    long i;
+
+    snprintf(path, sizeof(path), "%s/rest/bug/attachment", bench_dir);
+    mkdir(path, 0700);
+    snprintf(path, sizeof(path), "%s/out", bench_dir);
+    mkdir(path, 0700);
+    bench_link(replay, "rest/bug/N");
+    bench_link(replay, "rest/bug/N.json");
+    bench_link(replay, "rest/bug/N.PUT.json");
+    bench_link(replay, "rest/bug/comment");
+    bench_link(replay, "rest/bug.POST.json");
+
+    fp = bench_fopen(".bugzrc");
+    fprintf(fp, "[default]\nbase = %s\nuser = bench@example.org\npassword = secret\n"
+                "columns = 80\nsearch_statuses = confirmed, in_progress, unconfirmed\n", bench_base);
+    fclose(fp);
+
+    fp = bench_fopen("rest/bug.json");
+    fprintf(fp, "{\"bugs\":[");
+    for (i=0; i<nsearch; i++) {
+        fprintf(fp, "%s{\"id\":%ld,\"summary\":\"", i ? "," : "", 100000 + i);
+        bench_text(fp, 8);
+        fprintf(fp, "\",\"status\":\"CONFIRMED\",\"resolution\":\"\",\"priority\":\"P%ld\","
+                    "\"severity\":\"normal\",\"product\":\"Widgets\",\"component\":\"Core\","
+                    "\"assigned_to\":\"dev%ld@example.org\",\"creator\":\"user%ld@example.org\","
+                    "\"creation_time\":\"2016-03-01T10:15:00Z\",\"last_change_time\":\"2016-03-09T08:01:12Z\"}",
+                    i % 5 + 1, i % 37, i % 101);
+    }
+    fprintf(fp, "],\"faults\":[]}");
+    fclose(fp);
+
+    fp = bench_fopen("rest/bug/7/comment.json");
+    fprintf(fp, "{\"bugs\":{\"7\":{\"comments\":[");
+    for (i=0; i<ncomments; i++) {
+        fprintf(fp, "%s{\"id\":%ld,\"bug_id\":7,\"count\":%ld,\"creator\":\"user%ld@example.org\","
+                    "\"time\":\"2016-03-01T10:15:00Z\",\"is_private\":false,\"text\":\"",
+                    i ? "," : "", 900000 + i, i, i % 101);
+        bench_text(fp, 60);
+        fprintf(fp, "\"}");
+    }
+    fprintf(fp, "]}},\"comments\":{}}");
+    fclose(fp);
+
+    fp = bench_fopen("rest/bug/attachment/9.json");
+    fprintf(fp, "{\"bugs\":{},\"attachments\":{\"9\":{\"id\":9,\"bug_id\":7,\"file_name\":\"bench.bin\","
+                "\"summary\":\"bench\",\"content_type\":\"application/octet-stream\",\"size\":%ld,"
+                "\"is_patch\":0,\"is_obsolete\":0,\"data\":\"", attachment);
+    for (i=0; i<attachment; i+=3) {
+        unsigned int v = bench_rand() & 0xffffff;
+        fputc(b64[(v >> 18) & 63], fp);
+        fputc(b64[(v >> 12) & 63], fp);
+        fputc(i + 1 < attachment ? b64[(v >> 6) & 63] : '=', fp);
+        fputc(i + 2 < attachment ? b64[v & 63] : '=', fp);
+    }
+    fprintf(fp, "\"}}}");
+    fclose(fp);
+
+    fp = bench_fopen("upload.bin");
+    for (i=0; i<attachment; i++)
+        fputc(bench_rand() & 0xff, fp);
+    fclose(fp);
+}
+
+static void bench_start_server(const char *server) {
+    int fds[2];
+    char line[64] = {0};
+    FILE *fp;
+
+    if (pipe(fds) < 0)
+        exit(1);
+    if ((bench_server = fork()) == 0) {
+        dup2(fds[1], 1);
+        close(fds[0]);
+        execl(server, server, "-q", bench_dir, (char *)NULL);
+        _exit(127);
+    }
+    close(fds[1]);
+    fp = fdopen(fds[0], "r");
+    if (bench_server < 0 || fgets(line, sizeof(line), fp) == NULL ||
+        strncmp(line, "port ", 5) != 0) {
+        fprintf(stderr, "ERROR: unable to start %s\n", server);
+        exit(1);
+    }
+    fclose(fp);
+    snprintf(bench_base, sizeof(bench_base), "http://127.0.0.1:%d", atoi(line + 5));
+}
+
+static void bench_cleanup(void) {
+    char cmd[PATH_MAX + 16];
+    if (getpid() != bench_parent) /* a command called exit() */
+        return;
+    if (bench_server > 0)
+        kill(bench_server, SIGTERM);
+    if (*bench_dir) {
+        snprintf(cmd, sizeof(cmd), "rm -rf '%s'", bench_dir);
+        if (system(cmd) != 0)
+            fprintf(stderr, "ERROR: unable to remove %s\n", bench_dir);
+    }
+}
+
+static int bench_startup(int argc, char **argv) {
+    char *password;
+    struct bugz_config_t *config = bugz_config();
+    bugz_get_base(config);
+    bugz_get_auth(config, &password);
+    bugz_config_free(config);
+    return 0;
+}
+
+struct bench_case_t {
+    const char *name;
+    int iterations;
+    int (*submain)(int argc, char **argv);
+    const char *argv[12];
+    const char *bytes; /* fixture whose size is the payload */
+};
+
+static int bench_compare(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void bench_run(const struct bench_case_t *bc, int scale) {
+    int i, argc, status, failures = 0, iterations = bc->iterations / scale;
+    double *times, total = 0, bytes = bc->bytes ? bench_size(bc->bytes) : 0;
+    unsigned long allocs = 0, allocated = 0;
+    long rss = 0;
+    char *argv[12];
+    struct rusage ru;
+    pid_t pid;
+
+    memset(&ru, 0, sizeof(ru));
+    if (iterations < 1)
+        iterations = 1;
+    times = (double *)calloc(iterations, sizeof(double));
+    for (argc=0; bc->argv[argc]; argc++)
+        argv[argc] = (char *)bc->argv[argc];
+    argv[argc] = NULL;
+
+    for (i=0; i<iterations; i++) {
+        memset(bench_counters, 0, sizeof(*bench_counters));
+        if ((pid = fork()) == 0) {
+            double start;
+            int retval, null = open("/dev/null", O_WRONLY);
+            dup2(null, 1);
+            dup2(null, 2);
+            if (chdir(bench_dir) < 0 || chdir("out") < 0)
+                _exit(1);
+            bench_counters->allocs = bench_counters->bytes = 0;
+            optind = 1;
+            start = bench_now();
+            retval = bc->submain(argc, argv);
+            bugz_sink_flush(&bugz_stdout);
+            bench_counters->seconds = bench_now() - start;
+            _exit(retval);
+        }
+        if (pid < 0 || wait4(pid, &status, 0, &ru) < 0 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0 || bench_counters->seconds <= 0) {
+            failures++;
+            times[i] = 0;
+        }
+        else
+            times[i] = bench_counters->seconds;
+        total += times[i];
+        allocs += bench_counters->allocs;
+        allocated += bench_counters->bytes;
+        if (ru.ru_maxrss > rss)
+            rss = ru.ru_maxrss;
+        if (bc->submain == bugz_attachment_main) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/out/bench.bin", bench_dir);
+            unlink(path);
+        }
+    }
+    qsort(times, iterations, sizeof(double), bench_compare);
+
+    fprintf(stdout, "{\"name\": \"%s\", \"iterations\": %d, \"failures\": %d, "
+                    "\"p50_ms\": %.3f, \"p99_ms\": %.3f, \"mean_ms\": %.3f, \"ops_per_sec\": %.2f",
+                    bc->name, iterations, failures,
+                    times[(iterations - 1) / 2] * 1e3,
+                    times[(int)((iterations - 1) * 0.99 + 0.5)] * 1e3,
+                    total / iterations * 1e3, total > 0 ? iterations / total : 0);
+    if (bytes > 0)
+        fprintf(stdout, ", \"bytes\": %.0f, \"mb_per_sec\": %.2f",
+                        bytes, total > 0 ? bytes * iterations / total / (1024 * 1024) : 0);
+    fprintf(stdout, ", \"peak_rss_kb\": %ld, \"allocs\": %lu, \"alloc_bytes\": %lu}\n",
+                    rss, allocs / iterations, allocated / iterations);
+    fflush(stdout);
+    free(times);
+}
+
+int main(int argc, char **argv) {
+    const char *server = "./bugz_mock_server", *replay = "replay";
+    char path[PATH_MAX], upload[PATH_MAX];
+    int i, opt, scale = 1;
+    long attachment = 100 * 1024 * 1024;
+
+    /* '+' as in bugz main, getopt keeps the ordering of its first call */
+    while ((opt = getopt(argc, argv, "+s:r:q")) != -1) {
+        switch (opt) {
+        case 's' :
+            server = optarg;
+            break;
+        case 'r' :
+            replay = optarg;
+            break;
+        case 'q' : /* quick run */
+            scale = 10;
+            attachment /= 10;
+            break;
+        default :
+            fprintf(stderr, "Usage: bugz_bench_e2e [-q] [-s bugz_mock_server] [-r replay]\n");
+            return 1;
+        }
+    }
+    if (realpath(replay, path) == NULL) {
+        fprintf(stderr, "ERROR: unable to find %s\n", replay);
+        return 1;
+    }
+    snprintf(bench_dir, sizeof(bench_dir), "%s/bugz_bench.XXXXXX", getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp");
+    if (mkdtemp(bench_dir) == NULL) {
+        fprintf(stderr, "ERROR: unable to create %s\n", bench_dir);
+        return 1;
+    }
+    bench_parent = getpid();
+    atexit(bench_cleanup);
+    bench_counters = (struct bench_counters_t *)mmap(NULL, sizeof(*bench_counters),
+                     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (bench_counters == MAP_FAILED)
+        return 1;
+
+    /* only the generated config is read */
+    setenv("HOME", bench_dir, 1);
+    snprintf(upload, sizeof(upload), "%s/rest", bench_dir);
+    mkdir(upload, 0700);
+    snprintf(upload, sizeof(upload), "%s/rest/bug", bench_dir);
+    mkdir(upload, 0700);
+    snprintf(upload, sizeof(upload), "%s/rest/bug/7", bench_dir);
+    mkdir(upload, 0700);
+    bench_start_server(server);
+    bench_fixtures(path, 10000, 20000, attachment);
+    snprintf(upload, sizeof(upload), "%s/upload.bin", bench_dir);
+
+    {
+        const struct bench_case_t cases[] = {
+            { "e2e_startup",     200, bench_startup,         { "bugz", "startup", NULL } },
+            { "e2e_get_small",   100, bugz_get_main,         { "bugz", "get", "42", NULL } },
+            { "e2e_get_huge",     10, bugz_get_main,         { "bugz", "get", "7", NULL },
+                                                             "rest/bug/7/comment.json" },
+            { "e2e_search_10k",   10, bugz_search_main,      { "bugz", "search", "bench", NULL },
+                                                             "rest/bug.json" },
+            { "e2e_attachment_download", 3, bugz_attachment_main, { "bugz", "attachment", "9", NULL },
+                                                             "rest/bug/attachment/9.json" },
+            { "e2e_attach_upload", 3, bugz_attach_main,      { "bugz", "attach", "-t", "bench", "-d", "bench",
+                                                               "42", upload, NULL },
+                                                             "upload.bin" },
+            { "e2e_modify_bulk", 100, bugz_modify_main,      { "bugz", "modify", "-s", "IN_PROGRESS",
+                                                               "-c", "bench", "42", NULL } },
+            { "e2e_post",        100, bugz_post_main,        { "bugz", "post", "--batch", "--product", "Widgets",
+                                                               "--component", "Core", "-t", "bench",
+                                                               "-d", "bench", NULL } },
+        };
+        for (i=0; i<sizeof(cases)/sizeof(cases[0]); i++)
+            bench_run(&cases[i], scale);
+    }
+    return 0;
+}
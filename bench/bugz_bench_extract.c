@@ -0,0 +1,188 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz_bench.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/* the fields listed by 'bugz search --show-status --show-priority --show-severity' */
+static const char *bench_fields[] = {
+    "id", "status", "priority", "severity", "assigned_to", "summary", NULL
+};
+
+/* search response as sent by Bugzilla, with escapes in the summaries */
+static char *bench_make_response(int count, size_t *len) {
+    int i;
+    size_t size = (size_t)count * 512 + 64, used = 0;
+    char *p = (char *)malloc(size);
+
+    used += sprintf(p + used, "{\"bugs\":[");
+    for (i=0; i<count; i++)
+        used += sprintf(p + used, "%s{\"id\":%d,\"summary\":\"Crash in \\\"loader\\\" when "
+                                  "opening project %d \\u2014 r\\u00e9sum\\u00e9\","
+                                  "\"status\":\"CONFIRMED\",\"resolution\":\"\",\"priority\":\"P%d\","
+                                  "\"severity\":\"normal\",\"product\":\"Widgets\",\"component\":\"Core\","
+                                  "\"assigned_to\":\"dev%d@example.org\",\"cc\":[\"qa@example.org\"],"
+                                  "\"creator\":\"user%d@example.org\",\"is_open\":true,"
+                                  "\"creation_time\":\"2016-03-01T10:15:00Z\","
+                                  "\"last_change_time\":\"2016-03-09T08:01:12Z\"}",
+                                  i ? "," : "", 100000 + i, i, i % 5 + 1, i % 37, i % 101);
+    used += sprintf(p + used, "],\"faults\":[]}");
+    *len = used;
+    return p;
+}
+
+static size_t bench_checksum;
+
+static int bench_value_callback(const struct bugz_value_t *values, void *userp) {
+    int i;
+    for (i=0; bench_fields[i]; i++)
+        bench_checksum += values[i].len;
+    return 0;
+}
+
+/* same fields out of a json-c document, as bugz_search_list_bugs() used to */
+static void bench_dom(const char *response) {
+    int i, j, n;
+    json_object *json, *bugs, *val;
+
+    json = json_tokener_parse(response);
+    json_object_object_get_ex(json, "bugs", &bugs);
+    n = json_object_array_length(bugs);
+    for (i=0; i<n; i++) {
+        json_object *bug = json_object_array_get_idx(bugs, i);
+        for (j=0; bench_fields[j]; j++) {
+            json_object_object_get_ex(bug, bench_fields[j], &val);
+            bench_checksum += strlen(json_object_get_string(val));
+        }
+    }
+    json_object_put(json);
+}
+
+/* whole response with one of the bugz_fetch_to_json() backends */
+static void bench_parse(const char *name, const char *response, size_t len, int iterations) {
+    int i;
+    double start;
+    char bench[64];
+    json_object *json;
+    const struct bugz_parser_t *parser = bugz_parser_get(name);
+
+    if (parser == NULL)
+        return; /* not built */
+    start = bench_now();
+    for (i=0; i<iterations; i++) {
+        parser->parse(response, len, &json);
+        json_object_put(json);
+    }
+    snprintf(bench, sizeof(bench), "parse_%s", name);
+    bench_report(bench, iterations, bench_now() - start, (double)len * iterations);
+}
+
+/* fed in the chunks curl usually hands to the write callback */
+static void bench_extract(const char *response, size_t len, const char *pattern) {
+    size_t i;
+    json_object *json;
+    struct bugz_extract_t *x = bugz_extract_new(pattern, bench_value_callback, NULL);
+
+    for (i=0; i<len; i+=CURL_MAX_WRITE_SIZE)
+        bugz_extract_feed(x, response + i, len - i < CURL_MAX_WRITE_SIZE ? len - i : CURL_MAX_WRITE_SIZE);
+    bugz_extract_free(x, &json);
+    json_object_put(json);
+}
+
+/* same fields collected into the search bug table and rendered from it */
+static void bench_table(const char *response, size_t len, const char *pattern, struct bugz_sink_t *sink) {
+    int r, c;
+    size_t i;
+    json_object *json;
+    struct bugz_table_t table;
+    const struct bugz_field_t *fields[BUGZ_EXTRACT_FIELDS];
+    struct bugz_extract_t *x;
+
+    for (c=0; bench_fields[c]; c++)
+        fields[c] = bugz_field_lookup(bench_fields[c], strlen(bench_fields[c]));
+    bugz_table_init(&table, fields, c);
+    x = bugz_extract_new(pattern, bugz_table_add, &table);
+    for (i=0; i<len; i+=CURL_MAX_WRITE_SIZE)
+        bugz_extract_feed(x, response + i, len - i < CURL_MAX_WRITE_SIZE ? len - i : CURL_MAX_WRITE_SIZE);
+    bugz_extract_free(x, &json);
+    json_object_put(json);
+    for (r=0; r<table.rows; r++) {
+        for (c=0; c<table.ncolumns; c++) {
+            const char *s = bugz_table_string(&table, r, c);
+            bench_checksum += strlen(s);
+            bugz_sink_printf(sink, " %-*s", table.columns[c].field->width, s);
+        }
+        bugz_sink_write(sink, "\n", 1);
+    }
+    bugz_table_free(&table);
+}
+
+int main(int argc, char **argv) {
+    int i, iterations = 10;
+    int count = argc > 1 ? atoi(argv[1]) : 20000;
+    double start;
+    size_t len, dom, sax, tab;
+    struct bugz_sink_t sink = { 0 };
+    char *response, pattern[256] = "bugs[*].{";
+
+    for (i=0; bench_fields[i]; i++) {
+        strcat(pattern, i ? "," : "");
+        strcat(pattern, bench_fields[i]);
+    }
+    strcat(pattern, "}");
+    response = bench_make_response(count, &len);
+
+    bench_parse("json-c", response, len, iterations);
+    bench_parse("simd", response, len, iterations);
+    if (bugz_parser_get("simd")) {
+        json_object *a, *b;
+        bugz_parser_get("json-c")->parse(response, len, &a);
+        bugz_parser_get("simd")->parse(response, len, &b);
+        if (strcmp(json_object_to_json_string(a), json_object_to_json_string(b)))
+            fprintf(stderr, "ERROR: parse backends differ\n");
+        json_object_put(a);
+        json_object_put(b);
+    }
+
+    bench_checksum = 0;
+    start = bench_now();
+    for (i=0; i<iterations; i++)
+        bench_dom(response);
+    bench_report("search_dom", iterations, bench_now() - start, (double)len * iterations);
+    dom = bench_checksum;
+
+    bench_checksum = 0;
+    start = bench_now();
+    for (i=0; i<iterations; i++)
+        bench_extract(response, len, pattern);
+    bench_report("search_extract", iterations, bench_now() - start, (double)len * iterations);
+    sax = bench_checksum;
+
+    bench_checksum = 0;
+    sink.fp = fopen("/dev/null", "w");
+    start = bench_now();
+    for (i=0; i<iterations; i++)
+        bench_table(response, len, pattern, &sink);
+    bugz_sink_flush(&sink);
+    bench_report("search_table", iterations, bench_now() - start, (double)len * iterations);
+    tab = bench_checksum;
+    fclose(sink.fp);
+
+    if (dom != sax || dom != tab)
+        fprintf(stderr, "ERROR: extracted %lu and %lu bytes, expected %lu\n",
+                        (unsigned long)sax, (unsigned long)tab, (unsigned long)dom);
+    free(response);
+    return 0;
+}
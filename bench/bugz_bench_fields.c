@@ -0,0 +1,71 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz_bench.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/* a bug with every field of bugz_fields.h set, plus one unknown field */
+static json_object *bench_make_bug(void) {
+    int i;
+    json_object *bug = json_object_new_object();
+    for (i=0; i<bugz_field_end; i++) {
+        const struct bugz_field_t *field = &bugz_fields[i];
+        if (field->format == bugz_field_format_list ||
+            field->format == bugz_field_format_lines) {
+            json_object *array = json_object_new_array();
+            json_object_array_add(array, json_object_new_string("first@example.com"));
+            json_object_array_add(array, json_object_new_string("second@example.com"));
+            json_object_object_add(bug, field->name, array);
+        }
+        else
+            json_object_object_add(bug, field->name, json_object_new_string("value"));
+    }
+    json_object_object_add(bug, "cf_custom_field", json_object_new_string("custom"));
+    return bug;
+}
+
+int main(int argc, char **argv) {
+    int i, j, iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    double start, seconds;
+    size_t found = 0;
+    json_object *bug;
+    struct bugz_sink_t sink = { 0 };
+
+    bugz_arguments.columns = 80;
+    if ((sink.fp = fopen("/dev/null", "wb")) == NULL)
+        return 1;
+    bug = bench_make_bug();
+
+    start = bench_now();
+    for (i=0; i<iterations; i++) {
+        for (j=0; j<bugz_field_end; j++)
+            found += bugz_field_lookup(bugz_fields[j].name, strlen(bugz_fields[j].name)) != NULL;
+    }
+    seconds = bench_now() - start;
+    bench_report("field_lookup", iterations * bugz_field_end, seconds, 0);
+    if (found != (size_t)iterations * bugz_field_end)
+        fprintf(stderr, "ERROR: field lookup failed\n");
+
+    start = bench_now();
+    for (i=0; i<iterations; i++)
+        bugz_render_bug_info(&sink, bug, NULL, NULL);
+    bugz_sink_flush(&sink);
+    seconds = bench_now() - start;
+    bench_report("render_bug_fields", iterations, seconds, 0);
+
+    json_object_put(bug);
+    fclose(sink.fp);
+    return 0;
+}
@@ -0,0 +1,78 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "bugz_bench.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/* a log piped into 'bugz post', written by a child process */
+static pid_t bench_writer(size_t bytes, int *fd) {
+    int fds[2];
+    pid_t pid;
+    size_t i, n;
+    char block[64 * 1024];
+
+    for (i=0; i<sizeof(block); i++)
+        block[i] = i % 64 == 63 ? '\n' : 'a' + i % 26;
+    if (pipe(fds) < 0 || (pid = fork()) < 0)
+        return -1;
+    if (pid == 0) {
+        close(fds[0]);
+        for (i=0; i<bytes; i+=n) {
+            n = bytes - i < sizeof(block) ? bytes - i : sizeof(block);
+            if (write(fds[1], block, n) != (ssize_t)n)
+                _exit(1);
+        }
+        _exit(0);
+    }
+    close(fds[1]);
+    *fd = fds[0];
+    return pid;
+}
+
+int main(int argc, char **argv) {
+    int fd, in, status;
+    pid_t pid;
+    char *p, bench[64];
+    double start, seconds;
+    size_t mb, len, max = argc > 1 ? (size_t)atoi(argv[1]) : 1024;
+
+    signal(SIGPIPE, SIG_IGN);
+    if ((in = dup(STDIN_FILENO)) < 0)
+        return 1;
+    /* MB/s staying flat from 1 MB to 1 GB is linear time */
+    for (mb=1; mb<=max; mb*=4) {
+        if ((pid = bench_writer(mb << 20, &fd)) < 0)
+            return 1;
+        dup2(fd, STDIN_FILENO);
+        close(fd);
+        start = bench_now();
+        p = bugz_raw_input(NULL);
+        seconds = bench_now() - start;
+        len = strlen(p);
+        free(p);
+        waitpid(pid, &status, 0);
+        snprintf(bench, sizeof(bench), "raw_input_%luMB", (unsigned long)mb);
+        bench_report(bench, 1, seconds, (double)(mb << 20));
+        if (len != mb << 20)
+            fprintf(stderr, "ERROR: read %lu bytes, expected %lu\n",
+                            (unsigned long)len, (unsigned long)(mb << 20));
+        fflush(stdout);
+    }
+    dup2(in, STDIN_FILENO);
+    return 0;
+}
@@ -0,0 +1,102 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz_bench.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/*
+ * Synthetic bug with many comments: short notes, long paragraphs,
+ * pasted logs with unbroken lines and some multibyte text.
+ */
+static json_object *bench_make_comments(int count) {
+    int i, j;
+    char *text;
+    json_object *comments = json_object_new_array();
+    const char *words[] = {"segfault", "in", "the", "allocator", "when", "résumé",
+                           "日本語", "backtrace", "follows", "0x7f3a2c001000"};
+
+    text = (char *)malloc(64 * 1024);
+    for (i=0; i<count; i++) {
+        json_object *comment = json_object_new_object();
+        size_t len = 0;
+        switch (i % 4) {
+        case 0 :
+            len = sprintf(text, "Comment %d, confirmed on my machine.", i);
+            break;
+        case 1 :
+            for (j=0; j<400; j++)
+                len += sprintf(text + len, "%s ", words[(i + j) % 10]);
+            break;
+        case 2 :
+            for (j=0; j<200; j++)
+                len += sprintf(text + len, "[%06d] kernel: worker/%d stalled for %dms at "
+                                           "/usr/src/linux/kernel/sched/core.c:%d\n",
+                                           j, j % 8, j * 3, 4000 + j);
+            break;
+        case 3 :
+            for (j=0; j<2000; j++)
+                text[len++] = "0123456789abcdef"[j % 16];
+            text[len] = '\0';
+            break;
+        }
+        json_object_object_add(comment, "creator", json_object_new_string("dev@example.com"));
+        json_object_object_add(comment, "time", json_object_new_string("2018-10-06T12:00:00Z"));
+        json_object_object_add(comment, "text", json_object_new_string_len(text, len));
+        json_object_array_add(comments, comment);
+    }
+    free(text);
+    return comments;
+}
+
+static json_object *bench_make_bug(void) {
+    json_object *bug = json_object_new_object();
+    json_object_object_add(bug, "id", json_object_new_int(1));
+    json_object_object_add(bug, "summary", json_object_new_string("Synthetic bug with many comments"));
+    json_object_object_add(bug, "status", json_object_new_string("NEW"));
+    json_object_object_add(bug, "priority", json_object_new_string("P2"));
+    json_object_object_add(bug, "assigned_to", json_object_new_string("dev@example.com"));
+    return bug;
+}
+
+int main(int argc, char **argv) {
+    int i, iterations = 5;
+    int count = argc > 1 ? atoi(argv[1]) : 10000;
+    double start, bytes = 0;
+    json_object *bug, *comments;
+    struct bugz_sink_t sink = { 0 };
+
+    bugz_arguments.columns = 80;
+    if ((sink.fp = fopen("/dev/null", "wb")) == NULL)
+        return 1;
+    bug = bench_make_bug();
+    comments = bench_make_comments(count);
+    for (i=0; i<count; i++) {
+        json_object *text;
+        json_object_object_get_ex(json_object_array_get_idx(comments, i), "text", &text);
+        bytes += json_object_get_string_len(text);
+    }
+
+    start = bench_now();
+    for (i=0; i<iterations; i++) {
+        bugz_render_bug_info(&sink, bug, NULL, comments);
+        bugz_sink_flush(&sink);
+    }
+    bench_report("render_comments", iterations, bench_now() - start, bytes * iterations);
+
+    json_object_put(comments);
+    json_object_put(bug);
+    fclose(sink.fp);
+    return 0;
+}
@@ -0,0 +1,162 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz.h"
+
+struct bugz_arguments_t bugz_arguments = { 0 };
+
+/*
+ * Randomized cross-check of the simd parser against json-c, valid
+ * documents must give the same tree, corrupted ones must not be
+ * accepted by simd unless json-c accepts them the same way. Skipped
+ * (exit 77) when built without --enable-simd-json.
+ *
+ */
+#define CHECK_ITERATIONS 200000
+
+static unsigned long long check_state = 88172645463325252ULL;
+static char check_buf[1 << 20];
+static size_t check_used;
+
+static unsigned check_random(unsigned n) {
+    check_state ^= check_state << 13;
+    check_state ^= check_state >> 7;
+    check_state ^= check_state << 17;
+    return (unsigned)(check_state % n);
+}
+
+static void check_put(const char *s) {
+    size_t n = strlen(s);
+    if (check_used + n < sizeof(check_buf)) {
+        memcpy(check_buf + check_used, s, n);
+        check_used += n;
+    }
+}
+
+static void check_space(void) {
+    static const char *spaces[] = { "", "", " ", "\n  ", "\t", "\r\n" };
+    check_put(spaces[check_random(6)]);
+}
+
+/* escapes, surrogate pairs and raw UTF-8 */
+static void check_string(void) {
+    static const char *parts[] = {
+        "abc", "\\\"", "\\\\", "\\n", "\\u00e9", "\\ud83d\\ude00", "\\/", "x y",
+        "\\\\\\\"", "\xe6\x97\xa5\xe6\x9c\xac", "\\u0041", "\\t\\r\\b\\f"
+    };
+    int i, n = check_random(6);
+
+    check_put("\"");
+    for (i=0; i<n; i++)
+        check_put(parts[check_random(12)]);
+    check_put("\"");
+}
+
+static void check_value(int depth) {
+    static const char *numbers[] = { "0", "-1", "123456789", "9007199254740993", "42", "-0" };
+    int i, n;
+
+    switch (depth > 5 ? check_random(4) : check_random(7)) {
+    case 0 :
+        check_put(numbers[check_random(6)]);
+        break;
+    case 1 :
+        check_put(check_random(2) ? "true" : "false");
+        break;
+    case 2 :
+        check_put("null");
+        break;
+    case 3 :
+        check_string();
+        break;
+    case 4 :
+    case 6 :
+        check_put("{");
+        for (i=0, n=check_random(5); i<n; i++) {
+            if (i)
+                check_put(",");
+            check_space();
+            check_string();
+            check_space();
+            check_put(":");
+            check_space();
+            check_value(depth + 1);
+            check_space();
+        }
+        check_put("}");
+        break;
+    case 5 :
+        check_put("[");
+        for (i=0, n=check_random(5); i<n; i++) {
+            if (i)
+                check_put(",");
+            check_space();
+            check_value(depth + 1);
+            check_space();
+        }
+        check_put("]");
+        break;
+    }
+}
+
+/* one character replaced, and sometimes cut short */
+static void check_corrupt(void) {
+    static const char chars[] = "{}[]\",:\\ a0";
+    size_t k = check_random(check_used ? check_used : 1);
+
+    check_buf[k] = chars[check_random(sizeof(chars) - 1)];
+    if (check_random(3) == 0)
+        check_used = check_random(check_used + 1);
+}
+
+static int check_same(json_object *a, json_object *b) {
+    return strcmp(json_object_to_json_string_ext(a, JSON_C_TO_STRING_PLAIN),
+                  json_object_to_json_string_ext(b, JSON_C_TO_STRING_PLAIN)) == 0;
+}
+
+int main(int argc, char **argv) {
+    const struct bugz_parser_t *reference = bugz_parser_get("json-c");
+    const struct bugz_parser_t *simd = bugz_parser_get("simd");
+    int i, corrupt, ok_reference, ok_simd, failures = 0;
+    json_object *a, *b;
+
+    if (simd == NULL) {
+        fprintf(stderr, "%s: built without --enable-simd-json, skipped\n", argv[0]);
+        return 77;
+    }
+    for (i=0; i<CHECK_ITERATIONS; i++) {
+        check_used = 0;
+        check_space();
+        check_value(0);
+        check_space();
+        if ((corrupt = i % 2))
+            check_corrupt();
+        check_buf[check_used] = '\0';
+
+        ok_reference = reference->parse(check_buf, check_used, &a);
+        ok_simd = simd->parse(check_buf, check_used, &b);
+        if ((!corrupt && (!ok_reference || !ok_simd || !check_same(a, b))) ||
+            (corrupt && ok_simd && (!ok_reference || !check_same(a, b)))) {
+            if (failures++ < 5)
+                fprintf(stderr, "%s: %s document, json-c %s, simd %s:\n%s\n", argv[0],
+                                corrupt ? "corrupted" : "valid",
+                                ok_reference ? "accepted" : "rejected",
+                                ok_simd ? "accepted" : "rejected", check_buf);
+        }
+        json_object_put(a);
+        json_object_put(b);
+    }
+    fprintf(stdout, "%d documents, %d mismatches\n", CHECK_ITERATIONS, failures);
+    return failures ? 1 : 0;
+}
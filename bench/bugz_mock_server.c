@@ -0,0 +1,606 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+/*
+ * Local stand-in for a Bugzilla REST server, replays recorded responses
+ * from a directory so bugz can be measured without a network:
+ *
+ *   GET  /rest/bug/42/comment  ->  DIR/rest/bug/42/comment.json
+ *                              or  DIR/rest/bug/N/comment.json
+ *   PUT  /rest/bug/42          ->  DIR/rest/bug/42.PUT.json
+ *                              or  DIR/rest/bug/N.PUT.json
+ *
+ * Numeric path components fall back to N, in such a template every
+ * "@ID@" is replaced by the first numeric component of the request.
+ * Of the query string only include_fields and exclude_fields are used,
+ * they filter the members of the records (objects with an "id") as
+ * Bugzilla does. Request bodies are read and dropped.
+ *
+ */
+#define _GNU_SOURCE /* memmem */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define MOCK_HEADER_MAX (64 * 1024)
+#define MOCK_FIELDS_MAX 1024
+
+struct mock_arguments_t {
+    const char *root;
+    int port;
+    int latency;     /* ms before each response */
+    long bandwidth;  /* bytes per second per connection, 0 for unlimited */
+    double errors;   /* fraction of requests that fail */
+    int status;      /* status of failed requests, 0 to drop the connection */
+    unsigned int seed;
+    int quiet;
+};
+static struct mock_arguments_t mock_arguments = { ".", 0, 0, 0, 0.0, 500, 1, 0 };
+
+static void mock_helper(int status) {
+    fprintf(stderr,
+       "Usage: bugz_mock_server [options] DIR\n"
+       "Replay recorded Bugzilla REST responses found in DIR\n"
+       "\n"
+       "Valid options:\n"
+       "-h [--help]             : show this help message and exit\n"
+       "-p [--port] PORT        : listen on 127.0.0.1:PORT (default: any free port)\n"
+       "-l [--latency] MS       : delay each response by MS milliseconds\n"
+       "-b [--bandwidth] BYTES  : limit each connection to BYTES per second\n"
+       "-e [--errors] RATE      : fail this fraction (0 to 1) of the requests\n"
+       "-E [--error-status] CODE: HTTP status of failed requests (default: 500),\n"
+       "                          0 drops the connection instead\n"
+       "-s [--seed] SEED        : seed of the error injection\n"
+       "-q [--quiet]            : do not log requests\n"
+       "\n"
+       "The port is written as 'port PORT' on stdout once listening.\n");
+    exit(status);
+}
+
+static int mock_write(int fd, const char *data, size_t len) {
+    ssize_t n;
+    while (len > 0) {
+        if ((n = write(fd, data, len)) < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+static double mock_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* body of a response, paced to --bandwidth */
+static int mock_send_body(int fd, const char *data, size_t len) {
+    double start, due;
+    size_t sent = 0, chunk;
+
+    if (mock_arguments.bandwidth <= 0)
+        return mock_write(fd, data, len);
+    chunk = mock_arguments.bandwidth / 100 + 1; /* about 10ms worth */
+    start = mock_now();
+    while (sent < len) {
+        size_t n = len - sent < chunk ? len - sent : chunk;
+        if (mock_write(fd, data + sent, n) < 0)
+            return -1;
+        sent += n;
+        due = start + (double)sent / mock_arguments.bandwidth - mock_now();
+        if (due > 0)
+            usleep((useconds_t)(due * 1e6));
+    }
+    return 0;
+}
+
+static int mock_send(int fd, int status, const char *data, size_t len, int keepalive) {
+    char header[256];
+    const char *reason = status == 200 ? "OK" : status == 404 ? "Not Found" :
+                         status < 500 ? "Bad Request" : "Internal Server Error";
+    int n = snprintf(header, sizeof(header),
+                     "HTTP/1.1 %d %s\r\n"
+                     "Content-Type: application/json; charset=utf-8\r\n"
+                     "Content-Length: %lu\r\n"
+                     "Connection: %s\r\n\r\n",
+                     status, reason, (unsigned long)len, keepalive ? "keep-alive" : "close");
+    if (mock_write(fd, header, n) < 0)
+        return -1;
+    return mock_send_body(fd, data, len);
+}
+
+static int mock_send_error(int fd, int status, const char *message, int keepalive) {
+    char body[512];
+    int n = snprintf(body, sizeof(body),
+                     "{\"error\":true,\"code\":%d,\"message\":\"%s\",\"documentation\":null}",
+                     status == 404 ? 32614 : 32000, message);
+    return mock_send(fd, status, body, n, keepalive);
+}
+
+/* comma separated, empty when not given */
+struct mock_fields_t {
+    char include[MOCK_FIELDS_MAX];
+    char exclude[MOCK_FIELDS_MAX];
+};
+
+static void mock_decode(char *list, const char *p, const char *end) {
+    size_t n = strlen(list);
+    if (n && n < MOCK_FIELDS_MAX - 1)
+        list[n++] = ',';
+    for (; p < end && n < MOCK_FIELDS_MAX - 1; p++) {
+        if (*p == '%' && end - p > 2 && isxdigit((unsigned char)p[1]) && isxdigit((unsigned char)p[2])) {
+            char hex[3] = { p[1], p[2], 0 };
+            list[n++] = (char)strtol(hex, NULL, 16);
+            p += 2;
+        }
+        else
+            list[n++] = *p == '+' ? ' ' : *p;
+    }
+    list[n] = '\0';
+}
+
+static int mock_fields_parse(struct mock_fields_t *f, const char *target) {
+    const char *p = strchr(target, '?'), *q;
+
+    f->include[0] = f->exclude[0] = '\0';
+    for (; p && *p && *p != '#'; p = q) {
+        for (q = ++p; *q && *q != '&' && *q != '#'; q++)
+            ;
+        if (strncmp(p, "include_fields=", 15) == 0)
+            mock_decode(f->include, p + 15, q);
+        else if (strncmp(p, "exclude_fields=", 15) == 0)
+            mock_decode(f->exclude, p + 15, q);
+    }
+    /* _default, _all and _extra select groups of fields, keep them all */
+    if (f->include[0] == '_' || strstr(f->include, ",_"))
+        f->include[0] = '\0';
+    return f->include[0] || f->exclude[0];
+}
+
+/* key (quoted) is in list, "flags.name" counts as flags */
+static int mock_fields_listed(const char *list, const char *key, size_t len) {
+    const char *p, *q;
+    key++;
+    len -= 2;
+    for (p = list; *p; p = *q ? q + 1 : q) {
+        for (q = p; *q && *q != ','; q++)
+            ;
+        if ((size_t)(q - p) >= len && memcmp(p, key, len) == 0 &&
+            ((size_t)(q - p) == len || p[len] == '.'))
+            return 1;
+    }
+    return 0;
+}
+
+static size_t mock_space(const char *s, size_t i, size_t n) {
+    while (i < n && isspace((unsigned char)s[i]))
+        i++;
+    return i;
+}
+
+/* end of the value at i */
+static size_t mock_skip(const char *s, size_t i, size_t n) {
+    int depth = 0;
+    do {
+        if (s[i] == '"') { /* closing quote, not preceded by an odd run of backslashes */
+            const char *q;
+            size_t b;
+            for (i++; (q = (const char *)memchr(s + i, '"', n - i)); i++) {
+                i = q - s;
+                for (b = 0; s[i - b - 1] == '\\'; b++)
+                    ;
+                if (b % 2 == 0)
+                    break;
+            }
+            if (q == NULL)
+                return n;
+        }
+        else if (s[i] == '{' || s[i] == '[')
+            depth++;
+        else if (s[i] == '}' || s[i] == ']')
+            depth--;
+        else if (depth == 0) {
+            while (i + 1 < n && !strchr(",}] \t\r\n", s[i + 1]))
+                i++;
+        }
+        i++;
+    } while (i < n && depth > 0);
+    return i < n ? i : n;
+}
+
+/*
+ * Copy of the value at i without the filtered members of records,
+ * whitespace between tokens is dropped. Returns the end of the value.
+ * record is 2 for the members of a record, 1 below them.
+ */
+static size_t mock_filter(const char *s, size_t i, size_t n, char *out, size_t *o,
+                          const struct mock_fields_t *f, int record) {
+    size_t k, ke, v;
+    int first = 1;
+    char c = s[i], close = c == '{' ? '}' : ']';
+
+    if (c != '{' && c != '[') {
+        k = mock_skip(s, i, n);
+        memcpy(out + *o, s + i, k - i);
+        *o += k - i;
+        return k;
+    }
+    if (c == '{' && !record) { /* is this a record */
+        for (k = mock_space(s, i + 1, n); k < n && s[k] == '"'; ) {
+            ke = mock_skip(s, k, n);
+            if (ke - k == 4 && memcmp(s + k, "\"id\"", 4) == 0) {
+                record = 2;
+                break;
+            }
+            k = mock_skip(s, mock_space(s, mock_space(s, ke, n) + 1, n), n);
+            k = mock_space(s, k, n);
+            if (k < n && s[k] == ',')
+                k = mock_space(s, k + 1, n);
+        }
+    }
+    out[(*o)++] = c;
+    for (i = mock_space(s, i + 1, n); i < n && s[i] != close; ) {
+        int keep = 1;
+        k = ke = i;
+        if (c == '{') {
+            ke = mock_skip(s, k, n);
+            if (record == 2)
+                keep = (!f->include[0] || mock_fields_listed(f->include, s + k, ke - k)) &&
+                       !mock_fields_listed(f->exclude, s + k, ke - k);
+            i = mock_space(s, mock_space(s, ke, n) + 1, n);
+        }
+        if (keep) {
+            if (!first)
+                out[(*o)++] = ',';
+            first = 0;
+            if (c == '{') {
+                memcpy(out + *o, s + k, ke - k);
+                *o += ke - k;
+                out[(*o)++] = ':';
+            }
+            v = mock_filter(s, i, n, out, o, f, record ? 1 : 0);
+        }
+        else
+            v = mock_skip(s, i, n);
+        i = mock_space(s, v, n);
+        if (i < n && s[i] == ',')
+            i = mock_space(s, i + 1, n);
+    }
+    out[(*o)++] = close;
+    return i < n ? i + 1 : n;
+}
+
+/*
+ * File for method and target, numeric components are tried as is and
+ * then as N. The first numeric component is returned in id.
+ */
+static int mock_open(const char *method, const char *target, char *id, size_t idlen, int *templated) {
+    char path[PATH_MAX], generic[PATH_MAX];
+    const char *suffix = strcmp(method, "GET") == 0 ? "" : method;
+    const char *p, *q;
+    size_t n = 0, g = 0;
+    int fd;
+
+    *id = '\0';
+    *templated = 0;
+    for (p = target; *p && *p != '?' && *p != '#'; p = q) {
+        for (q = p + 1; *q && *q != '/' && *q != '?' && *q != '#'; q++)
+            ;
+        if (q - p == 1) /* empty component, e.g. base//rest */
+            continue;
+        if (n + (q - p) + 1 >= sizeof(path) || g + (q - p) + 1 >= sizeof(generic))
+            return -1;
+        memcpy(path + n, p, q - p);
+        n += q - p;
+        if (*p == '/' && q - p > 1 && strspn(p + 1, "0123456789") >= (size_t)(q - p - 1)) {
+            if (*id == '\0' && (size_t)(q - p) <= idlen) {
+                memcpy(id, p + 1, q - p - 1);
+                id[q - p - 1] = '\0';
+            }
+            memcpy(generic + g, "/N", 2);
+            g += 2;
+        }
+        else {
+            if (strstr(p, "..") == p + 1) /* stay inside the root */
+                return -1;
+            memcpy(generic + g, p, q - p);
+            g += q - p;
+        }
+    }
+    path[n] = generic[g] = '\0';
+    if (n == 0)
+        return -1;
+
+    snprintf(path + n, sizeof(path) - n, "%s%s.json", *suffix ? "." : "", suffix);
+    snprintf(generic + g, sizeof(generic) - g, "%s%s.json", *suffix ? "." : "", suffix);
+    if ((fd = open(path + 1, O_RDONLY)) >= 0)
+        return fd;
+    if ((fd = open(generic + 1, O_RDONLY)) >= 0)
+        *templated = 1;
+    return fd;
+}
+
+/* read and drop a request body, chunked or of a known length */
+static int mock_drain(int fd, char *buf, size_t *have, long long length, int chunked) {
+    char tmp[64 * 1024];
+    ssize_t n;
+
+    for (;;) {
+        if (chunked) {
+            char *eol;
+            while ((eol = memchr(buf, '\n', *have)) == NULL) {
+                if (*have >= MOCK_HEADER_MAX - 1 ||
+                   (n = read(fd, buf + *have, MOCK_HEADER_MAX - 1 - *have)) <= 0)
+                    return -1;
+                *have += n;
+            }
+            length = strtoll(buf, NULL, 16);
+            *have -= eol + 1 - buf;
+            memmove(buf, eol + 1, *have);
+            length += 2; /* CRLF after the data */
+            if (length == 2) { /* last chunk, no trailers expected */
+                while (*have < 2) {
+                    if ((n = read(fd, buf + *have, MOCK_HEADER_MAX - 1 - *have)) <= 0)
+                        return -1;
+                    *have += n;
+                }
+                *have -= 2;
+                memmove(buf, buf + 2, *have);
+                return 0;
+            }
+        }
+        if ((long long)*have >= length) {
+            *have -= length;
+            memmove(buf, buf + length, *have);
+            length = 0;
+        }
+        else {
+            length -= *have;
+            *have = 0;
+            while (length > 0) {
+                if ((n = read(fd, tmp, length < (long long)sizeof(tmp) ? length : (long long)sizeof(tmp))) <= 0)
+                    return -1;
+                length -= n;
+            }
+        }
+        if (!chunked)
+            return 0;
+    }
+}
+
+static void mock_connection(int fd, unsigned int seed) {
+    char *buf = (char *)malloc(MOCK_HEADER_MAX);
+    size_t have = 0;
+
+    while (buf) {
+        char method[16] = {0}, target[4096] = {0}, id[32], *end, *h;
+        long long length = 0;
+        int chunked = 0, keepalive = 1, templated, rfd, status = 200;
+        size_t hlen, size = 0;
+        ssize_t n;
+        struct stat st;
+        char *data = NULL;
+
+        while ((end = memmem(buf, have, "\r\n\r\n", 4)) == NULL) {
+            if (have >= MOCK_HEADER_MAX - 1 ||
+               (n = read(fd, buf + have, MOCK_HEADER_MAX - 1 - have)) <= 0)
+                goto done;
+            have += n;
+        }
+        hlen = end + 4 - buf;
+        *end = '\0';
+        if (sscanf(buf, "%15s %4095s", method, target) != 2)
+            goto done;
+        for (h = strstr(buf, "\r\n"); h; h = strstr(h + 2, "\r\n")) {
+            if (strncasecmp(h + 2, "Content-Length:", 15) == 0)
+                length = strtoll(h + 17, NULL, 10);
+            else if (strncasecmp(h + 2, "Transfer-Encoding:", 18) == 0 && strstr(h + 20, "chunked"))
+                chunked = 1;
+            else if (strncasecmp(h + 2, "Connection:", 11) == 0 && strstr(h + 13, "close"))
+                keepalive = 0;
+            else if (strncasecmp(h + 2, "Expect:", 7) == 0 && strstr(h + 9, "100-continue"))
+                mock_write(fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+        }
+        have -= hlen;
+        memmove(buf, buf + hlen, have);
+        if ((length > 0 || chunked) && mock_drain(fd, buf, &have, length, chunked) < 0)
+            goto done;
+
+        if (mock_arguments.latency > 0)
+            usleep(mock_arguments.latency * 1000);
+        if (mock_arguments.errors > 0 && rand_r(&seed) < mock_arguments.errors * ((double)RAND_MAX + 1)) {
+            if (!mock_arguments.quiet)
+                fprintf(stderr, "%s %s -> injected %d\n", method, target, mock_arguments.status);
+            if (mock_arguments.status == 0)
+                goto done;
+            if (mock_send_error(fd, mock_arguments.status, "injected error", keepalive) < 0)
+                goto done;
+            continue;
+        }
+
+        if ((rfd = mock_open(method, target, id, sizeof(id), &templated)) < 0 ||
+            fstat(rfd, &st) < 0) {
+            status = 404;
+            if (mock_send_error(fd, 404, "no recorded response", keepalive) < 0)
+                goto done;
+        }
+        else {
+            struct mock_fields_t fields;
+            char *body, *t = NULL;
+            size = st.st_size;
+            if (size > 0 && (data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, rfd, 0)) == MAP_FAILED)
+                data = NULL, size = 0;
+            body = data ? data : "";
+            if (templated && data && memmem(data, size, "@ID@", 4)) {
+                /* substitute the id, only templates pay for the copy */
+                size_t idlen = strlen(id), i, o = 0;
+                t = (char *)malloc(size * (idlen > 4 ? idlen : 4) / 4 + 1);
+                for (i=0; t && i<size; ) {
+                    if (i + 4 <= size && memcmp(data + i, "@ID@", 4) == 0) {
+                        memcpy(t + o, id, idlen);
+                        o += idlen;
+                        i += 4;
+                    }
+                    else
+                        t[o++] = data[i++];
+                }
+                if (t) {
+                    body = t;
+                    size = o;
+                }
+            }
+            if (mock_fields_parse(&fields, target) && mock_space(body, 0, size) < size) {
+                /* and only filtered requests for the second one */
+                size_t o = 0;
+                char *f = (char *)malloc(size + 1);
+                if (f) {
+                    mock_filter(body, mock_space(body, 0, size), size, f, &o, &fields, 0);
+                    free(t);
+                    body = t = f;
+                    size = o;
+                }
+            }
+            if (mock_send(fd, 200, body, size, keepalive) < 0)
+                keepalive = 0;
+            free(t);
+            if (data)
+                munmap(data, st.st_size);
+            close(rfd);
+        }
+        if (!mock_arguments.quiet)
+            fprintf(stderr, "%s %s -> %d %lu\n", method, target, status, (unsigned long)size);
+        if (!keepalive)
+            break;
+    }
+done:
+    free(buf);
+    close(fd);
+}
+
+static struct option mock_options[] = {
+    {"help",         no_argument,       0, 'h'},
+    {"port",         required_argument, 0, 'p'},
+    {"latency",      required_argument, 0, 'l'},
+    {"bandwidth",    required_argument, 0, 'b'},
+    {"errors",       required_argument, 0, 'e'},
+    {"error-status", required_argument, 0, 'E'},
+    {"seed",         required_argument, 0, 's'},
+    {"quiet",        no_argument,       0, 'q'},
+    { 0 }
+};
+
+int main(int argc, char **argv) {
+    int opt, sock, fd, one = 1;
+    unsigned int connections = 0;
+    struct sockaddr_in addr;
+    socklen_t addrlen = sizeof(addr);
+
+    while ((opt = getopt_long(argc, argv, "hp:l:b:e:E:s:q", mock_options, NULL)) != -1) {
+        switch (opt) {
+        case 'p' :
+            mock_arguments.port = atoi(optarg);
+            break;
+        case 'l' :
+            mock_arguments.latency = atoi(optarg);
+            break;
+        case 'b' :
+            mock_arguments.bandwidth = atol(optarg);
+            break;
+        case 'e' :
+            mock_arguments.errors = atof(optarg);
+            break;
+        case 'E' :
+            mock_arguments.status = atoi(optarg);
+            break;
+        case 's' :
+            mock_arguments.seed = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'q' :
+            mock_arguments.quiet = 1;
+            break;
+        case 'h' :
+            mock_helper(0);
+        default :
+            mock_helper(1);
+        }
+    }
+    if (optind < argc)
+        mock_arguments.root = argv[optind];
+    if (chdir(mock_arguments.root) < 0) {
+        fprintf(stderr, "ERROR: unable to use %s\n", mock_arguments.root);
+        return 1;
+    }
+
+    if ((sock = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+        perror("socket");
+        return 1;
+    }
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(mock_arguments.port);
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(sock, 128) < 0 ||
+        getsockname(sock, (struct sockaddr *)&addr, &addrlen) < 0) {
+        perror("bind");
+        return 1;
+    }
+    fprintf(stdout, "port %d\n", ntohs(addr.sin_port));
+    fflush(stdout);
+
+    signal(SIGCHLD, SIG_IGN); /* no zombies */
+    signal(SIGPIPE, SIG_IGN);
+    for (;;) {
+        if ((fd = accept(sock, NULL, NULL)) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("accept");
+            return 1;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        connections++;
+        switch (fork()) {
+        case 0 :
+            close(sock);
+            mock_connection(fd, mock_arguments.seed * 2654435761u + connections);
+            _exit(0);
+        case -1 :
+            perror("fork");
+        default :
+            close(fd);
+        }
+    }
+    return 0;
+}
@@ -50,6 +50,9 @@ static struct option bugz_global_options[] = {
     {"encoding",    required_argument, 0,  0 },
     {"skip-auth",   no_argument,       0,  0 },
     {"version",     no_argument,       0,  0 },
+    {"output",      required_argument, 0,  0 },
+    {"metrics-file",required_argument, 0,  0 },
+    {"trace-file",  required_argument, 0,  0 },
     { 0 }
 };
 
@@ -68,6 +71,9 @@ typedef enum bugz_longopt_t {
     opt_encoding,
     opt_skip_auth,
     opt_version,
+    opt_output,
+    opt_metrics_file,
+    opt_trace_file,
     opt_end
 } bugz_longopt_t;
 
@@ -95,6 +101,14 @@ void bugz_helper(int status) {
        "--encoding ENCODING       : output encoding (default: utf-8) (deprecated)\n"
        "--skip-auth               : skip authentication\n"
        "--version                 : show program version and exit\n"
+       "--output OUTPUT           : output format of get, search, history and\n"
+       "                            attachment: text (default), jsonl, tsv, csv\n"
+       "                            or raw\n"
+       "--metrics-file FILE       : append timing and transfer metrics of every\n"
+       "                            request to FILE ('-' for stderr) and show a\n"
+       "                            summary at exit\n"
+       "--trace-file FILE         : write a trace of the command to FILE in Chrome\n"
+       "                            Trace Event format (for Perfetto)\n"
        "\n"
        "Available subcommands:\n");
     fprintf(stderr, "%s", help_header);
@@ -170,6 +184,29 @@ int main(int argc, char **argv) {
         }
         bugz_arguments.debug = d;
     }
+    if (bugz_arguments.output) {
+        int d = bugz_output_format(bugz_arguments.output);
+        if (d < 0) {
+            fprintf(stderr, N_("ERROR: %s: '--output %s' (choose from text, jsonl, tsv, csv, raw)\n"),
+                            argv[0], bugz_arguments.output);
+            exit(1);
+        }
+        bugz_arguments.output_format = d;
+    }
+    if (bugz_arguments.metrics_file) {
+        if (bugz_metrics_open(bugz_arguments.metrics_file) == FALSE) {
+            fprintf(stderr, N_("ERROR: %s: '--metrics-file %s' : %s\n"),
+                            argv[0], bugz_arguments.metrics_file, strerror(errno));
+            exit(1);
+        }
+    }
+    if (bugz_arguments.trace_file) {
+        if (bugz_trace_open(bugz_arguments.trace_file) == FALSE) {
+            fprintf(stderr, N_("ERROR: %s: '--trace-file %s' : %s\n"),
+                            argv[0], bugz_arguments.trace_file, strerror(errno));
+            exit(1);
+        }
+    }
     bugz_arguments.columns = 80;
     if (bugz_arguments.optarg_columns) {
         int d = atoi(bugz_arguments.optarg_columns);
@@ -188,8 +225,14 @@ int main(int argc, char **argv) {
                 break;
             subcommand++;
         }
-        if (subcommand->submain)
-            return subcommand->submain(argc, argv);
+        if (subcommand->submain) {
+            int retval;
+            bugz_trace_begin("command", subcommand->name);
+            retval = subcommand->submain(argc, argv);
+            bugz_trace_end();
+            bugz_arena_release(&bugz_arena);
+            return retval;
+        }
     }
 
     fprintf(stderr, N_("ERROR: %s: "), argv[0]);
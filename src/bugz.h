@@ -18,6 +18,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <stdint.h>
 #include <errno.h>
 #include <ctype.h>
 #include <magic.h>
@@ -56,8 +57,12 @@ struct bugz_arguments_t {
     char *encoding;
     char *skip_auth;
     char *version;
+    char *output;
+    char *metrics_file;
+    char *trace_file;
     int debug;
     int columns;
+    int output_format;
 };
 extern struct bugz_arguments_t bugz_arguments;
 struct curl_slist *bugz_slist_get_last(struct curl_slist *list);
@@ -119,13 +124,354 @@ void bugz_parsed_url_free(struct bugz_parsed_url_t *purl);
 json_object *bugz_slist_to_json_string(struct curl_slist *list);
 json_object *bugz_slist_to_json_array(struct curl_slist *list, int jtype);
 
+/*
+ * Buffered output sink, fp NULL means stdout
+ */
+struct bugz_sink_t {
+    FILE *fp;
+    char *data;
+    size_t size;
+    size_t used;
+};
+extern struct bugz_sink_t bugz_stdout;
+void bugz_sink_flush(struct bugz_sink_t *sink);
+void bugz_sink_write(struct bugz_sink_t *sink, const char *data, size_t len);
+void bugz_sink_fill(struct bugz_sink_t *sink, int c, size_t n);
+void bugz_sink_printf(struct bugz_sink_t *sink, const char *fmt, ...)
+     __attribute__((format(printf, 2, 3)));
+void bugz_sink_wrap(struct bugz_sink_t *sink, const char *text, size_t len, int width);
+
+/*
+ * Per-command bump allocator, released in one go when the subcommand
+ * returns
+ */
+struct bugz_arena_t {
+    struct bugz_arena_chunk_t *chunk;
+};
+extern struct bugz_arena_t bugz_arena;
+void *bugz_arena_alloc(struct bugz_arena_t *arena, size_t size);
+char *bugz_arena_strdup(struct bugz_arena_t *arena, const char *s);
+char *bugz_arena_printf(struct bugz_arena_t *arena, const char *fmt, ...)
+      __attribute__((format(printf, 2, 3)));
+struct curl_slist *bugz_arena_slist_append(struct bugz_arena_t *arena,
+                                           struct curl_slist *list, const char *s);
+void bugz_arena_release(struct bugz_arena_t *arena);
+
+/*
+ * Whole file input, mapped for regular files and read into a growing
+ * buffer otherwise, see bugz_input.c
+ */
+struct bugz_input_t {
+    const char *data;
+    size_t len;
+    char *buffer;  /* NULL when mapped */
+    size_t size;
+    int mapped;
+};
+int bugz_input_open(struct bugz_input_t *in, const char *path);
+int bugz_input_fd(struct bugz_input_t *in, int fd, size_t max);
+int bugz_input_file(struct bugz_input_t *in, FILE *fp, size_t max);
+char *bugz_input_read(const char *path, size_t max);
+/* largest comment or description read, json-c strings are int sized */
+#define BUGZ_INPUT_TEXT_MAX ((size_t)1 << 30)
+void bugz_input_close(struct bugz_input_t *in);
+
+/*
+ * Streaming JSON writer for request bodies, key is NULL for array
+ * elements and the top level value
+ */
+#define BUGZ_JSON_DEPTH 16
+struct bugz_json_t {
+    char *data;
+    size_t size;
+    size_t used;
+    size_t sent;                 /* read by curl so far */
+    int depth;
+    int count[BUGZ_JSON_DEPTH];  /* members written at each level */
+};
+void bugz_json_reset(struct bugz_json_t *w);
+void bugz_json_free(struct bugz_json_t *w);
+void bugz_json_begin(struct bugz_json_t *w, const char *key, char c);
+void bugz_json_end(struct bugz_json_t *w, char c);
+int bugz_json_members(struct bugz_json_t *w);
+void bugz_json_string(struct bugz_json_t *w, const char *key, const char *s);
+void bugz_json_int(struct bugz_json_t *w, const char *key, long v);
+void bugz_json_double(struct bugz_json_t *w, const char *key, double v);
+void bugz_json_boolean(struct bugz_json_t *w, const char *key, int v);
+void bugz_json_last(struct bugz_json_t *w, const char *key, struct curl_slist *list);
+void bugz_json_slist(struct bugz_json_t *w, const char *key, struct curl_slist *list, int jtype);
+void bugz_json_base64(struct bugz_json_t *w, const char *key, const void *data, size_t len);
+void bugz_json_string_begin(struct bugz_json_t *w, const char *key);
+void bugz_json_string_append(struct bugz_json_t *w, const char *s, size_t len);
+void bugz_json_string_end(struct bugz_json_t *w);
+void bugz_json_setopt(CURL *curl, struct bugz_json_t *w);
+
+/*
+ * Streamed attachment upload, compressed or not, see bugz_upload.c
+ */
+enum bugz_compress_t {
+    bugz_compress_none = 0,
+    bugz_compress_gzip,
+    bugz_compress_zstd
+};
+int bugz_compress_lookup(const char *name);
+int bugz_compress_available(int method);
+const char *bugz_compress_suffix(int method);
+const char *bugz_compress_content_type(int method);
+struct bugz_upload_t;
+struct bugz_upload_t *bugz_upload_new(struct bugz_json_t *head, const struct bugz_input_t *in,
+                                      int method);
+void bugz_upload_setopt(CURL *curl, struct bugz_upload_t *up);
+int bugz_upload_free(struct bugz_upload_t *up, size_t *packed);
+
+/*
+ * JSON parse backends, see bugz_parse.c
+ */
+struct bugz_parser_t {
+    const char *name;
+    int (*parse)(const char *data, size_t len, json_object **jsonp);
+};
+const struct bugz_parser_t *bugz_parser_get(const char *name);
+int bugz_parse_json(const char *data, size_t len, json_object **jsonp);
+
+/*
+ * Read-only access to parsed responses for the render functions, a
+ * missing member or a value of another type reads as NULL, "" or def
+ */
+static inline json_object *bugz_doc_get(json_object *obj, const char *key) {
+    json_object *val = NULL;
+    if (obj && json_object_is_type(obj, json_type_object))
+        json_object_object_get_ex(obj, key, &val);
+    return val;
+}
+
+static inline const char *bugz_doc_string(json_object *obj, const char *key) {
+    return json_object_get_string(bugz_doc_get(obj, key));
+}
+
+static inline int bugz_doc_string_len(json_object *obj, const char *key) {
+    return json_object_get_string_len(bugz_doc_get(obj, key));
+}
+
+static inline int bugz_doc_int(json_object *obj, const char *key, int def) {
+    json_object *val = bugz_doc_get(obj, key);
+    return val ? json_object_get_int(val) : def;
+}
+
+static inline size_t bugz_doc_length(json_object *array) {
+    return array && json_object_is_type(array, json_type_array) ? json_object_array_length(array) : 0;
+}
+
+static inline json_object *bugz_doc_index(json_object *array, size_t i) {
+    return i < bugz_doc_length(array) ? json_object_array_get_idx(array, i) : NULL;
+}
+
+/*
+ * Output formats (--output) and the records they apply to
+ */
+enum bugz_output_format_t {
+    bugz_output_text = 0,
+    bugz_output_jsonl,
+    bugz_output_tsv,
+    bugz_output_csv,
+    bugz_output_raw
+};
+
+enum bugz_record_kind_t {
+    bugz_record_bug = 0,
+    bugz_record_comment,
+    bugz_record_attachment,
+    bugz_record_history,
+    bugz_record_delta    /* saved search changes, a bug with its change */
+};
+
+struct bugz_output_t {
+    int kind;
+    int bug_id;  /* added to records which lack it, if > 0 */
+    int records;
+};
+int bugz_output_format(const char *name);
+const char **bugz_output_columns(int kind);
+void bugz_output_header(struct bugz_sink_t *sink, int kind);
+void bugz_output_headers(struct bugz_sink_t *sink, int kinds);
+void bugz_output_record(struct bugz_sink_t *sink, int kind, json_object *record);
+int bugz_output_callback(json_object *record, void *userp);
+
+/*
+ * Per-request timing and transfer metrics (--metrics-file)
+ */
+int bugz_metrics_open(const char *path);
+void bugz_metrics_record(CURL *curl, CURLcode rcode);
+char *bugz_mask_url(const char *url);
+
+/*
+ * Command trace in Chrome Trace Event format (--trace-file), spans
+ * must be nested, name and cat must outlive the span
+ */
+int bugz_trace_open(const char *path);
+void bugz_trace_begin(const char *cat, const char *name);
+void bugz_trace_end(void);
+
+/* https://en.wikipedia.org/wiki/Jenkins_hash_function */
+static inline uint32_t jenkins_one_at_a_time_hash(const char *key, size_t len) {
+    uint32_t i, hash;
+    for(i = hash = 0; i < len; ++i) {
+        hash += key[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return hash;
+}
+
+/*
+ * Bug fields, see bugz_fields.h
+ */
+enum bugz_field_format_t {
+    bugz_field_format_skip = 0,
+    bugz_field_format_string,
+    bugz_field_format_list,
+    bugz_field_format_lines
+};
+
+enum bugz_field_id_t {
+    #define _field_macro_(n,l,f,w) bugz_field_##n,
+    #include "bugz_fields.h"
+    bugz_field_end
+};
+
+struct bugz_field_t {
+    const char *name;
+    const char *label;
+    int format;
+    int width;
+};
+extern const struct bugz_field_t bugz_fields[];
+
+static inline uint32_t bugz_field_slot(uint32_t hash, uint32_t seed, int shift) {
+    return ((hash ^ seed) * 0x9e3779b1U) >> shift;
+}
+const struct bugz_field_t *bugz_field_lookup(const char *key, size_t len);
+#define bugz_field_get(id) (&bugz_fields[bugz_field_##id])
+
 void bugz_show_bug_info(json_object *bug, json_object *attachments, json_object *comments);
+void bugz_render_bug_info(struct bugz_sink_t *sink, json_object *bug,
+                          json_object *attachments, json_object *comments);
 CURLcode bugz_get_result(CURL *curl, const char *url, json_object **jsonp);
+typedef void (*bugz_multi_callback_t)(int index, json_object *json, void *userp);
+int bugz_get_multi(struct curl_slist *headers, char **urls, int n, int jobs,
+                   bugz_multi_callback_t callback, void *userp);
+typedef int (*bugz_multi_text_t)(int index, const char *data, size_t len, void *userp);
+int bugz_get_multi_text(struct curl_slist *headers, char **urls, int n, int jobs, const char *pattern,
+                        bugz_multi_text_t text, bugz_multi_callback_t callback, void *userp);
+typedef int (*bugz_record_callback_t)(json_object *record, void *userp);
+CURLcode bugz_get_records(CURL *curl, const char *url, const char *path,
+                          bugz_record_callback_t callback, void *userp, json_object **jsonp);
+#define BUGZ_EXTRACT_FIELDS 16
+struct bugz_value_t {
+    const char *data;  /* unescaped string or JSON text, NULL if missing */
+    size_t len;
+    int type;          /* json_type_* */
+};
+typedef int (*bugz_value_callback_t)(const struct bugz_value_t *values, void *userp);
+struct bugz_extract_t *bugz_extract_new(const char *pattern, bugz_value_callback_t callback,
+                                        void *userp);
+size_t bugz_extract_feed(struct bugz_extract_t *x, const char *data, size_t len);
+int bugz_extract_free(struct bugz_extract_t *x, json_object **jsonp);
+CURLcode bugz_get_fields(CURL *curl, const char *url, const char *pattern,
+                         bugz_value_callback_t callback, void *userp, json_object **jsonp);
+int bugz_int_callback(const struct bugz_value_t *values, void *userp);
 const char *bugz_get_content_type(const char *filename);
 char *bugz_raw_input(const char *prompt);
-char *bugz_base64_encode(FILE *infile);
+size_t bugz_base64_encode_block(const unsigned char *in, size_t len, char *out);
+struct bugz_base64_t {
+    unsigned int bits;
+    int n;
+    int end;
+};
+size_t bugz_base64_decode_block(struct bugz_base64_t *state, const char *in, size_t len,
+                                unsigned char *out);
+size_t bugz_base64_decode_end(struct bugz_base64_t *state, unsigned char *out);
 char *bugz_base64_decode(const char *decode, FILE *outfile);
 
+/*
+ * Columnar bug table, see bugz_table.c. Every cell is 32 bits: the value
+ * of an int column, the symbol of an interned column or the offset of a
+ * text column. Null or missing values are 0 in int columns and
+ * BUGZ_TABLE_NULL in the others.
+ */
+#define BUGZ_TABLE_NULL 0xffffffffU
+enum bugz_table_kind_t {
+    bugz_table_int = 0,
+    bugz_table_symbol,  /* interned, few distinct values */
+    bugz_table_text
+};
+struct bugz_table_column_t {
+    const struct bugz_field_t *field;
+    int kind;
+    uint32_t *cells;
+    char *text;         /* text column only */
+    size_t used;
+    size_t size;
+};
+struct bugz_table_t {
+    int rows;
+    int size;
+    int ncolumns;
+    struct bugz_table_column_t columns[BUGZ_EXTRACT_FIELDS];
+    /* symbols shared by every interned column */
+    char *symbols;
+    size_t used;
+    size_t capacity;
+    uint32_t *offsets;  /* symbol -> offset in symbols */
+    uint32_t nsymbols;
+    uint32_t *slots;    /* hash -> symbol + 1 */
+    uint32_t nslots;
+    /* rows to render, in order */
+    int *order;
+    int selected;
+};
+struct bugz_table_key_t {
+    int column;         /* -1 for the group count */
+    int desc;
+};
+struct bugz_table_group_t {
+    int row;            /* first row of the group */
+    int count;
+};
+void bugz_table_init(struct bugz_table_t *t, const struct bugz_field_t **fields, int n);
+int bugz_table_column(struct bugz_table_t *t, const struct bugz_field_t *field);
+char *bugz_table_pattern(struct bugz_table_t *t, const char *path, char *buf, size_t size);
+int bugz_table_add(const struct bugz_value_t *values, void *userp);
+const char *bugz_table_string(const struct bugz_table_t *t, int row, int col);
+void bugz_table_sort(struct bugz_table_t *t, const struct bugz_table_key_t *keys, int nkeys);
+int bugz_table_group(const struct bugz_table_t *t, int col, struct bugz_table_group_t **groupsp);
+void bugz_table_sort_groups(const struct bugz_table_t *t, int col, const struct bugz_table_key_t *key,
+                            struct bugz_table_group_t *groups, int n);
+void bugz_table_free(struct bugz_table_t *t);
+int bugz_output_table_columns(struct bugz_table_t *t, int kind);
+void bugz_output_table(struct bugz_sink_t *sink, const struct bugz_table_t *t, int ncolumns);
+void bugz_output_groups(struct bugz_sink_t *sink, const struct bugz_table_t *t, int col,
+                        const struct bugz_table_group_t *groups, int n);
+static inline uint32_t bugz_table_cell(const struct bugz_table_t *t, int row, int col) {
+    return t->columns[col].cells[row];
+}
+
+/*
+ * Filter expressions over a bug table, see bugz_filter.c
+ */
+struct bugz_filter_t *bugz_filter_compile(const char *expr, char *error, size_t errlen);
+int bugz_filter_bind(struct bugz_filter_t *f, struct bugz_table_t *t);
+int bugz_filter_apply(const struct bugz_filter_t *f, struct bugz_table_t *t);
+void bugz_filter_free(struct bugz_filter_t *f);
+
+/*
+ * Saved searches (bugz search --save), NULL if name is not saved
+ */
+json_object *bugz_search_saved_load(const char *name);
+
 int bugz_check_result(json_object *json);
 
 #endif/*__BUGZ_H__*/
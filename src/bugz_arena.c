@@ -0,0 +1,113 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <stdarg.h>
+
+#include "bugz.h"
+
+/*
+ * Per-command bump allocator, option values, URLs and other state that
+ * lives as long as the subcommand are carved out of large chunks and
+ * released all at once by bugz_arena_release().
+ *
+ */
+#define BUGZ_ARENA_CHUNK (8 * 1024)
+#define BUGZ_ARENA_ALIGN 16
+
+struct bugz_arena_chunk_t {
+    struct bugz_arena_chunk_t *next;
+    size_t size;
+    size_t used;
+    char data[];
+};
+
+struct bugz_arena_t bugz_arena = { 0 };
+
+void *bugz_arena_alloc(struct bugz_arena_t *arena, size_t size) {
+    struct bugz_arena_chunk_t *chunk = arena->chunk;
+    size_t n;
+
+    size = (size + BUGZ_ARENA_ALIGN - 1) & ~(size_t)(BUGZ_ARENA_ALIGN - 1);
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        n = size > BUGZ_ARENA_CHUNK / 4 ? size : BUGZ_ARENA_CHUNK;
+        if ((chunk = (struct bugz_arena_chunk_t *)malloc(sizeof(*chunk) + n)) == NULL) {
+            fprintf(stderr, "ERROR: expand arena in bugz_arena_alloc failed\n");
+            exit(1);
+        }
+        chunk->size = n;
+        chunk->used = 0;
+        if (size > BUGZ_ARENA_CHUNK / 4 && arena->chunk) {
+            /* a chunk of its own, keep filling the current chunk */
+            chunk->next = arena->chunk->next;
+            arena->chunk->next = chunk;
+        }
+        else {
+            chunk->next = arena->chunk;
+            arena->chunk = chunk;
+        }
+    }
+    chunk->used += size;
+    return chunk->data + chunk->used - size;
+}
+
+char *bugz_arena_strdup(struct bugz_arena_t *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    return (char *)memcpy(bugz_arena_alloc(arena, len), s, len);
+}
+
+char *bugz_arena_printf(struct bugz_arena_t *arena, const char *fmt, ...) {
+    int len;
+    char *p;
+    va_list ap;
+
+    va_start(ap, fmt);
+    len = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (len < 0)
+        return NULL;
+    p = (char *)bugz_arena_alloc(arena, len + 1);
+    va_start(ap, fmt);
+    vsnprintf(p, len + 1, fmt, ap);
+    va_end(ap);
+    return p;
+}
+
+/*
+ * Same as curl_slist_append(), the node and its string are a single
+ * allocation. Lists built here must not be passed to curl_slist_free_all().
+ */
+struct curl_slist *bugz_arena_slist_append(struct bugz_arena_t *arena,
+                                           struct curl_slist *list, const char *s) {
+    size_t len = strlen(s) + 1;
+    struct curl_slist *node, *last;
+
+    node = (struct curl_slist *)bugz_arena_alloc(arena, sizeof(*node) + len);
+    node->data = (char *)memcpy((char *)(node + 1), s, len);
+    node->next = NULL;
+    if (list == NULL)
+        return node;
+    for (last = list; last->next; last = last->next)
+        ;
+    last->next = node;
+    return list;
+}
+
+void bugz_arena_release(struct bugz_arena_t *arena) {
+    struct bugz_arena_chunk_t *chunk, *next;
+    for (chunk = arena->chunk; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+    arena->chunk = NULL;
+}
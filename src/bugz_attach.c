@@ -13,7 +13,10 @@
  */
 
 #include "bugz.h"
+#include <time.h>
+#include <utime.h>
 #include <libgen.h>
+#include <sys/stat.h>
 
 static struct option bugz_attach_options[] = {
     {"help",         no_argument,       0, 'h'},
@@ -21,6 +24,7 @@ static struct option bugz_attach_options[] = {
     {"description",  required_argument, 0, 'd'},
     {"patch",        no_argument,       0, 'p'},
     {"title",        required_argument, 0, 't'},
+    {"compress",     required_argument, 0, 'z'},
     { 0 }
 };
 
@@ -41,6 +45,9 @@ void bugz_attach_helper(int status) {
        "-p [--patch]                     : attachment is a patch\n"
        "-t [--title] SUMMARY             : a short description of the attachment\n"
        "                                   (default:filename)\n"
+       "-z [--compress] METHOD           : compress the file before sending it,\n"
+       "                                   none (default), gzip, zstd, or auto\n"
+       "                                   for text files of 1 MiB or more\n"
        "\n"
        "Type 'bugz --help' for valid global options\n");
     fprintf(stderr, "%s", help_header);
@@ -50,6 +57,7 @@ void bugz_attach_helper(int status) {
 struct bugz_attach_arguments_t {
     int bug;
     int patch;
+    int compress;
     struct curl_slist *filename;
     struct curl_slist *content_type;
     struct curl_slist *description;
@@ -58,6 +66,21 @@ struct bugz_attach_arguments_t {
 static struct bugz_attach_arguments_t bugz_attach_arguments = { 0 };
 #define _append_attach_arg_(m) bugz_attach_arguments.m = \
                                curl_slist_append(bugz_attach_arguments.m, optarg)
+#define BUGZ_ATTACH_AUTO (-2)
+#define BUGZ_ATTACH_AUTO_SIZE (1024 * 1024)
+/* smaller files are encoded into the body before sending */
+#define BUGZ_ATTACH_STREAM_SIZE (1024 * 1024)
+
+/* --compress auto, large text files only, never patches */
+static int bugz_attach_compress(const char *content_type, size_t size) {
+    if (bugz_attach_arguments.patch || size < BUGZ_ATTACH_AUTO_SIZE)
+        return bugz_compress_none;
+    if (strncmp(content_type, "text/", 5) && strncmp(content_type, "application/json", 16) &&
+        strncmp(content_type, "application/xml", 15))
+        return bugz_compress_none;
+    return bugz_compress_available(bugz_compress_zstd) ? bugz_compress_zstd :
+           bugz_compress_available(bugz_compress_gzip) ? bugz_compress_gzip : bugz_compress_none;
+}
 
 int bugz_attach_main(int argc, char **argv) {
     CURL *curl;
@@ -67,11 +90,16 @@ int bugz_attach_main(int argc, char **argv) {
     int opt, longindex, retval = 1;
     struct bugz_config_t *config;
     struct curl_slist *headers = NULL;
+    struct bugz_json_t body = { 0 };
+    int attachid = 0;
+    struct bugz_input_t in;
+    struct bugz_upload_t *upload = NULL;
+    const char *file_name;
 
     optind++;
     bugz_attach_arguments.bug = -1;
     while (optind < argc) {
-        opt = getopt_long(argc, argv, "-:hc:d:pt:",
+        opt = getopt_long(argc, argv, "-:hc:d:pt:z:",
                           bugz_attach_options, &longindex);
         switch (opt) {
         case ':' :
@@ -94,6 +122,20 @@ int bugz_attach_main(int argc, char **argv) {
         case 't' :
             _append_attach_arg_(title);
             break;
+        case 'z' :
+            bugz_attach_arguments.compress = strcmp(optarg, "auto") ?
+                                             bugz_compress_lookup(optarg) : BUGZ_ATTACH_AUTO;
+            if (bugz_attach_arguments.compress == -1) {
+                fprintf(stderr, N_("ERROR: %s attach: unknown compression '%s'\n"), argv[0], optarg);
+                exit(1);
+            }
+            if (bugz_attach_arguments.compress >= 0 &&
+                !bugz_compress_available(bugz_attach_arguments.compress)) {
+                fprintf(stderr, N_("ERROR: %s attach: %s compression is not supported by this build\n"),
+                                argv[0], optarg);
+                exit(1);
+            }
+            break;
         case -1 :
             if (bugz_attach_arguments.bug < 0)
                 bugz_attach_arguments.bug = atoi(argv[optind++]);
@@ -126,6 +168,26 @@ int bugz_attach_main(int argc, char **argv) {
         bugz_attach_arguments.title = \
         curl_slist_append(bugz_attach_arguments.title,
         basename(bugz_attach_arguments.filename->data));
+    if (bugz_input_open(&in, bugz_attach_arguments.filename->data) == FALSE) {
+        fprintf(stderr, N_("ERROR: %s attach: unable to read from '%s'\n"), argv[0], 
+                        bugz_attach_arguments.filename->data);
+        exit(1);
+    }
+    if (bugz_attach_arguments.compress == BUGZ_ATTACH_AUTO)
+        bugz_attach_arguments.compress =
+        bugz_attach_compress(bugz_attach_arguments.content_type->data, in.len);
+    if (bugz_attach_arguments.compress != bugz_compress_none && bugz_attach_arguments.patch) {
+        fprintf(stderr, N_("ERROR: %s attach: patches are not compressed\n"), argv[0]);
+        exit(1);
+    }
+    /* what Bugzilla stores is the compressed file */
+    file_name = basename(bugz_attach_arguments.filename->data);
+    if (bugz_attach_arguments.compress != bugz_compress_none) {
+        file_name = bugz_arena_printf(&bugz_arena, "%s%s", file_name,
+                                      bugz_compress_suffix(bugz_attach_arguments.compress));
+        bugz_attach_arguments.content_type = bugz_arena_slist_append(&bugz_arena, NULL,
+                                  bugz_compress_content_type(bugz_attach_arguments.compress));
+    }
     if (bugz_attach_arguments.description == NULL) {
         char *desc = bugz_raw_input("Enter optional long description of attachment (Press Ctrl+D to end)\n");
         bugz_attach_arguments.description = \
@@ -167,48 +229,57 @@ int bugz_attach_main(int argc, char **argv) {
     headers = curl_slist_append(headers, "Accept: application/json");
     headers = curl_slist_append(headers, "Content-Type: application/json");
     
-    json = json_object_new_object();
+    bugz_json_begin(&body, NULL, '{');
     if (1) {
-        char *d;
-        FILE *fp;
-        json_object *jarray = json_object_new_array();
-        json_object_array_add(jarray, json_object_new_int(bugz_attach_arguments.bug));
-        
-        json_object_object_add(json, "ids", jarray);
-        json_object_object_add(json, "summary",
-                               bugz_slist_to_json_string(bugz_attach_arguments.title));
-        json_object_object_add(json, "file_name",
-                               bugz_slist_to_json_string(bugz_attach_arguments.filename));
-        json_object_object_add(json, "comment",
-                               bugz_slist_to_json_string(bugz_attach_arguments.description));
-        json_object_object_add(json, "is_patch", json_object_new_int(bugz_attach_arguments.patch));
+        bugz_json_begin(&body, "ids", '[');
+        bugz_json_int(&body, NULL, bugz_attach_arguments.bug);
+        bugz_json_end(&body, ']');
+
+        bugz_json_last(&body, "summary", bugz_attach_arguments.title);
+        bugz_json_string(&body, "file_name", file_name);
+        bugz_json_last(&body, "comment", bugz_attach_arguments.description);
+        bugz_json_int(&body, "is_patch", bugz_attach_arguments.patch);
         if (bugz_attach_arguments.patch == FALSE)
-            json_object_object_add(json, "content_type",
-                                   bugz_slist_to_json_string(bugz_attach_arguments.content_type));
-        if ((fp = fopen(bugz_attach_arguments.filename->data, "rb")) == NULL) {
-            fprintf(stderr, N_("ERROR: %s attach: unable to read from '%s'\n"), argv[0], 
-                            bugz_attach_arguments.filename->data);
-            json_object_put(json);
-            curl_easy_cleanup(curl);
-            exit(1);
+            bugz_json_last(&body, "content_type", bugz_attach_arguments.content_type);
+        if (bugz_attach_arguments.compress != bugz_compress_none ||
+            in.len >= BUGZ_ATTACH_STREAM_SIZE) {
+            /* read, compressed, encoded and sent at the same time */
+            bugz_json_string_begin(&body, "data");
+            upload = bugz_upload_new(&body, &in, bugz_attach_arguments.compress);
+            if (upload == NULL) {
+                fprintf(stderr, N_("ERROR: %s attach: unable to start the upload\n"), argv[0]);
+                exit(1);
+            }
+            if (bugz_attach_arguments.compress != bugz_compress_none)
+                headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+        }
+        else {
+            /* encoded straight from the mapped file into the body */
+            bugz_json_base64(&body, "data", in.data, in.len);
+            bugz_input_close(&in);
+            bugz_json_end(&body, '}');
         }
-        d = bugz_base64_encode(fp);
-        json_object_object_add(json, "data", json_object_new_string(d));
-        free(d);
-        fclose(fp);
     }
     curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(json));
+    if (upload)
+        bugz_upload_setopt(curl, upload);
+    else
+        bugz_json_setopt(curl, &body);
 
     fprintf(stderr, N_(" * Info: Using %s\n"), base);
-    bugz_get_result(curl, url, &json);
+    bugz_get_fields(curl, url, "ids[0]", bugz_int_callback, &attachid, &json);
+    if (upload) {
+        size_t packed;
+        if (bugz_upload_free(upload, &packed) == FALSE)
+            fprintf(stderr, N_("ERROR: %s attach: unable to read or compress '%s'\n"), argv[0],
+                            bugz_attach_arguments.filename->data);
+        else if (bugz_attach_arguments.compress != bugz_compress_none)
+            fprintf(stderr, N_(" * Info: Compressed %lu bytes to %lu (%s)\n"),
+                            (unsigned long)in.len, (unsigned long)packed, file_name);
+        bugz_input_close(&in);
+    }
     if (bugz_check_result(json)) {
-        int attachid;
-        json_object *ids, *idx0;
-        json_object_object_get_ex(json, "ids", &ids);
-        idx0 = json_object_array_get_idx(ids, 0);
-        attachid = json_object_get_int(idx0);
         fprintf(stderr, N_(" * Info: %s (%d) has been attached to bug %d\n"),
                         bugz_attach_arguments.filename->data, attachid, 
                         bugz_attach_arguments.bug);
@@ -217,28 +288,40 @@ int bugz_attach_main(int argc, char **argv) {
         json_object_put(json);
         retval = 0;
     }
+    bugz_json_free(&body);
     curl_easy_cleanup(curl);
 
     return retval;
 }
 
 static struct option bugz_attachment_options[] = {
-    {"help", no_argument, 0, 'h'},
-    {"view", no_argument, 0, 'v'},
+    {"help", no_argument,       0, 'h'},
+    {"view", no_argument,       0, 'v'},
+    {"bug",  required_argument, 0, 'b'},
+    {"all",  no_argument,       0, 'a'},
+    {"jobs", required_argument, 0, 'j'},
     { 0 }
 };
 
 void bugz_attachment_helper(int status) {
     char help_header[] =
-    N_("Usage: bugz attachment [options] attachid\n"
+    N_("Usage: bugz attachment [options] attachid [attachid ...]\n"
+       "       bugz attachment [options] --bug BUG\n"
        "Get attachment from Bugzilla\n"
        "\n"
        "Arguments:\n"
        "attachid : the ID of the attachment\n"
        "\n"
        "Valid options:\n"
-       "-h [--help]  : show this help message and exit\n"
-       "-v [--view]  : print attachment rather than save\n"
+       "-h [--help]      : show this help message and exit\n"
+       "-v [--view]      : print attachment rather than save\n"
+       "-b [--bug] BUG   : save the attachments of BUG\n"
+       "-a [--all]       : with --bug, also save obsolete attachments\n"
+       "-j [--jobs] JOBS : number of attachments downloaded at a time\n"
+       "                   (default: 4)\n"
+       "\n"
+       "Files already saved with the size and time of the attachment are\n"
+       "skipped, so an interrupted download can be run again.\n"
        "\n"
        "Type 'bugz --help' for valid global options\n");
     fprintf(stderr, "%s", help_header);
@@ -248,9 +331,315 @@ void bugz_attachment_helper(int status) {
 struct bugz_attachment_arguments_t {
     int attachid;
     int view;
+    int *attachids;
+    int nattachids;
+    int *bugs;
+    int nbugs;
+    int all;
+    int jobs;
 };
 static struct bugz_attachment_arguments_t bugz_attachment_arguments = { 0 };
 
+static int bugz_attachment_add(int **list, int *n, int value) {
+    int *p;
+    if ((*n & 15) == 0) {
+        if ((p = (int *)realloc(*list, (*n + 16) * sizeof(int))) == NULL)
+            return FALSE;
+        *list = p;
+    }
+    (*list)[(*n)++] = value;
+    return TRUE;
+}
+
+/*
+ * --output other than text, raw passes the response through as is,
+ * the other formats only write the metadata of the attachment.
+ */
+static int bugz_attachment_output(CURL *curl, char *url) {
+    json_object *json;
+    struct bugz_output_t output = { bugz_record_attachment, 0, 0 };
+    int raw = bugz_arguments.output_format == bugz_output_raw;
+
+    if (!raw)
+        strcat(url, strchr(url, '?') ? "&exclude_fields=data" : "?exclude_fields=data");
+    bugz_output_header(&bugz_stdout, bugz_record_attachment);
+    bugz_get_records(curl, url, raw ? NULL : "attachments.*", bugz_output_callback, &output, &json);
+    bugz_sink_flush(&bugz_stdout);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        return 1;
+    }
+    json_object_put(json);
+    return 0;
+}
+
+/*
+ * Saving, the metadata (without data) of every attachment is fetched
+ * first, in one request for the attachids and one per bug. Attachments
+ * already saved are skipped, Bugzilla does not publish a checksum so a
+ * saved file is recognized by its size and its modification time, set
+ * from the last_change_time of the attachment. The others are downloaded
+ * --jobs at a time into '.NAME.part' and renamed once complete, so a
+ * file under its final name is never partial. The base64 data is decoded
+ * into the file as it is received, no attachment is held in memory.
+ */
+#define BUGZ_ATTACHMENT_DECODE (16 * 1024)
+
+struct bugz_attachment_file_t {
+    int id;
+    long size;
+    time_t mtime;
+    char *name;
+
+    /* the data is decoded into the '.part' file as it is received */
+    char *part;
+    FILE *fp;
+    long written;
+    int complete;
+    struct bugz_base64_t base64;
+};
+
+struct bugz_attachment_download_t {
+    struct bugz_attachment_file_t *files;
+    int nfiles;
+    int *todo;      /* index into files of each download */
+    int saved;
+    int failures;
+};
+
+static time_t bugz_attachment_time(const char *s) {
+    struct tm tm = { 0 };
+    if (s == NULL || sscanf(s, "%d-%d-%dT%d:%d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+                            &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6)
+        return 0;
+    tm.tm_year -= 1900;
+    tm.tm_mon -= 1;
+    return timegm(&tm);
+}
+
+static void bugz_attachment_file(struct bugz_attachment_download_t *download, json_object *attachment) {
+    int i;
+    char *p;
+    const char *name = bugz_doc_string(attachment, "file_name");
+    struct bugz_attachment_file_t *file;
+
+    if ((download->nfiles & 15) == 0) {
+        file = (struct bugz_attachment_file_t *)realloc(download->files,
+               (download->nfiles + 16) * sizeof(struct bugz_attachment_file_t));
+        if (file == NULL) {
+            fprintf(stderr, "ERROR: allocate memory in bugz_attachment_file failed\n");
+            exit(1);
+        }
+        download->files = file;
+    }
+    file = &download->files[download->nfiles];
+    memset(file, 0, sizeof(*file));
+    file->id = bugz_doc_int(attachment, "id", 0);
+    file->size = (long)json_object_get_int64(bugz_doc_get(attachment, "size"));
+    file->mtime = bugz_attachment_time(bugz_doc_string(attachment, "last_change_time"));
+    for (i=0; i<download->nfiles; i++) {
+        if (download->files[i].id == file->id)
+            return; /* given twice */
+    }
+    /* never outside the current directory */
+    if (name && (p = strrchr(name, '/')) != NULL)
+        name = p + 1;
+    if (name == NULL || *name == '\0' || *name == '.')
+        file->name = bugz_arena_printf(&bugz_arena, "attachment-%d", file->id);
+    else
+        file->name = bugz_arena_strdup(&bugz_arena, name);
+    /* same file name for several attachments, e.g. new versions of a log */
+    for (i=0; i<download->nfiles; i++) {
+        if (strcmp(download->files[i].name, file->name) == 0) {
+            file->name = bugz_arena_printf(&bugz_arena, "%d-%s", file->id, file->name);
+            break;
+        }
+    }
+    download->nfiles++;
+}
+
+static int bugz_attachment_metadata(CURL *curl, const char *url, int bug,
+                                    struct bugz_attachment_download_t *download) {
+    char id[32];
+    json_object *json, *list;
+
+    bugz_get_result(curl, url, &json);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        return FALSE;
+    }
+    if (bug > 0) {
+        int i;
+        snprintf(id, sizeof(id), "%d", bug);
+        list = bugz_doc_get(bugz_doc_get(json, "bugs"), id);
+        for (i=0; i<(int)bugz_doc_length(list); i++) {
+            json_object *attachment = bugz_doc_index(list, i);
+            if (bugz_attachment_arguments.all || !bugz_doc_int(attachment, "is_obsolete", 0))
+                bugz_attachment_file(download, attachment);
+        }
+    }
+    else {
+        int i;
+        for (i=0; i<bugz_attachment_arguments.nattachids; i++) {
+            snprintf(id, sizeof(id), "%d", bugz_attachment_arguments.attachids[i]);
+            if ((list = bugz_doc_get(bugz_doc_get(json, "attachments"), id)) != NULL)
+                bugz_attachment_file(download, list);
+            else
+                fprintf(stderr, N_("ERROR: attachment %s not found\n"), id);
+        }
+    }
+    json_object_put(json);
+    return TRUE;
+}
+
+/* piece of the base64 data of a download, data NULL at its end */
+static int bugz_attachment_multi_text(int index, const char *data, size_t len, void *userp) {
+    size_t n, used;
+    unsigned char out[BUGZ_ATTACHMENT_DECODE / 4 * 3 + 3];
+    struct bugz_attachment_download_t *download = (struct bugz_attachment_download_t *)userp;
+    struct bugz_attachment_file_t *file = &download->files[download->todo[index]];
+
+    if (file->fp == NULL) {
+        file->part = bugz_arena_printf(&bugz_arena, ".%s.part", file->name);
+        if ((file->fp = fopen(file->part, "wb")) == NULL) {
+            fprintf(stderr, N_("ERROR: failed to write into %s: %s\n"), file->name, strerror(errno));
+            return 1;
+        }
+        fprintf(stderr, N_(" * Info: Saving attachment: %s\n"), file->name);
+    }
+    for (; data && len > 0; data += n, len -= n) {
+        n = len < BUGZ_ATTACHMENT_DECODE ? len : BUGZ_ATTACHMENT_DECODE;
+        used = bugz_base64_decode_block(&file->base64, data, n, out);
+        if (fwrite(out, 1, used, file->fp) != used)
+            return 1;
+        file->written += (long)used;
+    }
+    if (data == NULL) {
+        used = bugz_base64_decode_end(&file->base64, out);
+        if (fwrite(out, 1, used, file->fp) != used)
+            return 1;
+        file->written += (long)used;
+        file->complete = TRUE;
+    }
+    return 0;
+}
+
+/* end of a download, json is the response without the data */
+static void bugz_attachment_multi_callback(int index, json_object *json, void *userp) {
+    int ok;
+    struct utimbuf times;
+    struct bugz_attachment_download_t *download = (struct bugz_attachment_download_t *)userp;
+    struct bugz_attachment_file_t *file = &download->files[download->todo[index]];
+
+    ok = file->fp == NULL || fclose(file->fp) == 0;
+    file->fp = NULL;
+    if (json == NULL) { /* counted by bugz_get_multi_text() */
+        if (file->part)
+            unlink(file->part);
+        return;
+    }
+    if (bugz_check_result(json) == FALSE) {
+        if (file->part)
+            unlink(file->part);
+        download->failures++;
+        return;
+    }
+    if (!ok || !file->complete) {
+        fprintf(stderr, N_("ERROR: failed to write into %s\n"), file->name);
+        download->failures++;
+        if (file->part)
+            unlink(file->part);
+        return;
+    }
+    if (file->size > 0 && file->written != file->size) {
+        fprintf(stderr, N_("ERROR: %s: got %ld bytes, expected %ld\n"), file->name,
+                        file->written, file->size);
+        download->failures++;
+        unlink(file->part);
+        return;
+    }
+    times.actime = times.modtime = file->mtime;
+    if ((file->mtime && utime(file->part, &times) != 0) || rename(file->part, file->name) != 0) {
+        fprintf(stderr, N_("ERROR: failed to write into %s: %s\n"), file->name, strerror(errno));
+        download->failures++;
+        unlink(file->part);
+        return;
+    }
+    download->saved++;
+}
+
+static int bugz_attachment_download(CURL *curl, struct curl_slist *headers,
+                                    const char *base, const char *auth) {
+    int i, n = 0, skipped = 0, failures = 0;
+    char **urls;
+    struct stat st;
+    struct bugz_attachment_download_t download = { 0 };
+
+    /* metadata */
+    if (bugz_attachment_arguments.nattachids > 0) {
+        json_object *json = json_object_new_object(), *ids = json_object_new_array();
+        char *query;
+        for (i=1; i<bugz_attachment_arguments.nattachids; i++)
+            json_object_array_add(ids, json_object_new_int(bugz_attachment_arguments.attachids[i]));
+        json_object_object_add(json, "attachment_ids", ids);
+        json_object_object_add(json, "exclude_fields", json_object_new_string("data"));
+        query = bugz_urlencode(json);
+        json_object_put(json);
+        if (!bugz_attachment_metadata(curl, bugz_arena_printf(&bugz_arena,
+                                      "%s/rest/bug/attachment/%d?%s%s%s", base,
+                                      bugz_attachment_arguments.attachids[0], query ? query : "",
+                                      *auth ? "&" : "", auth), 0, &download))
+            failures++;
+        free(query);
+    }
+    for (i=0; i<bugz_attachment_arguments.nbugs; i++) {
+        if (!bugz_attachment_metadata(curl, bugz_arena_printf(&bugz_arena,
+                                      "%s/rest/bug/%d/attachment?exclude_fields=data%s%s", base,
+                                      bugz_attachment_arguments.bugs[i], *auth ? "&" : "", auth),
+                                      bugz_attachment_arguments.bugs[i], &download))
+            failures++;
+    }
+
+    /* what is left to save */
+    urls = (char **)malloc((download.nfiles + 1) * sizeof(char *));
+    download.todo = (int *)malloc((download.nfiles + 1) * sizeof(int));
+    if (urls == NULL || download.todo == NULL) {
+        fprintf(stderr, "ERROR: allocate memory in bugz_attachment_download failed\n");
+        exit(1);
+    }
+    for (i=0; i<download.nfiles; i++) {
+        struct bugz_attachment_file_t *file = &download.files[i];
+        if (stat(file->name, &st) == 0) {
+            if (st.st_size == file->size && (file->mtime == 0 || st.st_mtime == file->mtime)) {
+                fprintf(stderr, N_(" * Info: %s is already saved\n"), file->name);
+                skipped++;
+            }
+            else {
+                fprintf(stderr, N_("ERROR: filename %s already exists\n"), file->name);
+                failures++;
+            }
+            continue;
+        }
+        download.todo[n] = i;
+        urls[n++] = bugz_arena_printf(&bugz_arena, "%s/rest/bug/attachment/%d?include_fields=data%s%s",
+                                      base, file->id, *auth ? "&" : "", auth);
+    }
+    if (n > 0) {
+        fprintf(stderr, N_(" * Info: Getting %d attachment(s) ..\n"), n);
+        failures += bugz_get_multi_text(headers, urls, n, bugz_attachment_arguments.jobs,
+                                        "attachments.*.data", bugz_attachment_multi_text,
+                                        bugz_attachment_multi_callback, &download);
+        failures += download.failures;
+    }
+    if (download.nfiles > 1 || skipped)
+        fprintf(stderr, N_(" * Info: %d saved, %d already saved, %d failed\n"),
+                        download.saved, skipped, failures);
+    free(download.todo);
+    free(download.files);
+    free(urls);
+    return failures ? 1 : 0;
+}
+
 int bugz_attachment_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
@@ -262,8 +651,9 @@ int bugz_attachment_main(int argc, char **argv) {
 
     optind++;
     bugz_attachment_arguments.attachid = -1;
+    bugz_attachment_arguments.jobs = 4;
     while (optind < argc) {
-        opt = getopt_long(argc, argv, "-:hv",
+        opt = getopt_long(argc, argv, "-:hvb:aj:",
                           bugz_attachment_options, &longindex);
         switch (opt) {
         case ':' :
@@ -277,17 +667,43 @@ int bugz_attachment_main(int argc, char **argv) {
         case 'v' :
             bugz_attachment_arguments.view = TRUE;
             break;
+        case 'b' :
+            if (atoi(optarg) <= 0) {
+                fprintf(stderr, N_("ERROR: %s attachment: invalid bug specified\n"), argv[0]);
+                exit(1);
+            }
+            bugz_attachment_add(&bugz_attachment_arguments.bugs,
+                                &bugz_attachment_arguments.nbugs, atoi(optarg));
+            break;
+        case 'a' :
+            bugz_attachment_arguments.all = TRUE;
+            break;
+        case 'j' :
+            bugz_attachment_arguments.jobs = atoi(optarg);
+            break;
         case -1 :
             bugz_attachment_arguments.attachid = atoi(argv[optind++]);
+            if (bugz_attachment_arguments.attachid <= 0)
+                break;
+            bugz_attachment_add(&bugz_attachment_arguments.attachids,
+                                &bugz_attachment_arguments.nattachids,
+                                bugz_attachment_arguments.attachid);
             break;
         }
     }
-    if (bugz_attachment_arguments.attachid <= 0) {
+    if (bugz_attachment_arguments.attachid == 0 ||
+        (bugz_attachment_arguments.attachid < 0 && bugz_attachment_arguments.nbugs == 0)) {
         fprintf(stderr, bugz_attachment_arguments.attachid == -1 ?
                         N_("ERROR: %s attachment: no attachid specified\n"):
                         N_("ERROR: %s attachment: invalid attachid specified\n"), argv[0]);
         exit(1);
     }
+    if ((bugz_attachment_arguments.view || bugz_arguments.output_format != bugz_output_text) &&
+        (bugz_attachment_arguments.nattachids != 1 || bugz_attachment_arguments.nbugs > 0)) {
+        fprintf(stderr, N_("ERROR: %s attachment: --view and --output take a single attachid\n"),
+                        argv[0]);
+        exit(1);
+    }
 
     config = bugz_config();
     base = bugz_get_base(config);
@@ -305,6 +721,39 @@ int bugz_attachment_main(int argc, char **argv) {
             exit(1);
         }
     }
+    if (!bugz_attachment_arguments.view && bugz_arguments.output_format == bugz_output_text) {
+        char *auth;
+        json = json_object_new_object();
+        if (password) {
+            json_object_object_add(json, "login",
+            json_object_new_string(username));
+            json_object_object_add(json, "password",
+            json_object_new_string(password));
+        }
+        else if (username) {
+            json_object_object_add(json, "api_key",
+            json_object_new_string(username));
+        }
+        auth = json_object_object_length(json) > 0 ? bugz_urlencode(json) : NULL;
+        json_object_put(json);
+        bugz_config_free(config);
+        if ((curl = curl_easy_init()) == NULL) {
+            fprintf(stderr, N_("ERROR: %s attachment: curl_easy_init() failed\n"), argv[0]);
+            exit(1);
+        }
+        headers = curl_slist_append(headers, "charsets: utf-8");
+        headers = curl_slist_append(headers, "Accept: application/json");
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        fprintf(stderr, N_(" * Info: Using %s\n"), base);
+        retval = bugz_attachment_download(curl, headers, base, auth ? auth : "");
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+        free(auth);
+        free(bugz_attachment_arguments.attachids);
+        free(bugz_attachment_arguments.bugs);
+        return retval;
+    }
     if (password)
         sprintf(url, "%s/rest/bug/attachment/%d?login=%s&password=%s", base,
                 bugz_attachment_arguments.attachid, username, password);
@@ -328,6 +777,12 @@ int bugz_attachment_main(int argc, char **argv) {
                     N_(" * Info: Getting attachment %d ..\n"), 
                     base, bugz_attachment_arguments.attachid);
 
+    if (bugz_arguments.output_format != bugz_output_text) {
+        retval = bugz_attachment_output(curl, url);
+        curl_easy_cleanup(curl);
+        return retval;
+    }
+
     bugz_get_result(curl, url, &json);
     if (bugz_check_result(json)) {
         char attachmentid[32] = {0};
@@ -337,27 +792,10 @@ int bugz_attachment_main(int argc, char **argv) {
         json_object_object_get_ex(attachments, attachmentid, &result);
         json_object_object_get_ex(result, "file_name", &file_name);
         json_object_object_get_ex(result, "data", &data);
-        fprintf(stderr, N_(" * Info: %s attachment: %s\n"),
-                        bugz_attachment_arguments.view ? "Viewing" : "Saving", 
+        fprintf(stderr, N_(" * Info: Viewing attachment: %s\n"),
                         json_object_to_json_string(file_name));
-        if (bugz_attachment_arguments.view) {
-            retval = 0;
-            bugz_base64_decode(json_object_get_string(data), stdout);
-        }
-        else {
-            char *p;
-            FILE *fp;
-            p = (char *)json_object_get_string(file_name);
-            if (access(p, R_OK) == 0)
-                fprintf(stderr, N_("ERROR: filename %s already exists\n"), p);
-            else if ((fp = fopen(p, "wb")) == NULL)
-                fprintf(stderr, N_("ERROR: failed to write into %s\n"), p);
-            else {
-                retval = 0;
-                bugz_base64_decode(json_object_get_string(data), fp);
-                fclose(fp);
-            }
-        }
+        retval = 0;
+        bugz_base64_decode(json_object_get_string(data), stdout);
         json_object_put(json);
     }
     curl_easy_cleanup(curl);
@@ -75,6 +75,7 @@ int bugz_component_main(int argc, char **argv) {
     int opt, longindex, retval = 1;
     struct bugz_config_t *config;
     struct curl_slist *headers = NULL;
+    struct bugz_json_t body = { 0 };
 
     optind++;
     while (optind < argc) {
@@ -163,31 +164,30 @@ int bugz_component_main(int argc, char **argv) {
     bugz_config_free(config);
     
     fprintf(stderr, N_(" * Info: Using %s\n"), base);
-    json = json_object_new_object();
+    bugz_json_begin(&body, NULL, '{');
     if (1) {
-        int j;
-        json_object *val;
+        size_t start;
+        struct curl_slist *val;
 
-        val = bugz_slist_to_json_string(bugz_component_arguments.name);
-        json_object_object_add(json, "name", val);
-        fprintf(stderr, " * Info: %-12s: %s\n", "Name", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_component_arguments.name);
+        bugz_json_last(&body, "name", val);
+        fprintf(stderr, " * Info: %-12s: %s\n", "Name", val ? val->data : "(null)");
 
-        val = bugz_slist_to_json_string(bugz_component_arguments.product);
-        json_object_object_add(json, "product", val);
-        fprintf(stderr, " * Info: %-12s: %s\n", "Product", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_component_arguments.product);
+        bugz_json_last(&body, "product", val);
+        fprintf(stderr, " * Info: %-12s: %s\n", "Product", val ? val->data : "(null)");
 
-        val = bugz_slist_to_json_string(bugz_component_arguments.description);
-        json_object_object_add(json, "description", val);
-        fprintf(stderr, " * Info: %-12s: %s\n", "Description", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_component_arguments.description);
+        bugz_json_last(&body, "description", val);
+        fprintf(stderr, " * Info: %-12s: %s\n", "Description", val ? val->data : "(null)");
 
-        val = bugz_slist_to_json_string(bugz_component_arguments.default_assignee);
-        json_object_object_add(json, "default_assignee", val);
-        fprintf(stderr, " * Info: %-12s: %s\n", "Default Assignee", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_component_arguments.default_assignee);
+        bugz_json_last(&body, "default_assignee", val);
+        fprintf(stderr, " * Info: %-12s: %s\n", "Default Assignee", val ? val->data : "(null)");
 
         if (bugz_component_arguments.default_cc) {
             char *q, *p;
             struct curl_slist *last = bugz_slist_get_last(bugz_component_arguments.default_cc);
-            val = json_object_new_array();
             p = last->data;
             q = p;
             while (*q) {
@@ -195,16 +195,20 @@ int bugz_component_main(int argc, char **argv) {
                     *q = ',';
                 q++;
             }
+            bugz_json_begin(&body, "default_cc", '[');
+            start = body.used - 1;
             q = strtok(p, ",");
             while (q != NULL){
                 if (strlen(q) > 0)
-                    json_object_array_add(val, json_object_new_string(q));
+                    bugz_json_string(&body, NULL, q);
                 q = strtok(NULL, ",");
             }
-            json_object_object_add(json, "default_cc", val);
-            fprintf(stderr, " * Info: %-12s: %s\n", "Default CC", json_object_get_string(val));
+            bugz_json_end(&body, ']');
+            fprintf(stderr, " * Info: %-12s: %.*s\n", "Default CC",
+                            (int)(body.used - start), body.data + start);
         }
     }
+    bugz_json_end(&body, '}');
     if (bugz_component_arguments.batch == FALSE) {
         char *p, confirm[1024] = {0};
         fprintf(stderr, "Confirm component submission (Y/n)? ");
@@ -214,14 +218,14 @@ int bugz_component_main(int argc, char **argv) {
             *p = '\0';
         if (strlen(confirm) == 0 || confirm[0] != 'Y') {
             fprintf(stderr, N_("Submission aborted\n"));
-            json_object_put(json);
+            bugz_json_free(&body);
             exit(1);
         }
     }
 
     if ((curl = curl_easy_init()) == NULL) {
         fprintf(stderr, N_("ERROR: %s component: curl_easy_init() failed\n"), argv[0]);
-        json_object_put(json);
+        bugz_json_free(&body);
         exit(1);
     }
     headers = curl_slist_append(headers, "charsets: utf-8");
@@ -229,7 +233,7 @@ int bugz_component_main(int argc, char **argv) {
     headers = curl_slist_append(headers, "Content-Type: application/json");
     curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(json));
+    bugz_json_setopt(curl, &body);
 
     bugz_get_result(curl, url, &json);
     if (bugz_check_result(json)) {
@@ -241,6 +245,7 @@ int bugz_component_main(int argc, char **argv) {
         json_object_put(json);
         retval = 0;
     }
+    bugz_json_free(&body);
     curl_easy_cleanup(curl);
 
     return retval;
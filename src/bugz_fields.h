@@ -0,0 +1,69 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+/*
+ * Bug fields known to the renderers, bugz_genfields builds the lookup
+ * table (bugz_fields_table.h) from this list at build time.
+ *
+ * _field_macro_(name, label, format, width)
+ *   format : skip, string, list (comma separated), lines (one per line)
+ *   width  : column width in search listings
+ */
+
+_field_macro_(id,                    "ID",         skip,   0)
+_field_macro_(assigned_to_detail,    NULL,         skip,   0)
+_field_macro_(is_cc_accessible,      NULL,         skip,   0)
+_field_macro_(creator_detail,        NULL,         skip,   0)
+_field_macro_(estimated_time,        NULL,         skip,   0)
+_field_macro_(remaining_time,        NULL,         skip,   0)
+_field_macro_(update_token,          NULL,         skip,   0)
+_field_macro_(classification,        NULL,         skip,   0)
+_field_macro_(cc_detail,             NULL,         skip,   0)
+_field_macro_(is_open,               NULL,         skip,   0)
+_field_macro_(actual_time,           NULL,         skip,   0)
+_field_macro_(is_creator_accessible, NULL,         skip,   0)
+_field_macro_(target_milestone,      NULL,         skip,   0)
+_field_macro_(is_confirmed,          NULL,         skip,   0)
+
+_field_macro_(summary,               "Title",      string, 0)
+_field_macro_(alias,                 "Alias",      list,   0)
+_field_macro_(assigned_to,           "Assignee",   string, 20)
+_field_macro_(creator,               "Reporter",   string, 20)
+_field_macro_(qa_contact,            "qaContact",  string, 20)
+_field_macro_(cc,                    "CC",         lines,  0)
+_field_macro_(product,               "Product",    string, 16)
+_field_macro_(component,             "Component",  string, 16)
+_field_macro_(version,               "Version",    string, 12)
+_field_macro_(platform,              "Platform",   string, 12)
+_field_macro_(op_sys,                "OpSystem",   string, 12)
+_field_macro_(status,                "Status",     string, 12)
+_field_macro_(resolution,            "Resolution", string, 12)
+_field_macro_(priority,              "Priority",   string, 12)
+_field_macro_(severity,              "Severity",   string, 12)
+_field_macro_(keywords,              "Keywords",   list,   0)
+_field_macro_(groups,                "Groups",     list,   0)
+_field_macro_(flags,                 "Flags",      list,   0)
+_field_macro_(blocks,                "Blocks",     list,   0)
+_field_macro_(depends_on,            "dependsOn",  string, 0)
+_field_macro_(dupe_of,               "dupeOf",     string, 0)
+_field_macro_(see_also,              "See Also",   lines,  0)
+_field_macro_(url,                   "URL",        string, 0)
+_field_macro_(whiteboard,            "Whiteboard", string, 0)
+_field_macro_(deadline,              "Deadline",   string, 0)
+_field_macro_(creation_time,         "Reported",   string, 20)
+_field_macro_(last_change_time,      "Updated",    string, 20)
+
+#ifdef _field_macro_
+#undef _field_macro_
+#endif
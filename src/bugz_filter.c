@@ -0,0 +1,513 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <time.h>
+
+#include "bugz.h"
+
+/*
+ * Filter expressions over a bug table, e.g.
+ *
+ *   status in (NEW,ASSIGNED) and priority <= P2 and last_change_time > -7d
+ *
+ * An expression is compiled into postfix code of comparisons, and, or and
+ * not. It runs a column at a time: each comparison fills a bitmap of the
+ * selected rows, interned columns are compared once per distinct value,
+ * and the operators combine bitmaps 64 rows per word.
+ *
+ */
+enum bugz_filter_code_t {
+    bugz_filter_cmp = 0,
+    bugz_filter_and,
+    bugz_filter_or,
+    bugz_filter_not
+};
+
+enum bugz_filter_cmp_t {
+    bugz_filter_eq = 0,
+    bugz_filter_ne,
+    bugz_filter_lt,
+    bugz_filter_le,
+    bugz_filter_gt,
+    bugz_filter_ge,
+    bugz_filter_match,  /* ~, substring */
+    bugz_filter_in,
+    bugz_filter_null,   /* = null, unquoted */
+    bugz_filter_notnull
+};
+
+struct bugz_filter_op_t {
+    int code;
+    int cmp;
+    const struct bugz_field_t *field;
+    int column;
+    int nvalues;
+    char **values;
+};
+
+struct bugz_filter_t {
+    struct bugz_filter_op_t *ops;
+    int nops;
+    int size;
+    int depth;          /* bitmaps needed to run the code */
+    /* parser state */
+    const char *expr;
+    const char *p;
+    char *error;
+    size_t errlen;
+};
+
+static void *bugz_filter_alloc(size_t size) {
+    void *p = calloc(1, size);
+    if (p == NULL) {
+        fprintf(stderr, "ERROR: allocate memory in bugz_filter_alloc failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+static int bugz_filter_fail(struct bugz_filter_t *f, const char *msg) {
+    if (f->error && f->errlen) {
+        if (*f->p)
+            snprintf(f->error, f->errlen, "%s at '%s'", msg, f->p);
+        else
+            snprintf(f->error, f->errlen, "%s at end of expression", msg);
+    }
+    return FALSE;
+}
+
+static struct bugz_filter_op_t *bugz_filter_emit(struct bugz_filter_t *f, int code) {
+    struct bugz_filter_op_t *op;
+    if (f->nops == f->size) {
+        f->size = f->size ? f->size * 2 : 16;
+        if ((op = (struct bugz_filter_op_t *)realloc(f->ops, f->size * sizeof(*op))) == NULL) {
+            fprintf(stderr, "ERROR: expand code in bugz_filter_emit failed\n");
+            exit(1);
+        }
+        f->ops = op;
+    }
+    op = &f->ops[f->nops++];
+    memset(op, 0, sizeof(*op));
+    op->code = code;
+    op->column = -1;
+    return op;
+}
+
+/*
+ * Tokens
+ */
+static void bugz_filter_space(struct bugz_filter_t *f) {
+    while (isspace((unsigned char)*f->p))
+        f->p++;
+}
+
+static int bugz_filter_punct(struct bugz_filter_t *f, const char *s) {
+    size_t len = strlen(s);
+    bugz_filter_space(f);
+    if (strncmp(f->p, s, len))
+        return FALSE;
+    f->p += len;
+    return TRUE;
+}
+
+static size_t bugz_filter_wordlen(const char *p) {
+    size_t n = 0;
+    while (p[n] && !isspace((unsigned char)p[n]) && strchr("(),=!<>~\"'", p[n]) == NULL)
+        n++;
+    return n;
+}
+
+/* keywords are whole words, in any case */
+static int bugz_filter_keyword(struct bugz_filter_t *f, const char *s) {
+    size_t len = strlen(s);
+    bugz_filter_space(f);
+    if (bugz_filter_wordlen(f->p) != len || strncasecmp(f->p, s, len))
+        return FALSE;
+    f->p += len;
+    return TRUE;
+}
+
+/* bare word or quoted string, newly allocated */
+static char *bugz_filter_word(struct bugz_filter_t *f) {
+    size_t n;
+    char *s;
+
+    bugz_filter_space(f);
+    if (*f->p == '"' || *f->p == '\'') {
+        char quote = *f->p;
+        const char *end = strchr(f->p + 1, quote);
+        if (end == NULL)
+            return NULL;
+        n = end - f->p - 1;
+        s = (char *)bugz_filter_alloc(n + 1);
+        memcpy(s, f->p + 1, n);
+        f->p = end + 1;
+        return s;
+    }
+    if ((n = bugz_filter_wordlen(f->p)) == 0)
+        return NULL;
+    s = (char *)bugz_filter_alloc(n + 1);
+    memcpy(s, f->p, n);
+    f->p += n;
+    return s;
+}
+
+/* -7d, -12h, -30m or -2w before now, as Bugzilla writes times */
+static char *bugz_filter_time(const char *s) {
+    char *end, *buf;
+    long n;
+    time_t now = time(NULL);
+    struct tm tm;
+
+    if (*s != '-' || !isdigit((unsigned char)s[1]))
+        return NULL;
+    n = strtol(s + 1, &end, 10);
+    switch (*end) {
+    case 's' : break;
+    case 'm' : n *= 60; break;
+    case 'h' : n *= 3600; break;
+    case 'd' : n *= 86400; break;
+    case 'w' : n *= 7 * 86400; break;
+    default  : return NULL;
+    }
+    if (end[1])
+        return NULL;
+    now -= n;
+    gmtime_r(&now, &tm);
+    buf = (char *)bugz_filter_alloc(32);
+    strftime(buf, 32, "%Y-%m-%dT%H:%M:%SZ", &tm);
+    return buf;
+}
+
+static void bugz_filter_value(struct bugz_filter_op_t *op, char *s) {
+    char *t;
+    if ((op->field == bugz_field_get(creation_time) ||
+         op->field == bugz_field_get(last_change_time) ||
+         op->field == bugz_field_get(deadline)) && (t = bugz_filter_time(s)) != NULL) {
+        free(s);
+        s = t;
+    }
+    op->values = (char **)realloc(op->values, (op->nvalues + 1) * sizeof(char *));
+    if (op->values == NULL) {
+        fprintf(stderr, "ERROR: expand values in bugz_filter_value failed\n");
+        exit(1);
+    }
+    op->values[op->nvalues++] = s;
+}
+
+/*
+ * Grammar
+ *
+ *   expr  : and ('or' and)*
+ *   and   : not ('and' not)*
+ *   not   : 'not' not | '(' expr ')' | field op value | field 'in' '(' value (',' value)* ')'
+ *   op    : = == != < <= > >= ~
+ *
+ * '= null' and '!= null' test for missing values, times also take -7d,
+ * -12h, -30m or -2w relative to now.
+ */
+static int bugz_filter_or_expr(struct bugz_filter_t *f, int depth);
+
+static int bugz_filter_compare(struct bugz_filter_t *f) {
+    static const struct { const char *s; int cmp; } ops[] = {
+        {"==", bugz_filter_eq}, {"!=", bugz_filter_ne}, {"<=", bugz_filter_le},
+        {">=", bugz_filter_ge}, {"=",  bugz_filter_eq}, {"<",  bugz_filter_lt},
+        {">",  bugz_filter_gt}, {"~",  bugz_filter_match}, { 0 }
+    };
+    int i;
+    char *s;
+    const char *start;
+    struct bugz_filter_op_t *op;
+    const struct bugz_field_t *field;
+
+    bugz_filter_space(f);
+    start = f->p;
+    if ((s = bugz_filter_word(f)) == NULL)
+        return bugz_filter_fail(f, "expected a field");
+    field = bugz_field_lookup(s, strlen(s));
+    free(s);
+    if (field == NULL) {
+        f->p = start;
+        return bugz_filter_fail(f, "unknown field");
+    }
+    op = bugz_filter_emit(f, bugz_filter_cmp);
+    op->field = field;
+    if (bugz_filter_keyword(f, "in")) {
+        op->cmp = bugz_filter_in;
+        if (!bugz_filter_punct(f, "("))
+            return bugz_filter_fail(f, "expected '('");
+        do {
+            if ((s = bugz_filter_word(f)) == NULL)
+                return bugz_filter_fail(f, "expected a value");
+            bugz_filter_value(op, s);
+        } while (bugz_filter_punct(f, ","));
+        if (!bugz_filter_punct(f, ")"))
+            return bugz_filter_fail(f, "expected ')'");
+        return TRUE;
+    }
+    for (i=0; ops[i].s; i++) {
+        if (bugz_filter_punct(f, ops[i].s))
+            break;
+    }
+    if (ops[i].s == NULL)
+        return bugz_filter_fail(f, "expected an operator");
+    op->cmp = ops[i].cmp;
+    bugz_filter_space(f);
+    if ((op->cmp == bugz_filter_eq || op->cmp == bugz_filter_ne) && bugz_filter_keyword(f, "null")) {
+        op->cmp = op->cmp == bugz_filter_eq ? bugz_filter_null : bugz_filter_notnull;
+        return TRUE;
+    }
+    if ((s = bugz_filter_word(f)) == NULL)
+        return bugz_filter_fail(f, "expected a value");
+    bugz_filter_value(op, s);
+    return TRUE;
+}
+
+static int bugz_filter_not_expr(struct bugz_filter_t *f, int depth) {
+    if (depth > 64)
+        return bugz_filter_fail(f, "nested too deep");
+    if (bugz_filter_keyword(f, "not")) {
+        if (!bugz_filter_not_expr(f, depth + 1))
+            return FALSE;
+        bugz_filter_emit(f, bugz_filter_not);
+        return TRUE;
+    }
+    if (bugz_filter_punct(f, "(")) {
+        if (!bugz_filter_or_expr(f, depth + 1))
+            return FALSE;
+        if (!bugz_filter_punct(f, ")"))
+            return bugz_filter_fail(f, "expected ')'");
+        return TRUE;
+    }
+    return bugz_filter_compare(f);
+}
+
+static int bugz_filter_and_expr(struct bugz_filter_t *f, int depth) {
+    if (!bugz_filter_not_expr(f, depth))
+        return FALSE;
+    while (bugz_filter_keyword(f, "and")) {
+        if (!bugz_filter_not_expr(f, depth))
+            return FALSE;
+        bugz_filter_emit(f, bugz_filter_and);
+    }
+    return TRUE;
+}
+
+static int bugz_filter_or_expr(struct bugz_filter_t *f, int depth) {
+    if (!bugz_filter_and_expr(f, depth))
+        return FALSE;
+    while (bugz_filter_keyword(f, "or")) {
+        if (!bugz_filter_and_expr(f, depth))
+            return FALSE;
+        bugz_filter_emit(f, bugz_filter_or);
+    }
+    return TRUE;
+}
+
+void bugz_filter_free(struct bugz_filter_t *f) {
+    int i, j;
+    if (f == NULL)
+        return;
+    for (i=0; i<f->nops; i++) {
+        for (j=0; j<f->ops[i].nvalues; j++)
+            free(f->ops[i].values[j]);
+        free(f->ops[i].values);
+    }
+    free(f->ops);
+    free(f);
+}
+
+/* NULL and a message in error if the expression is not valid */
+struct bugz_filter_t *bugz_filter_compile(const char *expr, char *error, size_t errlen) {
+    int i, depth = 0;
+    struct bugz_filter_t *f;
+
+    f = (struct bugz_filter_t *)bugz_filter_alloc(sizeof(*f));
+    f->expr = f->p = expr;
+    f->error = error;
+    f->errlen = errlen;
+    if (!bugz_filter_or_expr(f, 0)) {
+        bugz_filter_free(f);
+        return NULL;
+    }
+    bugz_filter_space(f);
+    if (*f->p) {
+        bugz_filter_fail(f, "unexpected text");
+        bugz_filter_free(f);
+        return NULL;
+    }
+    for (i=0; i<f->nops; i++) {
+        depth += f->ops[i].code == bugz_filter_cmp ? 1 :
+                 f->ops[i].code == bugz_filter_not ? 0 : -1;
+        if (depth > f->depth)
+            f->depth = depth;
+    }
+    return f;
+}
+
+/* columns of the fields compared, before the table is filled */
+int bugz_filter_bind(struct bugz_filter_t *f, struct bugz_table_t *t) {
+    int i;
+    for (i=0; i<f->nops; i++) {
+        if (f->ops[i].code != bugz_filter_cmp)
+            continue;
+        if ((f->ops[i].column = bugz_table_column(t, f->ops[i].field)) < 0)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Evaluation
+ */
+static int bugz_filter_test(const struct bugz_filter_op_t *op, const char *s) {
+    int i, r;
+
+    if (op->cmp == bugz_filter_null || op->cmp == bugz_filter_notnull)
+        return (s == NULL) == (op->cmp == bugz_filter_null);
+    if (s == NULL)
+        return op->cmp == bugz_filter_ne;
+    for (i=0; i<op->nvalues; i++) {
+        switch (op->cmp) {
+        case bugz_filter_match :
+            if (strstr(s, op->values[i]))
+                return TRUE;
+            continue;
+        case bugz_filter_in :
+            if (strcmp(s, op->values[i]) == 0)
+                return TRUE;
+            continue;
+        }
+        r = strcmp(s, op->values[i]);
+        switch (op->cmp) {
+        case bugz_filter_eq : return r == 0;
+        case bugz_filter_ne : return r != 0;
+        case bugz_filter_lt : return r < 0;
+        case bugz_filter_le : return r <= 0;
+        case bugz_filter_gt : return r > 0;
+        case bugz_filter_ge : return r >= 0;
+        }
+    }
+    return FALSE;
+}
+
+static int bugz_filter_test_int(const struct bugz_filter_op_t *op, long v) {
+    int i;
+    long x;
+
+    if (op->cmp == bugz_filter_null || op->cmp == bugz_filter_notnull)
+        return (v == 0) == (op->cmp == bugz_filter_null);
+    for (i=0; i<op->nvalues; i++) {
+        x = strtol(op->values[i], NULL, 10);
+        switch (op->cmp) {
+        case bugz_filter_in :
+            if (v == x)
+                return TRUE;
+            continue;
+        case bugz_filter_match : {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%ld", v);
+            if (strstr(buf, op->values[i]))
+                return TRUE;
+            continue;
+        }
+        case bugz_filter_eq : return v == x;
+        case bugz_filter_ne : return v != x;
+        case bugz_filter_lt : return v < x;
+        case bugz_filter_le : return v <= x;
+        case bugz_filter_gt : return v > x;
+        case bugz_filter_ge : return v >= x;
+        }
+    }
+    return FALSE;
+}
+
+static void bugz_filter_column(const struct bugz_filter_op_t *op, const struct bugz_table_t *t,
+                               uint64_t *bits) {
+    int i, row;
+    uint32_t cell, n;
+    unsigned char *match;
+    const struct bugz_table_column_t *col = &t->columns[op->column];
+
+    switch (col->kind) {
+    case bugz_table_symbol :
+        /* once per distinct value, null is the last entry */
+        n = t->nsymbols;
+        match = (unsigned char *)bugz_filter_alloc(n + 1);
+        for (cell=0; cell<n; cell++)
+            match[cell] = bugz_filter_test(op, t->symbols + t->offsets[cell]);
+        match[n] = bugz_filter_test(op, NULL);
+        for (i=0; i<t->selected; i++) {
+            cell = col->cells[t->order[i]];
+            if (match[cell == BUGZ_TABLE_NULL ? n : cell])
+                bits[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+        free(match);
+        break;
+    case bugz_table_int :
+        for (i=0; i<t->selected; i++) {
+            if (bugz_filter_test_int(op, (int)col->cells[t->order[i]]))
+                bits[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+        break;
+    default :
+        for (i=0; i<t->selected; i++) {
+            row = t->order[i];
+            cell = col->cells[row];
+            if (bugz_filter_test(op, cell == BUGZ_TABLE_NULL ? NULL : col->text + cell))
+                bits[i >> 6] |= (uint64_t)1 << (i & 63);
+        }
+    }
+}
+
+/* keep the selected rows matching the expression, in order */
+int bugz_filter_apply(const struct bugz_filter_t *f, struct bugz_table_t *t) {
+    int i, j, sp = 0, n = 0;
+    size_t w, words = ((size_t)t->selected + 63) / 64;
+    uint64_t *stack, *a, *b;
+
+    if (f->nops == 0 || t->selected == 0)
+        return t->selected;
+    stack = (uint64_t *)bugz_filter_alloc(f->depth * words * sizeof(uint64_t) + 1);
+    for (i=0; i<f->nops; i++) {
+        const struct bugz_filter_op_t *op = &f->ops[i];
+        switch (op->code) {
+        case bugz_filter_cmp :
+            a = stack + sp++ * words;
+            memset(a, 0, words * sizeof(uint64_t));
+            bugz_filter_column(op, t, a);
+            break;
+        case bugz_filter_not :
+            a = stack + (sp - 1) * words;
+            for (w=0; w<words; w++)
+                a[w] = ~a[w];
+            break;
+        default :
+            a = stack + (sp - 2) * words;
+            b = stack + --sp * words;
+            if (op->code == bugz_filter_and)
+                for (w=0; w<words; w++)
+                    a[w] &= b[w];
+            else
+                for (w=0; w<words; w++)
+                    a[w] |= b[w];
+        }
+    }
+    for (j=0; j<t->selected; j++) {
+        if (stack[j >> 6] & ((uint64_t)1 << (j & 63)))
+            t->order[n++] = t->order[j];
+    }
+    free(stack);
+    return t->selected = n;
+}
@@ -0,0 +1,75 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+/*
+ * Build time generator of the perfect hash table for bugz_fields.h,
+ * fails the build when two fields hash to the same value.
+ *
+ */
+#include "bugz.h"
+
+static const char *names[] = {
+    #define _field_macro_(n,l,f,w) #n,
+    #include "bugz_fields.h"
+};
+#define NFIELDS (sizeof(names)/sizeof(names[0]))
+
+int main(int argc, char **argv) {
+    int bits, shift;
+    uint32_t seed, hashes[NFIELDS];
+    size_t i, j;
+
+    for (i=0; i<NFIELDS; i++) {
+        hashes[i] = jenkins_one_at_a_time_hash(names[i], strlen(names[i]));
+        for (j=0; j<i; j++) {
+            if (hashes[i] == hashes[j]) {
+                fprintf(stderr, "ERROR: %s: fields '%s' and '%s' %s (0x%08x)\n", argv[0],
+                                names[j], names[i], strcmp(names[i], names[j]) ?
+                                "collide" : "are duplicated", hashes[i]);
+                return 1;
+            }
+        }
+    }
+
+    for (bits=1; (1U << bits) < NFIELDS; bits++)
+        ;
+    for (; bits<16; bits++) {
+        shift = 32 - bits;
+        for (seed=0; seed<(1U << 20); seed++) {
+            signed char slots[1 << 16];
+            memset(slots, -1, 1U << bits);
+            for (i=0; i<NFIELDS; i++) {
+                uint32_t s = bugz_field_slot(hashes[i], seed, shift);
+                if (slots[s] >= 0)
+                    break;
+                slots[s] = (signed char)i;
+            }
+            if (i < NFIELDS)
+                continue;
+            fprintf(stdout, "/* generated by bugz_genfields from bugz_fields.h, do not edit */\n\n");
+            fprintf(stdout, "#define BUGZ_FIELD_SEED  0x%08xU\n", seed);
+            fprintf(stdout, "#define BUGZ_FIELD_SHIFT %d\n\n", shift);
+            fprintf(stdout, "static const signed char bugz_field_slots[%u] = {", 1U << bits);
+            for (i=0; i<(1U << bits); i++)
+                fprintf(stdout, "%s%3d,", i % 16 ? " " : "\n    ", slots[i]);
+            fprintf(stdout, "\n};\n\nstatic const uint32_t bugz_field_hashes[%u] = {", (unsigned)NFIELDS);
+            for (i=0; i<NFIELDS; i++)
+                fprintf(stdout, "%s0x%08xU,", i % 6 ? " " : "\n    ", hashes[i]);
+            fprintf(stdout, "\n};\n");
+            return 0;
+        }
+    }
+    fprintf(stderr, "ERROR: %s: no perfect hash found for %u fields\n", argv[0], (unsigned)NFIELDS);
+    return 1;
+}
@@ -12,12 +12,15 @@
  *
  */
 
+#include <stdarg.h>
+
 #include "bugz.h"
 
 static struct option bugz_get_options[] = {
     {"help",           no_argument, 0, 'h'},
     {"no-attachments", no_argument, 0, 'a'},
     {"no-comments",    no_argument, 0, 'n'},
+    {"comments",       required_argument, 0, 0},
     { 0 }
 };
 
@@ -33,6 +36,8 @@ void bugz_get_helper(int status) {
        "-h [--help]           : show this help message and exit\n"
        "-a [--no-attachments] : do not show attachments\n"
        "-n [--no-comments]    : do not show comments\n"
+       "--comments SELECTION  : only get the selected comments, one of\n"
+       "                        last:N, since:TIME or ids:ID[,ID...]\n"
        "\n"
        "Type 'bugz --help' for valid global options\n");
     fprintf(stderr, "%s", help_header);
@@ -43,34 +48,182 @@ struct bugz_get_arguments_t {
     int bug;
     int no_comments;
     int no_attachments;
+    int comments_last;
+    char *comments_since;               /* urlencoded new_since=TIME */
+    struct curl_slist *comment_ids;
 };
 static struct bugz_get_arguments_t bugz_get_arguments = { 0 };
 
-static json_object *bugz_fetch_comments(CURL *curl, char *base, char *username, char *password) {
-    char buf[PATH_MAX] = {0};
-    json_object *json = NULL;
-    json_object *comments = NULL;
+/* path is relative to base and may carry its own query */
+static void bugz_get_url(char *buf, char *base, char *username, char *password,
+                         const char *fmt, ...) {
+    int i;
+    va_list ap;
 
+    i = snprintf(buf, PATH_MAX, "%s", base);
+    va_start(ap, fmt);
+    vsnprintf(buf + i, PATH_MAX - i, fmt, ap);
+    va_end(ap);
     if (password)
-        sprintf(buf, "%s/rest/bug/%d/comment?login=%s&password=%s", base,
-                bugz_get_arguments.bug, username, password);
+        sprintf(buf + strlen(buf), "%clogin=%s&password=%s",
+                strchr(buf, '?') ? '&' : '?', username, password);
     else if (username)
-        sprintf(buf, "%s/rest/bug/%d/comment?api_key=%s", base,
-                bugz_get_arguments.bug, username);
-    else
-        sprintf(buf, "%s/rest/bug/%d/comment", base, bugz_get_arguments.bug);
+        sprintf(buf + strlen(buf), "%capi_key=%s",
+                strchr(buf, '?') ? '&' : '?', username);
+}
+
+static int bugz_get_parse_comments(const char *optarg) {
+    char *p, *q;
+    if (strncmp(optarg, "last:", 5) == 0) {
+        bugz_get_arguments.comments_last = atoi(optarg + 5);
+        return bugz_get_arguments.comments_last > 0;
+    }
+    if (strncmp(optarg, "since:", 6) == 0) {
+        json_object *json = json_object_new_object();
+        json_object_object_add(json, "new_since", json_object_new_string(optarg + 6));
+        bugz_get_arguments.comments_since = bugz_urlencode(json);
+        json_object_put(json);
+        return optarg[6] != '\0';
+    }
+    if (strncmp(optarg, "ids:", 4) == 0) {
+        p = strdup(optarg + 4);
+        for (q = strtok(p, ","); q; q = strtok(NULL, ",")) {
+            if (atoi(q) <= 0) {
+                free(p);
+                return FALSE;
+            }
+            bugz_get_arguments.comment_ids = \
+            curl_slist_append(bugz_get_arguments.comment_ids, q);
+        }
+        free(p);
+        return bugz_get_arguments.comment_ids != NULL;
+    }
+    return FALSE;
+}
 
+/*
+ * last:N is turned into ids:... from a listing of the comment ids only,
+ * so just the wanted comments are downloaded in full. FALSE if the
+ * listing failed.
+ */
+static int bugz_get_last_comments(CURL *curl, char *base, char *username, char *password) {
+    char buf[PATH_MAX] = {0};
+    int i, n, retval;
+    json_object *json = NULL, *bugs, *bug, *comments = NULL, *id;
+
+    bugz_get_url(buf, base, username, password, "/rest/bug/%d/comment?include_fields=id",
+                 bugz_get_arguments.bug);
     bugz_get_result(curl, buf, &json);
-    if (bugz_check_result(json)) {
-        json_object *bug = NULL, *bugs;
-        json_object_object_get_ex(json, "bugs", &bugs);
-        if (bugs) {
-            sprintf(buf, "%d", bugz_get_arguments.bug);
-            json_object_object_get_ex(bugs, buf, &bug);
-            if (bug)
-                json_object_object_get_ex(bug, "comments", &comments);
+    if ((retval = bugz_check_result(json))) {
+        sprintf(buf, "%d", bugz_get_arguments.bug);
+        if (json_object_object_get_ex(json, "bugs", &bugs) &&
+            json_object_object_get_ex(bugs, buf, &bug))
+            json_object_object_get_ex(bug, "comments", &comments);
+        n = comments ? json_object_array_length(comments) : 0;
+        /* with no more than N, all of them as without --comments */
+        for (i = n > bugz_get_arguments.comments_last ? n - bugz_get_arguments.comments_last : n; i<n; i++) {
+            json_object_object_get_ex(json_object_array_get_idx(comments, i), "id", &id);
+            bugz_get_arguments.comment_ids = \
+            curl_slist_append(bugz_get_arguments.comment_ids, json_object_get_string(id));
         }
     }
+    json_object_put(json);
+    return retval;
+}
+
+/*
+ * URL of the request for the comments selected by --comments and the
+ * path of the comments in its response, selected ids are all fetched at
+ * once as /rest/bug/comment/ID?comment_ids=ID&comment_ids=... FALSE when
+ * they do not fit in the URL.
+ */
+static int bugz_get_comments_url(char *buf, const char **path,
+                                 char *base, char *username, char *password) {
+    struct curl_slist *id = bugz_get_arguments.comment_ids;
+    char ids[PATH_MAX / 2];
+    size_t len = 0;
+    int n;
+
+    if (id == NULL) {
+        *path = "bugs.*.comments";
+        if (bugz_get_arguments.comments_since)
+            bugz_get_url(buf, base, username, password, "/rest/bug/%d/comment?%s",
+                         bugz_get_arguments.bug, bugz_get_arguments.comments_since);
+        else
+            bugz_get_url(buf, base, username, password, "/rest/bug/%d/comment",
+                         bugz_get_arguments.bug);
+        return TRUE;
+    }
+    ids[0] = '\0';
+    for (id = id->next; id; id = id->next) {
+        n = snprintf(ids + len, sizeof(ids) - len, "%ccomment_ids=%s", len ? '&' : '?', id->data);
+        if (n < 0 || (size_t)n >= sizeof(ids) - len) {
+            fprintf(stderr, N_("ERROR: too many comments selected\n"));
+            return FALSE;
+        }
+        len += n;
+    }
+    *path = "comments.*";
+    bugz_get_url(buf, base, username, password, "/rest/bug/comment/%s%s",
+                 bugz_get_arguments.comment_ids->data, ids);
+    return TRUE;
+}
+
+/* comments selected by id may belong to other bugs than the one shown */
+static int bugz_get_comment_of_bug(json_object *comment) {
+    json_object *bug_id;
+    return !json_object_object_get_ex(comment, "bug_id", &bug_id) ||
+           json_object_get_int(bug_id) == bugz_get_arguments.bug;
+}
+
+static int bugz_get_comment_callback(json_object *record, void *userp) {
+    if (bugz_get_comment_of_bug(record) == FALSE)
+        return 0;
+    return bugz_output_callback(record, userp);
+}
+
+static int bugz_get_comment_compare(const void *a, const void *b) {
+    json_object *x = *(json_object **)a, *y = *(json_object **)b;
+    return bugz_doc_int(x, "id", 0) - bugz_doc_int(y, "id", 0);
+}
+
+/* the comments selected by --comments, NULL on failure */
+static json_object *bugz_fetch_comments(CURL *curl, char *base, char *username, char *password) {
+    char buf[PATH_MAX] = {0};
+    const char *path;
+    json_object *json = NULL, *bug = NULL, *bugs, *list = NULL;
+    json_object *comments = NULL;
+
+    if (!bugz_get_comments_url(buf, &path, base, username, password))
+        return NULL;
+    bugz_get_result(curl, buf, &json);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        return NULL;
+    }
+    if (bugz_get_arguments.comment_ids) {
+        comments = json_object_new_array();
+        json_object_object_get_ex(json, "comments", &list);
+        if (list) {
+            json_object_object_foreach(list, key, val) {
+                (void)key;
+                if (bugz_get_comment_of_bug(val))
+                    json_object_array_add(comments, json_object_get(val));
+            }
+        }
+        /* the response is an object, keyed by comment id */
+        json_object_array_sort(comments, bugz_get_comment_compare);
+    }
+    else {
+        sprintf(buf, "%d", bugz_get_arguments.bug);
+        if (json_object_object_get_ex(json, "bugs", &bugs))
+            json_object_object_get_ex(bugs, buf, &bug);
+        if (bug && json_object_object_get_ex(bug, "comments", &list))
+            comments = json_object_get(list);
+        else
+            comments = json_object_new_array();
+    }
+    json_object_put(json);
     return comments;
 }
 
@@ -79,14 +232,8 @@ static json_object *bugz_fetch_attachments(CURL *curl, char *base, char *usernam
     json_object *json = NULL;
     json_object *attachments = NULL;
 
-    if (password)
-        sprintf(buf, "%s/rest/bug/%d/attachment?login=%s&password=%s", base,
-                bugz_get_arguments.bug, username, password);
-    else if (username)
-        sprintf(buf, "%s/rest/bug/%d/attachment?api_key=%s", base,
-                bugz_get_arguments.bug, username);
-    else
-        sprintf(buf, "%s/rest/bug/%d/attachment", base, bugz_get_arguments.bug);
+    bugz_get_url(buf, base, username, password, "/rest/bug/%d/attachment",
+                 bugz_get_arguments.bug);
 
     bugz_get_result(curl, buf, &json);
     if (bugz_check_result(json)) {
@@ -100,6 +247,56 @@ static json_object *bugz_fetch_attachments(CURL *curl, char *base, char *usernam
     return attachments;
 }
 
+/*
+ * --output other than text, the bug, its attachments (without data) and
+ * comments are each written as records while being received, in tsv/csv
+ * with a leading kind column when there is more than one kind.
+ */
+static int bugz_get_output(CURL *curl, char *base, char *username, char *password) {
+    int kind, kinds = 1 << bugz_record_bug, raw = bugz_arguments.output_format == bugz_output_raw;
+    char url[PATH_MAX] = {0};
+    const char *path;
+    json_object *json;
+
+    if (!bugz_get_arguments.no_comments)
+        kinds |= 1 << bugz_record_comment;
+    if (!bugz_get_arguments.no_attachments)
+        kinds |= 1 << bugz_record_attachment;
+    bugz_output_headers(&bugz_stdout, kinds);
+    for (kind=bugz_record_bug; kind<=bugz_record_attachment; kind++) {
+        struct bugz_output_t output = { kind, bugz_get_arguments.bug, 0 };
+        bugz_record_callback_t callback = bugz_output_callback;
+        if ((kinds & (1 << kind)) == 0)
+            continue;
+        if (kind == bugz_record_comment) {
+            if (!bugz_get_comments_url(url, &path, base, username, password))
+                return 1;
+            callback = bugz_get_comment_callback;
+        }
+        else if (kind == bugz_record_bug) {
+            path = "bugs";
+            bugz_get_url(url, base, username, password, "/rest/bug/%d",
+                         bugz_get_arguments.bug);
+        }
+        else {
+            path = "bugs.*";
+            bugz_get_url(url, base, username, password,
+                         "/rest/bug/%d/attachment?exclude_fields=data",
+                         bugz_get_arguments.bug);
+        }
+        bugz_get_records(curl, url, raw ? NULL : path, callback, &output, &json);
+        if (raw)
+            bugz_sink_write(&bugz_stdout, "\n", 1);
+        bugz_sink_flush(&bugz_stdout);
+        if (bugz_check_result(json) == FALSE) {
+            json_object_put(json);
+            return 1;
+        }
+        json_object_put(json);
+    }
+    return 0;
+}
+
 int bugz_get_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
@@ -131,6 +328,12 @@ int bugz_get_main(int argc, char **argv) {
         case -1 :
             bugz_get_arguments.bug = atoi(argv[optind++]);
             break;
+        case 0 :
+            if (bugz_get_parse_comments(optarg) == FALSE) {
+                fprintf(stderr, N_("ERROR: %s get: invalid '--comments %s'\n"), argv[0], optarg);
+                bugz_get_helper(1);
+            }
+            break;
         }
     } 
     if (bugz_get_arguments.bug <= 0) {
@@ -156,14 +359,7 @@ int bugz_get_main(int argc, char **argv) {
             exit(1);
         }
     }
-    if (password)
-        sprintf(url, "%s/rest/bug/%d?login=%s&password=%s", base,
-                bugz_get_arguments.bug, username, password);
-    else if (username)
-        sprintf(url, "%s/rest/bug/%d?api_key=%s", base,
-                bugz_get_arguments.bug, username);
-    else
-        sprintf(url, "%s/rest/bug/%d", base, bugz_get_arguments.bug);
+    bugz_get_url(url, base, username, password, "/rest/bug/%d", bugz_get_arguments.bug);
 
     bugz_config_free(config);
     if ((curl = curl_easy_init()) == NULL) {
@@ -177,6 +373,17 @@ int bugz_get_main(int argc, char **argv) {
     
     fprintf(stderr, N_(" * Info: Using %s\n")
                     N_(" * Info: Getting bug %d ..\n"), base, bugz_get_arguments.bug);
+    if (bugz_get_arguments.comments_last > 0 && bugz_get_arguments.no_comments == FALSE &&
+        bugz_get_last_comments(curl, base, username, password) == FALSE) {
+        curl_easy_cleanup(curl);
+        return 1;
+    }
+
+    if (bugz_arguments.output_format != bugz_output_text) {
+        retval = bugz_get_output(curl, base, username, password);
+        curl_easy_cleanup(curl);
+        return retval;
+    }
 
     bugz_get_result(curl, url, &json);
     if (bugz_check_result(json)) {
@@ -187,9 +394,13 @@ int bugz_get_main(int argc, char **argv) {
         if (bugz_get_arguments.no_attachments == FALSE)
             attachments = bugz_fetch_attachments(curl,
                           base, username, password);
-        if (bugz_get_arguments.no_comments == FALSE)
-            comments = bugz_fetch_comments(curl,
-                       base, username, password);
+        if (bugz_get_arguments.no_comments == FALSE &&
+           (comments = bugz_fetch_comments(curl, base, username, password)) == NULL) {
+            json_object_put(attachments);
+            json_object_put(json);
+            curl_easy_cleanup(curl);
+            return 1;
+        }
         json_object_object_get_ex(json, "bugs", &bugs);
         for (j=0; j<json_object_array_length(bugs); j++) {
             bug = json_object_array_get_idx(bugs, j);
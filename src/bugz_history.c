@@ -17,20 +17,24 @@
 static struct option bugz_history_options[] = {
     {"help",      no_argument,       0, 'h'},
     {"new-since", required_argument, 0, 'n'},
+    {"jobs",      required_argument, 0, 'j'},
+    {"merge",     no_argument,       0, 'm'},
     { 0 }
 };
 
 void bugz_history_helper(int status) {
     char help_header[] =
-    N_("Usage: bugz history [options] bug\n"
-       "Get the history for a specific bug\n"
+    N_("Usage: bugz history [options] bug [bug ...]\n"
+       "Get the history for specific bugs\n"
        "\n"
        "Arguments:\n"
-       "bug      : the ID of the bug to retrieve\n"
+       "bug      : the ID of the bug to retrieve, - to read IDs from stdin\n"
        "\n"
        "Valid options:\n"
        "-h [--help]           : show this help message and exit\n"
        "-n [--new-since]      : only changes newer than this time\n"
+       "-j [--jobs] JOBS      : number of bugs fetched at a time (default: 8)\n"
+       "-m [--merge]          : merge histories into one timeline sorted by time\n"
        "\n"
        "Type 'bugz --help' for valid global options\n");
     fprintf(stderr, "%s", help_header);
@@ -40,11 +44,199 @@ void bugz_history_helper(int status) {
 struct bugz_history_arguments_t {
     int bug;
     struct curl_slist *new_since;
+    int *bugs;
+    int nbugs;
+    int jobs;
+    int merge;
 };
 static struct bugz_history_arguments_t bugz_history_arguments = { 0 };
 #define _append_history_arg_(m) bugz_history_arguments.m = \
                                 curl_slist_append(bugz_history_arguments.m, optarg)
 
+/* --output other than text, history entries are written while being received */
+static int bugz_history_output(CURL *curl, const char *url) {
+    json_object *json;
+    struct bugz_output_t output = { bugz_record_history, bugz_history_arguments.bug, 0 };
+    int raw = bugz_arguments.output_format == bugz_output_raw;
+
+    bugz_output_header(&bugz_stdout, bugz_record_history);
+    bugz_get_records(curl, url, raw ? NULL : "bugs.*.history", bugz_output_callback, &output, &json);
+    bugz_sink_flush(&bugz_stdout);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        return 1;
+    }
+    json_object_put(json);
+    return 0;
+}
+
+static void bugz_history_add_bug(int bug) {
+    int *p;
+    if ((bugz_history_arguments.nbugs & 63) == 0) {
+        p = (int *)realloc(bugz_history_arguments.bugs,
+                           (bugz_history_arguments.nbugs + 64) * sizeof(int));
+        if (p == NULL)
+            return;
+        bugz_history_arguments.bugs = p;
+    }
+    bugz_history_arguments.bugs[bugz_history_arguments.nbugs++] = bug;
+    bugz_history_arguments.bug = bug;
+}
+
+static void bugz_history_show_changes(json_object *changes) {
+    int k;
+    json_object *item, *added, *removed, *field_name;
+
+    for (k=0; k<json_object_array_length(changes); k++) {
+        item = json_object_array_get_idx(changes, k);
+        json_object_object_get_ex(item, "added", &added); 
+        json_object_object_get_ex(item, "removed", &removed); 
+        json_object_object_get_ex(item, "field_name", &field_name);
+        fprintf(stdout, "%s removed: %s\n",
+                json_object_get_string(field_name),
+                json_object_get_string(removed)); 
+        fprintf(stdout, "%s added  : %s\n\n",
+                json_object_get_string(field_name),
+                json_object_get_string(added)); 
+    }
+}
+
+static void bugz_history_show_entry(json_object *entry, const char *tag, int n) {
+    int k;
+    json_object *who, *when, *changes;
+
+    json_object_object_get_ex(entry, "who", &who);
+    json_object_object_get_ex(entry, "when", &when);
+    json_object_object_get_ex(entry, "changes", &changes);
+    fprintf(stdout, "[%s #%d] %s : %s\n", tag, n,
+            json_object_get_string(when),
+            json_object_get_string(who));
+    for (k=0; k<bugz_arguments.columns; k++) fprintf(stdout, "%c", '-');
+    fprintf(stdout, "\n");
+    bugz_history_show_changes(changes);
+}
+
+/*
+ * Many bugs, fetched bugz_history_arguments.jobs at a time. Without
+ * --merge each bug is written as soon as it arrives, with --merge the
+ * entries of all bugs are collected and written sorted by when.
+ */
+struct bugz_history_multi_t {
+    json_object *entries;   /* --merge */
+    struct bugz_output_t output;
+    int failures;           /* errors returned by the server */
+};
+
+static void bugz_history_multi_callback(int index, json_object *json, void *userp) {
+    struct bugz_history_multi_t *multi = (struct bugz_history_multi_t *)userp;
+    int i, j, k;
+    json_object *bugs, *bug, *history, *entry;
+
+    if (bugz_check_result(json) == FALSE) {
+        if (json) /* NULL is counted by bugz_get_multi() */
+            multi->failures++;
+        return;
+    }
+    if (bugz_arguments.output_format == bugz_output_raw && !bugz_history_arguments.merge) {
+        bugz_sink_printf(&bugz_stdout, "%s\n",
+                         json_object_to_json_string_ext(json, JSON_C_TO_STRING_PLAIN));
+        bugz_sink_flush(&bugz_stdout);
+        return;
+    }
+    json_object_object_get_ex(json, "bugs", &bugs);
+    for (j=0; j<json_object_array_length(bugs); j++) {
+        bug = json_object_array_get_idx(bugs, j);
+        if (!json_object_object_get_ex(bug, "history", &history))
+            continue;
+        k = bugz_history_arguments.bugs[index];
+        if (bugz_arguments.output_format == bugz_output_text && !bugz_history_arguments.merge)
+            fprintf(stdout, "[Bug %d]\n\n", k);
+        for (i=0; i<json_object_array_length(history); i++) {
+            entry = json_object_array_get_idx(history, i);
+            json_object_object_add(entry, "bug_id", json_object_new_int(k));
+            if (bugz_history_arguments.merge) {
+                json_object_array_add(multi->entries, json_object_get(entry));
+                continue;
+            }
+            if (bugz_arguments.output_format != bugz_output_text) {
+                bugz_output_callback(entry, &multi->output);
+                continue;
+            }
+            bugz_history_show_entry(entry, "History", i);
+        }
+    }
+    bugz_sink_flush(&bugz_stdout);
+    fflush(stdout);
+}
+
+static int bugz_history_compare(const void *a, const void *b) {
+    json_object *x = *(json_object **)a, *y = *(json_object **)b;
+    json_object *wx = NULL, *wy = NULL, *bx = NULL, *by = NULL;
+    const char *sx, *sy;
+    int c;
+
+    /* ISO 8601 UTC times sort as strings */
+    json_object_object_get_ex(x, "when", &wx);
+    json_object_object_get_ex(y, "when", &wy);
+    sx = json_object_get_string(wx);
+    sy = json_object_get_string(wy);
+    if ((c = strcmp(sx ? sx : "", sy ? sy : "")) != 0)
+        return c;
+    json_object_object_get_ex(x, "bug_id", &bx);
+    json_object_object_get_ex(y, "bug_id", &by);
+    return json_object_get_int(bx) - json_object_get_int(by);
+}
+
+static int bugz_history_multi(struct curl_slist *headers, const char *base, const char *query) {
+    int i, k, failures;
+    char **urls;
+    struct bugz_history_multi_t multi = { NULL, { bugz_record_history, 0, 0 }, 0 };
+
+    urls = (char **)malloc(bugz_history_arguments.nbugs * sizeof(char *));
+    for (i=0; i<bugz_history_arguments.nbugs; i++) {
+        k = strlen(base) + strlen("/rest/bug//history?") + strlen(query) + 32 + 1;
+        urls[i] = (char *)malloc(k);
+        snprintf(urls[i], k, "%s/rest/bug/%d/history%s%s", base, bugz_history_arguments.bugs[i],
+                 *query ? "?" : "", query);
+    }
+    if (bugz_history_arguments.merge)
+        multi.entries = json_object_new_array();
+    else
+        bugz_output_header(&bugz_stdout, bugz_record_history);
+
+    failures = bugz_get_multi(headers, urls, bugz_history_arguments.nbugs,
+                              bugz_history_arguments.jobs, bugz_history_multi_callback, &multi);
+    failures += multi.failures;
+
+    if (multi.entries) {
+        json_object *entry, *bug;
+        json_object_array_sort(multi.entries, bugz_history_compare);
+        bugz_output_header(&bugz_stdout, bugz_record_history);
+        for (i=0; i<json_object_array_length(multi.entries); i++) {
+            entry = json_object_array_get_idx(multi.entries, i);
+            if (bugz_arguments.output_format == bugz_output_raw) {
+                bugz_sink_printf(&bugz_stdout, "%s\n",
+                                 json_object_to_json_string_ext(entry, JSON_C_TO_STRING_PLAIN));
+                continue;
+            }
+            if (bugz_arguments.output_format != bugz_output_text) {
+                bugz_output_callback(entry, &multi.output);
+                continue;
+            }
+            json_object_object_get_ex(entry, "bug_id", &bug);
+            bugz_history_show_entry(entry, "Bug", json_object_get_int(bug));
+        }
+        bugz_sink_flush(&bugz_stdout);
+        json_object_put(multi.entries);
+    }
+    for (i=0; i<bugz_history_arguments.nbugs; i++)
+        free(urls[i]);
+    free(urls);
+    if (failures)
+        fprintf(stderr, N_("ERROR: failed to get history of %d bug(s)\n"), failures);
+    return failures ? 1 : 0;
+}
+
 int bugz_history_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
@@ -55,8 +247,9 @@ int bugz_history_main(int argc, char **argv) {
 
     optind++;
     bugz_history_arguments.bug = -1;
+    bugz_history_arguments.jobs = 8;
     while (optind < argc) {
-        opt = getopt_long(argc, argv, "-:hn:", bugz_history_options, &longindex);
+        opt = getopt_long(argc, argv, "-:hn:j:m", bugz_history_options, &longindex);
         switch (opt) {
         case ':' :
         case '?' :
@@ -69,10 +262,32 @@ int bugz_history_main(int argc, char **argv) {
         case 'n' :
             _append_history_arg_(new_since);
             break;  
+        case 'j' :
+            bugz_history_arguments.jobs = atoi(optarg);
+            break;
+        case 'm' :
+            bugz_history_arguments.merge = TRUE;
+            break;
         case -1 :
-            bugz_history_arguments.bug = atoi(argv[optind++]);
+            if (strcmp(argv[optind], "-") == 0) {
+                char id[32];
+                while (scanf("%31s", id) == 1) {
+                    if (atoi(id) <= 0)
+                        break;
+                    bugz_history_add_bug(atoi(id));
+                }
+                if (!feof(stdin))
+                    bugz_history_arguments.bug = 0;
+            }
+            else if (atoi(argv[optind]) > 0)
+                bugz_history_add_bug(atoi(argv[optind]));
+            else
+                bugz_history_arguments.bug = 0;
+            optind++;
             break;
         }
+        if (bugz_history_arguments.bug == 0)
+            break;
     } 
     if (bugz_history_arguments.bug <= 0) {
         fprintf(stderr, bugz_history_arguments.bug == -1 ?
@@ -114,6 +329,20 @@ int bugz_history_main(int argc, char **argv) {
         json_object_new_string(username));
     }
     
+    if (bugz_history_arguments.nbugs > 1 || bugz_history_arguments.merge) {
+        char *query = json_object_object_length(json) > 0 ? bugz_urlencode(json) : NULL;
+        json_object_put(json);
+        headers = curl_slist_append(headers, "charsets: utf-8");
+        headers = curl_slist_append(headers, "Accept: application/json");
+        headers = curl_slist_append(headers, "Content-Type: application/json");
+        fprintf(stderr, N_(" * Info: Using %s\n")
+                        N_(" * Info: Getting history of %d bug(s) ..\n"), base,
+                        bugz_history_arguments.nbugs);
+        retval = bugz_history_multi(headers, base, query ? query : "");
+        curl_slist_free_all(headers);
+        free(query);
+        return retval;
+    }
     if (json_object_object_length(json) <= 0) {
         int i = strlen(base) + strlen("/rest/bug/history");
         url = (char *)malloc(i+32+1);
@@ -145,44 +374,29 @@ int bugz_history_main(int argc, char **argv) {
     fprintf(stderr, N_(" * Info: Using %s\n")
                     N_(" * Info: Getting bug %d history ..\n"), base, bugz_history_arguments.bug);
 
+    if (bugz_arguments.output_format != bugz_output_text) {
+        retval = bugz_history_output(curl, url);
+        free(url);
+        curl_easy_cleanup(curl);
+        return retval;
+    }
+
     bugz_get_result(curl, url, &json);
     if (bugz_check_result(json)) {
         int j;
         json_object *bug, *bugs, *history;
         json_object_object_get_ex(json, "bugs", &bugs);
+        bugz_trace_begin("render", "render history");
         for (j=0; j<json_object_array_length(bugs); j++) {
             bug = json_object_array_get_idx(bugs, j);
             json_object_object_get_ex(bug, "history", &history);
             if (history) {
-                int i, k;
-                json_object *item, *who, *when, *changes;
-                json_object *added, *removed, *field_name;
-                for (i=0; i<json_object_array_length(history); i++) {
-                    item = json_object_array_get_idx(history, i);
-                    json_object_object_get_ex(item, "who", &who);
-                    json_object_object_get_ex(item, "when", &when);
-                    json_object_object_get_ex(item, "changes", &changes);
-                    fprintf(stdout, "[History #%d] %s : %s\n", i,
-                            json_object_get_string(when),
-                            json_object_get_string(who));
-                    for (k=0; k<bugz_arguments.columns; k++) fprintf(stdout, "%c", '-');
-                    fprintf(stdout, "\n");
-
-                    for (k=0; k<json_object_array_length(changes); k++) {
-                        item = json_object_array_get_idx(changes, k);
-                        json_object_object_get_ex(item, "added", &added); 
-                        json_object_object_get_ex(item, "removed", &removed); 
-                        json_object_object_get_ex(item, "field_name", &field_name);
-                        fprintf(stdout, "%s removed: %s\n",
-                                json_object_get_string(field_name),
-                                json_object_get_string(removed)); 
-                        fprintf(stdout, "%s added  : %s\n\n",
-                                json_object_get_string(field_name),
-                                json_object_get_string(added)); 
-                    }
-                }
+                int i;
+                for (i=0; i<json_object_array_length(history); i++)
+                    bugz_history_show_entry(json_object_array_get_idx(history, i), "History", i);
             }
         }
+        bugz_trace_end();
         json_object_put(json);
         retval = 0;
     }
@@ -0,0 +1,151 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "bugz.h"
+
+/*
+ * File input for attachments, --comment-from, --description-from and
+ * the text typed or piped at the prompts. Regular files are mapped,
+ * pipes and terminals are read in large blocks into a buffer doubled
+ * as it fills up, so reading is linear in the size of the input either
+ * way. A read buffer always ends with a '\0' after len bytes, a mapping
+ * does not.
+ *
+ * max, if not 0, is the largest input accepted, reading more fails
+ * with EFBIG.
+ *
+ * stdin may already have been read from with stdio (the prompts of
+ * bugz post), it is read with fread() so that nothing buffered is lost,
+ * glibc passes such large reads straight to read(2).
+ *
+ */
+#define BUGZ_INPUT_CHUNK (64 * 1024)
+
+static int bugz_input_from(struct bugz_input_t *in, int fd, FILE *fp, size_t max) {
+    char *p;
+    ssize_t n;
+    struct stat st;
+    size_t size = BUGZ_INPUT_CHUNK;
+
+    memset(in, 0, sizeof(*in));
+    if (fstat(fp ? fileno(fp) : fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        size = (size_t)st.st_size + 1; /* one read, and one to see the end */
+    if (max && size > max + 2)
+        size = max + 2; /* room to see one byte too many */
+    if ((in->buffer = (char *)malloc(size)) == NULL)
+        return FALSE;
+    in->size = size;
+    for (;;) {
+        if (in->len + 1 >= in->size) {
+            size = in->size * 2;
+            if (max && size > max + 2)
+                size = max + 2;
+            if ((p = (char *)realloc(in->buffer, size)) == NULL) {
+                bugz_input_close(in);
+                errno = ENOMEM;
+                return FALSE;
+            }
+            in->buffer = p;
+            in->size = size;
+        }
+        if (fp) {
+            n = (ssize_t)fread(in->buffer + in->len, 1, in->size - in->len - 1, fp);
+            if (n == 0 && ferror(fp)) {
+                bugz_input_close(in);
+                return FALSE;
+            }
+        }
+        else
+            n = read(fd, in->buffer + in->len, in->size - in->len - 1);
+        if (n == 0)
+            break;
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            bugz_input_close(in);
+            return FALSE;
+        }
+        in->len += (size_t)n;
+        if (max && in->len > max) {
+            bugz_input_close(in);
+            errno = EFBIG;
+            return FALSE;
+        }
+    }
+    in->buffer[in->len] = '\0';
+    in->data = in->buffer;
+    return TRUE;
+}
+
+int bugz_input_fd(struct bugz_input_t *in, int fd, size_t max) {
+    return bugz_input_from(in, fd, NULL, max);
+}
+
+int bugz_input_file(struct bugz_input_t *in, FILE *fp, size_t max) {
+    clearerr(fp);
+    return bugz_input_from(in, -1, fp, max);
+}
+
+/* path "-" is stdin */
+int bugz_input_open(struct bugz_input_t *in, const char *path) {
+    int fd, retval;
+    void *map;
+    struct stat st;
+
+    if (strcmp(path, "-") == 0)
+        return bugz_input_file(in, stdin, 0);
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return FALSE;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            memset(in, 0, sizeof(*in));
+            in->data = (const char *)map;
+            in->len = (size_t)st.st_size;
+            in->mapped = TRUE;
+            close(fd);
+            return TRUE;
+        }
+    }
+    retval = bugz_input_fd(in, fd, 0);
+    close(fd);
+    return retval;
+}
+
+/* whole file as a string to be freed, NULL and errno on failure */
+char *bugz_input_read(const char *path, size_t max) {
+    int fd, retval;
+    struct bugz_input_t in;
+
+    if (strcmp(path, "-") == 0)
+        return bugz_input_file(&in, stdin, max) ? in.buffer : NULL;
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    retval = bugz_input_fd(&in, fd, max);
+    close(fd);
+    return retval ? in.buffer : NULL;
+}
+
+void bugz_input_close(struct bugz_input_t *in) {
+    if (in->mapped)
+        munmap((void *)in->data, in->len);
+    else
+        free(in->buffer);
+    memset(in, 0, sizeof(*in));
+}
@@ -0,0 +1,229 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz.h"
+
+/*
+ * Streaming JSON writer for request bodies, members are written straight
+ * into one growing buffer which curl reads from (bugz_json_setopt()),
+ * no json-c tree and no serialized copy of it are built.
+ *
+ */
+#define BUGZ_JSON_CHUNK (16 * 1024)
+
+static char *bugz_json_reserve(struct bugz_json_t *w, size_t n) {
+    char *p;
+    size_t size;
+
+    if (w->used + n <= w->size)
+        return w->data + w->used;
+    size = w->size ? w->size : BUGZ_JSON_CHUNK;
+    while (size < w->used + n)
+        size *= 2;
+    if ((p = (char *)realloc(w->data, size)) == NULL) {
+        fprintf(stderr, "ERROR: expand buffer in bugz_json_reserve failed\n");
+        exit(1);
+    }
+    w->data = p;
+    w->size = size;
+    return w->data + w->used;
+}
+
+static void bugz_json_write(struct bugz_json_t *w, const char *s, size_t len) {
+    memcpy(bugz_json_reserve(w, len), s, len);
+    w->used += len;
+}
+
+static void bugz_json_escape(struct bugz_json_t *w, const char *s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    size_t i, start = 0;
+    char e[6] = {'\\', 'u', '0', '0'};
+
+    for (i=0; i<len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        size_t n = 2;
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        switch (c) {
+        case '"'  : e[1] = '"';  break;
+        case '\\' : e[1] = '\\'; break;
+        case '\n' : e[1] = 'n';  break;
+        case '\r' : e[1] = 'r';  break;
+        case '\t' : e[1] = 't';  break;
+        case '\b' : e[1] = 'b';  break;
+        case '\f' : e[1] = 'f';  break;
+        default   :
+            e[1] = 'u';
+            e[4] = hex[c >> 4];
+            e[5] = hex[c & 0x0f];
+            n = 6;
+        }
+        bugz_json_write(w, s + start, i - start);
+        bugz_json_write(w, e, n);
+        start = i + 1;
+    }
+    bugz_json_write(w, s + start, len - start);
+}
+
+static void bugz_json_quote(struct bugz_json_t *w, const char *s, size_t len) {
+    bugz_json_write(w, "\"", 1);
+    bugz_json_escape(w, s, len);
+    bugz_json_write(w, "\"", 1);
+}
+
+/* separator and key of the next member or element */
+static void bugz_json_member(struct bugz_json_t *w, const char *key) {
+    if (w->depth > 0 && w->depth <= BUGZ_JSON_DEPTH && w->count[w->depth - 1]++)
+        bugz_json_write(w, ",", 1);
+    if (key) {
+        bugz_json_quote(w, key, strlen(key));
+        bugz_json_write(w, ":", 1);
+    }
+}
+
+void bugz_json_reset(struct bugz_json_t *w) {
+    w->used = 0;
+    w->sent = 0;
+    w->depth = 0;
+}
+
+void bugz_json_free(struct bugz_json_t *w) {
+    free(w->data);
+    memset(w, 0, sizeof(*w));
+}
+
+void bugz_json_begin(struct bugz_json_t *w, const char *key, char c) {
+    bugz_json_member(w, key);
+    bugz_json_write(w, &c, 1);
+    if (w->depth < BUGZ_JSON_DEPTH)
+        w->count[w->depth] = 0;
+    w->depth++;
+}
+
+void bugz_json_end(struct bugz_json_t *w, char c) {
+    bugz_json_write(w, &c, 1);
+    if (w->depth > 0)
+        w->depth--;
+}
+
+int bugz_json_members(struct bugz_json_t *w) {
+    return w->depth > 0 && w->depth <= BUGZ_JSON_DEPTH ? w->count[w->depth - 1] : 0;
+}
+
+void bugz_json_string(struct bugz_json_t *w, const char *key, const char *s) {
+    bugz_json_member(w, key);
+    if (s)
+        bugz_json_quote(w, s, strlen(s));
+    else
+        bugz_json_write(w, "null", 4);
+}
+
+void bugz_json_int(struct bugz_json_t *w, const char *key, long v) {
+    char buf[32];
+    bugz_json_member(w, key);
+    bugz_json_write(w, buf, snprintf(buf, sizeof(buf), "%ld", v));
+}
+
+void bugz_json_double(struct bugz_json_t *w, const char *key, double v) {
+    char buf[64];
+    int n;
+    bugz_json_member(w, key);
+    n = snprintf(buf, sizeof(buf), "%.17g", v);
+    if (strspn(buf, "-0123456789") == (size_t)n) /* keep it a double */
+        n += snprintf(buf + n, sizeof(buf) - n, ".0");
+    bugz_json_write(w, buf, n);
+}
+
+void bugz_json_boolean(struct bugz_json_t *w, const char *key, int v) {
+    bugz_json_member(w, key);
+    bugz_json_write(w, v ? "true" : "false", v ? 4 : 5);
+}
+
+/* last value of the list, as bugz_slist_to_json_string() */
+void bugz_json_last(struct bugz_json_t *w, const char *key, struct curl_slist *list) {
+    struct curl_slist *last = bugz_slist_get_last(list);
+    bugz_json_string(w, key, last ? last->data : NULL);
+}
+
+/* every value of the list, as bugz_slist_to_json_array() */
+void bugz_json_slist(struct bugz_json_t *w, const char *key, struct curl_slist *list, int jtype) {
+    bugz_json_begin(w, key, '[');
+    for (; list; list = list->next) {
+        switch (jtype) {
+        case json_type_int :
+            bugz_json_int(w, NULL, atoi(list->data));
+            break;
+        case json_type_double :
+            bugz_json_double(w, NULL, atof(list->data));
+            break;
+        default :
+            bugz_json_string(w, NULL, list->data);
+        }
+    }
+    bugz_json_end(w, ']');
+}
+
+/* data as a base64 string, encoded in place */
+void bugz_json_base64(struct bugz_json_t *w, const char *key, const void *data, size_t len) {
+    bugz_json_member(w, key);
+    bugz_json_reserve(w, (len + 2) / 3 * 4 + 2);
+    bugz_json_write(w, "\"", 1);
+    w->used += bugz_base64_encode_block((const unsigned char *)data, len,
+                                        bugz_json_reserve(w, (len + 2) / 3 * 4));
+    bugz_json_write(w, "\"", 1);
+}
+
+/* member whose string value is written by someone else, e.g. bugz_upload_new() */
+void bugz_json_string_begin(struct bugz_json_t *w, const char *key) {
+    bugz_json_member(w, key);
+    bugz_json_write(w, "\"", 1);
+}
+
+/* piece of a string opened by bugz_json_string_begin(), s needs no NUL */
+void bugz_json_string_append(struct bugz_json_t *w, const char *s, size_t len) {
+    bugz_json_escape(w, s, len);
+}
+
+void bugz_json_string_end(struct bugz_json_t *w) {
+    bugz_json_write(w, "\"", 1);
+}
+
+static size_t bugz_json_read(char *buffer, size_t size, size_t nitems, void *userp) {
+    struct bugz_json_t *w = (struct bugz_json_t *)userp;
+    size_t n = size * nitems;
+    if (n > w->used - w->sent)
+        n = w->used - w->sent;
+    memcpy(buffer, w->data + w->sent, n);
+    w->sent += n;
+    return n;
+}
+
+static int bugz_json_seek(void *userp, curl_off_t offset, int origin) {
+    struct bugz_json_t *w = (struct bugz_json_t *)userp;
+    if (origin != SEEK_SET || offset < 0 || (size_t)offset > w->used)
+        return CURL_SEEKFUNC_CANTSEEK;
+    w->sent = (size_t)offset;
+    return CURL_SEEKFUNC_OK;
+}
+
+/* body of the next request, the method is still CURLOPT_CUSTOMREQUEST */
+void bugz_json_setopt(CURL *curl, struct bugz_json_t *w) {
+    w->sent = 0;
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)w->used);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, bugz_json_read);
+    curl_easy_setopt(curl, CURLOPT_READDATA, w);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, bugz_json_seek);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, w);
+}
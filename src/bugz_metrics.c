@@ -0,0 +1,352 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <time.h>
+
+#include "bugz.h"
+
+/*
+ * Per-request metrics (--metrics-file), one JSON line is written for
+ * every finished transfer and the phases are summed up for a summary
+ * table printed on stderr at exit.
+ *
+ * Command trace (--trace-file), spans in Chrome Trace Event format
+ * which can be opened in Perfetto or chrome://tracing. Spans of the
+ * command itself are nested begin/end events on one thread, every
+ * request is a complete event with its phases below it, on a lane
+ * of its own when transfers overlap.
+ *
+ * Phases are derived from the cumulative curl timers:
+ *   dns      : namelookup
+ *   connect  : connect - namelookup
+ *   tls      : appconnect - connect (0 for plain http)
+ *   server   : starttransfer - pretransfer (request sent, first byte back)
+ *   transfer : total - starttransfer
+ */
+enum bugz_metrics_phase_t {
+    bugz_phase_dns = 0,
+    bugz_phase_connect,
+    bugz_phase_tls,
+    bugz_phase_server,
+    bugz_phase_transfer,
+    bugz_phase_total,
+    bugz_phase_end
+};
+
+static const char *bugz_metrics_phases[] = {
+    "dns", "connect", "tls", "server", "transfer", "total"
+};
+
+static struct bugz_metrics_t {
+    FILE *fp;
+    int requests;
+    int failures;
+    int reused;
+    curl_off_t uploaded;
+    curl_off_t downloaded;
+    curl_off_t sum[bugz_phase_end]; /* microseconds */
+    curl_off_t max[bugz_phase_end];
+} bugz_metrics = { 0 };
+
+#define BUGZ_TRACE_DEPTH 16
+#define BUGZ_TRACE_LANES 64
+
+static struct bugz_tracer_t {
+    FILE *fp;
+    int events;
+    pid_t pid;
+    struct timespec start;
+    int depth;
+    const char *names[BUGZ_TRACE_DEPTH];
+    int lanes;
+    int64_t lane_end[BUGZ_TRACE_LANES];
+} bugz_tracer = { 0 };
+
+#ifndef JSON_C_TO_STRING_NOSLASHESCAPE
+#define JSON_C_TO_STRING_NOSLASHESCAPE 0
+#endif
+
+static const char *bugz_metrics_http_version(long version) {
+    switch (version) {
+    case CURL_HTTP_VERSION_1_0 : return "1.0";
+    case CURL_HTTP_VERSION_1_1 : return "1.1";
+    case CURL_HTTP_VERSION_2_0 : return "2";
+#ifdef CURL_HTTP_VERSION_3
+    case CURL_HTTP_VERSION_3   : return "3";
+#endif
+    default                    : return NULL;
+    }
+}
+
+/* credentials are part of the query string, never write them out */
+char *bugz_mask_url(const char *url) {
+    static const char *secrets[] = {"password=", "api_key=", NULL};
+    char *p, *q, *buf;
+    int i;
+
+    if (url == NULL || (buf = strdup(url)) == NULL)
+        return NULL;
+    for (p = strchr(buf, '?'); p && *p; p = q) {
+        p++;
+        q = p + strcspn(p, "&");
+        for (i=0; secrets[i]; i++) {
+            size_t len = strlen(secrets[i]);
+            if (strncmp(p, secrets[i], len) == 0 && q > p + len) {
+                memmove(p + len + 3, q, strlen(q) + 1);
+                memcpy(p + len, "***", 3);
+                q = p + len + 3;
+                break;
+            }
+        }
+    }
+    return buf;
+}
+
+static json_object *bugz_metrics_url(const char *url) {
+    json_object *json;
+    char *buf;
+
+    if ((buf = bugz_mask_url(url)) == NULL)
+        return NULL;
+    json = json_object_new_string(buf);
+    free(buf);
+    return json;
+}
+
+static void bugz_metrics_summary(void) {
+    int i;
+    struct bugz_metrics_t *m = &bugz_metrics;
+
+    if (m->fp && m->fp != stderr)
+        fclose(m->fp);
+    m->fp = NULL;
+    if (m->requests == 0)
+        return;
+    fprintf(stderr, " * Info: %d request(s), %d failed, %d reused connection(s), "
+                    "%" CURL_FORMAT_CURL_OFF_T " byte(s) sent, "
+                    "%" CURL_FORMAT_CURL_OFF_T " byte(s) received\n",
+                    m->requests, m->failures, m->reused, m->uploaded, m->downloaded);
+    fprintf(stderr, " * Info: %-10s %12s %12s %12s\n", "phase", "total(ms)", "mean(ms)", "max(ms)");
+    for (i=0; i<bugz_phase_end; i++)
+        fprintf(stderr, " * Info: %-10s %12.3f %12.3f %12.3f\n", bugz_metrics_phases[i],
+                        m->sum[i] / 1000.0, m->sum[i] / 1000.0 / m->requests, m->max[i] / 1000.0);
+}
+
+int bugz_metrics_open(const char *path) {
+    if (strcmp(path, "-") == 0)
+        bugz_metrics.fp = stderr;
+    else if ((bugz_metrics.fp = fopen(path, "a")) == NULL)
+        return FALSE;
+    atexit(bugz_metrics_summary);
+    return TRUE;
+}
+
+/* microseconds since the trace was opened */
+static int64_t bugz_trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)(ts.tv_sec - bugz_tracer.start.tv_sec) * 1000000 +
+           (ts.tv_nsec - bugz_tracer.start.tv_nsec) / 1000;
+}
+
+static void bugz_trace_event(const char *ph, const char *cat, const char *name,
+                             int tid, int64_t ts, int64_t dur, json_object *args) {
+    struct bugz_tracer_t *t = &bugz_tracer;
+    json_object *json = json_object_new_object();
+
+    json_object_object_add(json, "name", json_object_new_string(name));
+    if (cat)
+        json_object_object_add(json, "cat", json_object_new_string(cat));
+    json_object_object_add(json, "ph", json_object_new_string(ph));
+    json_object_object_add(json, "ts", json_object_new_int64(ts));
+    if (*ph == 'X')
+        json_object_object_add(json, "dur", json_object_new_int64(dur));
+    json_object_object_add(json, "pid", json_object_new_int(t->pid));
+    json_object_object_add(json, "tid", json_object_new_int(tid));
+    if (args)
+        json_object_object_add(json, "args", args);
+    fprintf(t->fp, "%s%s", t->events++ ? ",\n" : "", json_object_to_json_string_ext(json,
+                    JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+    json_object_put(json);
+}
+
+static void bugz_trace_name(const char *what, int tid, const char *name) {
+    json_object *args = json_object_new_object();
+    json_object_object_add(args, "name", json_object_new_string(name));
+    bugz_trace_event("M", NULL, what, tid, 0, 0, args);
+}
+
+static void bugz_trace_close(void) {
+    struct bugz_tracer_t *t = &bugz_tracer;
+    while (t->depth > 0)
+        bugz_trace_end();
+    fprintf(t->fp, "\n]}\n");
+    fclose(t->fp);
+    t->fp = NULL;
+}
+
+int bugz_trace_open(const char *path) {
+    struct bugz_tracer_t *t = &bugz_tracer;
+    if ((t->fp = fopen(path, "w")) == NULL)
+        return FALSE;
+    t->pid = getpid();
+    clock_gettime(CLOCK_MONOTONIC, &t->start);
+    fprintf(t->fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bugz_trace_name("process_name", 1, PACKAGE);
+    bugz_trace_name("thread_name", 1, "main");
+    atexit(bugz_trace_close);
+    return TRUE;
+}
+
+void bugz_trace_begin(const char *cat, const char *name) {
+    struct bugz_tracer_t *t = &bugz_tracer;
+    if (t->fp == NULL)
+        return;
+    if (t->depth < BUGZ_TRACE_DEPTH)
+        t->names[t->depth] = name;
+    t->depth++;
+    bugz_trace_event("B", cat, name, 1, bugz_trace_now(), 0, NULL);
+}
+
+void bugz_trace_end(void) {
+    struct bugz_tracer_t *t = &bugz_tracer;
+    if (t->fp == NULL || t->depth == 0)
+        return;
+    t->depth--;
+    bugz_trace_event("E", NULL, t->depth < BUGZ_TRACE_DEPTH ? t->names[t->depth] : "",
+                     1, bugz_trace_now(), 0, NULL);
+}
+
+/*
+ * A request and its phases, on the first lane free since it started,
+ * t holds the cumulative curl timers and phase their differences.
+ */
+static void bugz_trace_request(const char *method, json_object *url, long code,
+                               curl_off_t up, curl_off_t down, curl_off_t *t, curl_off_t *phase) {
+    static const int from[] = {-1, 0, 1, 3, 4}; /* timer each phase starts at */
+    struct bugz_tracer_t *tr = &bugz_tracer;
+    int64_t end = bugz_trace_now(), ts = end - t[5];
+    const char *u = url ? json_object_get_string(url) : "", *p;
+    char name[128];
+    json_object *args;
+    int i, lane;
+
+    for (lane=0; lane<tr->lanes; lane++) {
+        if (tr->lane_end[lane] <= ts)
+            break;
+    }
+    if (lane == BUGZ_TRACE_LANES)
+        lane--;
+    if (lane == tr->lanes) {
+        snprintf(name, sizeof(name), "http #%d", lane + 1);
+        bugz_trace_name("thread_name", lane + 2, name);
+        tr->lanes++;
+    }
+    tr->lane_end[lane] = end;
+
+    /* "GET /rest/bug/42", the query string is in args */
+    p = strstr(u, "://");
+    p = p ? strchr(p + 3, '/') : NULL;
+    snprintf(name, sizeof(name), "%s %.*s", method ? method : "HTTP",
+             p ? (int)strcspn(p, "?") : 0, p ? p : "");
+    args = json_object_new_object();
+    json_object_object_add(args, "url", json_object_get(url));
+    json_object_object_add(args, "status", json_object_new_int(code));
+    json_object_object_add(args, "bytes_up", json_object_new_int64(up));
+    json_object_object_add(args, "bytes_down", json_object_new_int64(down));
+    bugz_trace_event("X", "http", name, lane + 2, ts, t[5], args);
+    for (i=0; i<bugz_phase_total; i++) {
+        if (phase[i] > 0)
+            bugz_trace_event("X", "http", bugz_metrics_phases[i], lane + 2,
+                             ts + (from[i] < 0 ? 0 : t[from[i]]), phase[i], NULL);
+    }
+}
+
+void bugz_metrics_record(CURL *curl, CURLcode rcode) {
+    struct bugz_metrics_t *m = &bugz_metrics;
+    curl_off_t t[7] = { 0 }, phase[bugz_phase_end], up = 0, down = 0;
+    long code = 0, version = 0, connects = 0;
+    const char *method = NULL, *s;
+    char *url = NULL;
+    json_object *json, *masked;
+    int i;
+
+    if (m->fp == NULL && bugz_tracer.fp == NULL)
+        return;
+    curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &t[0]);
+    curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &t[1]);
+    curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T, &t[2]);
+    curl_easy_getinfo(curl, CURLINFO_PRETRANSFER_TIME_T, &t[3]);
+    curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &t[4]);
+    curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &t[5]);
+    curl_easy_getinfo(curl, CURLINFO_REDIRECT_TIME_T, &t[6]);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_UPLOAD_T, &up);
+    curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &down);
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_URL, &url);
+#if LIBCURL_VERSION_NUM >= 0x074800
+    curl_easy_getinfo(curl, CURLINFO_EFFECTIVE_METHOD, &method);
+#endif
+
+    phase[bugz_phase_dns] = t[0];
+    phase[bugz_phase_connect] = t[1] > t[0] ? t[1] - t[0] : 0;
+    phase[bugz_phase_tls] = t[2] > t[1] ? t[2] - t[1] : 0;
+    phase[bugz_phase_server] = t[4] > t[3] ? t[4] - t[3] : 0;
+    phase[bugz_phase_transfer] = t[5] > t[4] && t[4] ? t[5] - t[4] : 0;
+    phase[bugz_phase_total] = t[5];
+
+    masked = bugz_metrics_url(url);
+    if (bugz_tracer.fp)
+        bugz_trace_request(method, masked, code, up, down, t, phase);
+    if (m->fp == NULL) {
+        json_object_put(masked);
+        return;
+    }
+
+    m->requests++;
+    if (rcode != CURLE_OK || code >= 400)
+        m->failures++;
+    if (connects == 0)
+        m->reused++;
+    m->uploaded += up;
+    m->downloaded += down;
+    for (i=0; i<bugz_phase_end; i++) {
+        m->sum[i] += phase[i];
+        if (phase[i] > m->max[i])
+            m->max[i] = phase[i];
+    }
+
+    json = json_object_new_object();
+    if (method)
+        json_object_object_add(json, "method", json_object_new_string(method));
+    json_object_object_add(json, "url", masked);
+    json_object_object_add(json, "result", json_object_new_int(rcode));
+    json_object_object_add(json, "status", json_object_new_int(code));
+    s = bugz_metrics_http_version(version);
+    json_object_object_add(json, "http_version", s ? json_object_new_string(s) : NULL);
+    json_object_object_add(json, "reused", json_object_new_boolean(connects == 0));
+    json_object_object_add(json, "bytes_up", json_object_new_int64(up));
+    json_object_object_add(json, "bytes_down", json_object_new_int64(down));
+    for (i=0; i<bugz_phase_end; i++) {
+        char key[32];
+        snprintf(key, sizeof(key), "%s_us", bugz_metrics_phases[i]);
+        json_object_object_add(json, key, json_object_new_int64(phase[i]));
+    }
+    json_object_object_add(json, "redirect_us", json_object_new_int64(t[6]));
+    fprintf(m->fp, "%s\n", json_object_to_json_string_ext(json,
+                    JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE));
+    json_object_put(json);
+}
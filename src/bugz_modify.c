@@ -193,17 +193,20 @@ struct bugz_modify_arguments_t {
     int invalid;
 };
 static struct bugz_modify_arguments_t bugz_modify_arguments = { 0 };
+/* --comment-from, mapped and written straight into the request body */
+static struct bugz_input_t bugz_modify_comment_in = { 0 };
 #define _append_modify_arg_(m) bugz_modify_arguments.m = \
-                               curl_slist_append(bugz_modify_arguments.m, optarg)
+                               bugz_arena_slist_append(&bugz_arena, bugz_modify_arguments.m, optarg)
 
 int bugz_modify_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
-    char url[PATH_MAX] = {0};
+    char *url;
     char *base, *username, *password;
     int opt, longindex, retval = 1;
     struct bugz_config_t *config;
     struct curl_slist *headers = NULL;
+    struct bugz_json_t body = { 0 };
     int has_comment = FALSE;
     int has_work_time = FALSE;
 
@@ -286,8 +289,7 @@ int bugz_modify_main(int argc, char **argv) {
             case opt_modify_add_cc :
                 if (1) {
                     char *token, *str;
-                    str = (char *)malloc(strlen(optarg)+1);
-                    strcpy(str, optarg);
+                    str = bugz_arena_strdup(&bugz_arena, optarg);
                     token = str;
                     while (*token) {
                         if (isspace((unsigned char)(*token)))
@@ -298,17 +300,15 @@ int bugz_modify_main(int argc, char **argv) {
                     while (token != NULL) {
                         if (strlen(token) > 0)
                             bugz_modify_arguments.add_cc = \
-                            curl_slist_append(bugz_modify_arguments.add_cc, token);
+                            bugz_arena_slist_append(&bugz_arena, bugz_modify_arguments.add_cc, token);
                         token = strtok(NULL, ",");
                     }
-                    free(str);
                 }
                 break;
             case opt_modify_remove_cc :
                 if (1) {
                     char *token, *str;
-                    str = (char *)malloc(strlen(optarg)+1);
-                    strcpy(str, optarg);
+                    str = bugz_arena_strdup(&bugz_arena, optarg);
                     token = str;
                     while (*token) {
                         if (isspace((unsigned char)(*token)))
@@ -319,10 +319,9 @@ int bugz_modify_main(int argc, char **argv) {
                     while (token != NULL) {
                         if (strlen(token) > 0)
                             bugz_modify_arguments.remove_cc = \
-                            curl_slist_append(bugz_modify_arguments.remove_cc, token);
+                            bugz_arena_slist_append(&bugz_arena, bugz_modify_arguments.remove_cc, token);
                         token = strtok(NULL, ",");
                     }
-                    free(str);
                 }
                 break;
             case opt_modify_component :
@@ -388,44 +387,23 @@ int bugz_modify_main(int argc, char **argv) {
         exit(1);
     }
     if (bugz_modify_arguments.comment_from) {
-        FILE *fp;
-        char *q, *p = bugz_modify_arguments.comment_from->data;
-        int i = 0, s = 1024;
-        if (strcmp(p, "-")) {
-            if ((fp = fopen(p, "rb")) == NULL) {
-                fprintf(stderr, N_("ERROR: unable to read file for '--comment-from': %s\n"), p);
-                exit(1);
-            }
+        struct bugz_input_t *in = &bugz_modify_comment_in;
+        int ok = bugz_input_open(in, bugz_modify_arguments.comment_from->data);
+        if (ok && in->len > BUGZ_INPUT_TEXT_MAX) {
+            bugz_input_close(in);
+            errno = EFBIG;
+            ok = FALSE;
         }
-        else
-            fp = stdin;
-        p = q = NULL;
-        while (feof(fp) == 0) {
-            if (i == 0) {
-                i += s;
-                p = (char *)malloc(i);
-                memset(p, 0, i);
-            }
-            if (strlen(p) >= i-1) {
-                i += s;
-                q = (char *)malloc(i);
-                memset(q, 0, i);
-                strcpy(q, p);
-                free(p);
-                p = q;
-            }
-            fgets(p+strlen(p), i - strlen(p), fp);
+        if (!ok) {
+            fprintf(stderr, N_("ERROR: unable to read file for '--comment-from': %s: %s\n"),
+                            bugz_modify_arguments.comment_from->data, strerror(errno));
+            exit(1);
         }
-        curl_slist_free_all(bugz_modify_arguments.comment);
-        bugz_modify_arguments.comment = curl_slist_append(NULL, p);
-        free(p);
-        if (fp != stdin)
-            fclose(fp);
+        bugz_modify_arguments.comment = NULL;
     }
     if (bugz_modify_arguments.comment_editor) {
         char *p = bugz_raw_input("Enter comment:");
-        curl_slist_free_all(bugz_modify_arguments.comment);
-        bugz_modify_arguments.comment = curl_slist_append(NULL, p);
+        bugz_modify_arguments.comment = bugz_arena_slist_append(&bugz_arena, NULL, p);
         free(p);
     }
 
@@ -446,283 +424,181 @@ int bugz_modify_main(int argc, char **argv) {
         }
     }
     if (password)
-        sprintf(url, "%s/rest/bug/%d?login=%s&password=%s", base,
-                bugz_modify_arguments.bug, username, password);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug/%d?login=%s&password=%s", base,
+                                bugz_modify_arguments.bug, username, password);
     else if (username)
-        sprintf(url, "%s/rest/bug/%d?api_key=%s", base,
-                bugz_modify_arguments.bug, username);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug/%d?api_key=%s", base,
+                                bugz_modify_arguments.bug, username);
     else
-        sprintf(url, "%s/rest/bug/%d", base, bugz_modify_arguments.bug);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug/%d", base, bugz_modify_arguments.bug);
 
     bugz_config_free(config);
     if ((curl = curl_easy_init()) == NULL) {
         fprintf(stderr, N_("ERROR: %s modify: curl_easy_init() failed\n"), argv[0]);
         exit(1);
     }
-    headers = curl_slist_append(headers, "charsets: utf-8");
-    headers = curl_slist_append(headers, "Accept: application/json");
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "charsets: utf-8");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Accept: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Content-Type: application/json");
     
-    json = json_object_new_object();
+    bugz_json_begin(&body, NULL, '{');
     if (1) {
-        json_object *jarray = json_object_new_array();
-        json_object_array_add(jarray, json_object_new_int(bugz_modify_arguments.bug));
-        json_object_object_add(json, "ids", jarray);
-
-        if (bugz_modify_arguments.alias)
-            json_object_object_add(json, "alias", 
-            bugz_slist_to_json_string(bugz_modify_arguments.alias));
-
-        if (bugz_modify_arguments.assigned_to)
-            json_object_object_add(json, "assigned_to", 
-            bugz_slist_to_json_string(bugz_modify_arguments.assigned_to));
-
-        if (bugz_modify_arguments.unassign)
-            json_object_object_add(json, "reset_assigned_to", 
-            json_object_new_boolean(bugz_modify_arguments.unassign));
-
-        if (bugz_modify_arguments.add_blocked) {
-            int j;
-            json_object *blocks;
-            j=json_object_object_get_ex(json, "blocks", &blocks);
-            if (j == 0) {
-                blocks = json_object_new_object();
-                json_object_object_add(json, "blocks", blocks);
-            }
-            json_object_object_add(blocks, "add",
-            bugz_slist_to_json_array(bugz_modify_arguments.add_blocked, json_type_int));
+        struct bugz_modify_arguments_t *args = &bugz_modify_arguments;
+        const char *status = NULL, *resolution = NULL;
+
+        /* --fixed and --invalid override, as later keys used to */
+        if (args->status && args->duplicate == NULL)
+            status = bugz_slist_get_last(args->status)->data;
+        if (args->resolution && args->duplicate == NULL)
+            resolution = bugz_slist_get_last(args->resolution)->data;
+        if (args->fixed)
+            status = "RESOLVED", resolution = "FIXED";
+        if (args->invalid)
+            status = "RESOLVED", resolution = "INVALID";
+
+        bugz_json_begin(&body, "ids", '[');
+        bugz_json_int(&body, NULL, args->bug);
+        bugz_json_end(&body, ']');
+
+        if (args->alias)
+            bugz_json_last(&body, "alias", args->alias);
+
+        if (args->assigned_to)
+            bugz_json_last(&body, "assigned_to", args->assigned_to);
+
+        if (args->unassign)
+            bugz_json_boolean(&body, "reset_assigned_to", args->unassign);
+
+        if (args->add_blocked || args->remove_blocked) {
+            bugz_json_begin(&body, "blocks", '{');
+            if (args->add_blocked)
+                bugz_json_slist(&body, "add", args->add_blocked, json_type_int);
+            if (args->remove_blocked)
+                bugz_json_slist(&body, "remove", args->remove_blocked, json_type_int);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.remove_blocked) {
-            int j;
-            json_object *blocks;
-            j=json_object_object_get_ex(json, "blocks", &blocks);
-            if (j == 0) {
-                blocks = json_object_new_object();
-                json_object_object_add(json, "blocks", blocks);
-            }
-            json_object_object_add(blocks, "remove",
-            bugz_slist_to_json_array(bugz_modify_arguments.remove_blocked, json_type_int));
+        if (args->add_dependson || args->remove_dependson) {
+            bugz_json_begin(&body, "depends_on", '{');
+            if (args->add_dependson)
+                bugz_json_slist(&body, "add", args->add_dependson, json_type_int);
+            if (args->remove_dependson)
+                bugz_json_slist(&body, "remove", args->remove_dependson, json_type_int);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.add_dependson) {
-            int j;
-            json_object *depends_on;
-            j=json_object_object_get_ex(json, "depends_on", &depends_on);
-            if (j == 0) {
-                depends_on = json_object_new_object();
-                json_object_object_add(json, "depends_on", depends_on);
-            }
-            json_object_object_add(depends_on, "add",
-            bugz_slist_to_json_array(bugz_modify_arguments.add_dependson, json_type_int));
+        if (args->add_cc || args->remove_cc) {
+            bugz_json_begin(&body, "cc", '{');
+            if (args->add_cc)
+                bugz_json_slist(&body, "add", args->add_cc, json_type_string);
+            if (args->remove_cc)
+                bugz_json_slist(&body, "remove", args->remove_cc, json_type_string);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.remove_dependson) {
-            int j;
-            json_object *depends_on;
-            j=json_object_object_get_ex(json, "depends_on", &depends_on);
-            if (j == 0) {
-                depends_on = json_object_new_object();
-                json_object_object_add(json, "depends_on", depends_on);
-            }
-            json_object_object_add(depends_on, "remove",
-            bugz_slist_to_json_array(bugz_modify_arguments.remove_dependson, json_type_int));
-        }
-
-        if (bugz_modify_arguments.add_cc) {
-            int j;
-            json_object *cc;
-            j=json_object_object_get_ex(json, "cc", &cc);
-            if (j == 0) {
-                cc = json_object_new_object();
-                json_object_object_add(json, "cc", cc);
-            }
-            json_object_object_add(cc, "add",
-            bugz_slist_to_json_array(bugz_modify_arguments.add_cc, json_type_string));
-        }
-
-        if (bugz_modify_arguments.remove_cc) {
-            int j;
-            json_object *cc;
-            j=json_object_object_get_ex(json, "cc", &cc);
-            if (j == 0) {
-                cc = json_object_new_object();
-                json_object_object_add(json, "cc", cc);
-            }
-            json_object_object_add(cc, "remove",
-            bugz_slist_to_json_array(bugz_modify_arguments.remove_cc, json_type_string));
+        if (args->comment) {
+            has_comment = TRUE;
+            bugz_json_begin(&body, "comment", '{');
+            bugz_json_last(&body, "body", args->comment);
+            bugz_json_end(&body, '}');
         }
-
-        if (bugz_modify_arguments.comment) {
-            int j;
-            json_object *comment;
-            j=json_object_object_get_ex(json, "comment", &comment);
-            if (j == 0) {
-                comment = json_object_new_object();
-                json_object_object_add(json, "comment", comment);
-            }
+        else if (bugz_modify_comment_in.data) {
             has_comment = TRUE;
-            json_object_object_add(comment, "body",
-            bugz_slist_to_json_string(bugz_modify_arguments.comment));
+            bugz_json_begin(&body, "comment", '{');
+            bugz_json_string_begin(&body, "body");
+            bugz_json_string_append(&body, bugz_modify_comment_in.data, bugz_modify_comment_in.len);
+            bugz_json_string_end(&body);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.component)
-            json_object_object_add(json, "component",
-            bugz_slist_to_json_string(bugz_modify_arguments.component));
+        if (args->component)
+            bugz_json_last(&body, "component", args->component);
 
-        if (bugz_modify_arguments.deadline)
-            json_object_object_add(json, "deadline",
-            bugz_slist_to_json_string(bugz_modify_arguments.deadline));
+        if (args->deadline)
+            bugz_json_last(&body, "deadline", args->deadline);
 
-        if (bugz_modify_arguments.duplicate)
-            json_object_object_add(json, "dupe_of", 
-            json_object_new_int(atoi(bugz_modify_arguments.duplicate->data)));
+        if (args->duplicate)
+            bugz_json_int(&body, "dupe_of", atoi(args->duplicate->data));
 
-        if (bugz_modify_arguments.estimated_time)
-            json_object_object_add(json, "estimated_time",
-            json_object_new_double(atof(bugz_modify_arguments.estimated_time->data)));
+        if (args->estimated_time)
+            bugz_json_double(&body, "estimated_time", atof(args->estimated_time->data));
 
-        if (bugz_modify_arguments.remaining_time)
-            json_object_object_add(json, "remaining_time",
-            json_object_new_double(atof(bugz_modify_arguments.remaining_time->data)));
+        if (args->remaining_time)
+            bugz_json_double(&body, "remaining_time", atof(args->remaining_time->data));
 
-        if (bugz_modify_arguments.work_time) {
+        if (args->work_time) {
             has_work_time = TRUE;
-            json_object_object_add(json, "work_time",
-            json_object_new_double(atof(bugz_modify_arguments.work_time->data)));
+            bugz_json_double(&body, "work_time", atof(args->work_time->data));
         }
 
-        if (bugz_modify_arguments.add_group) {
-            int j;
-            json_object *groups;
-            j=json_object_object_get_ex(json, "groups", &groups);
-            if (j == 0) {
-                groups = json_object_new_object();
-                json_object_object_add(json, "groups", groups);
-            }
-            json_object_object_add(groups, "add",
-            bugz_slist_to_json_array(bugz_modify_arguments.add_group, json_type_string));
+        if (args->add_group || args->remove_group) {
+            bugz_json_begin(&body, "groups", '{');
+            if (args->add_group)
+                bugz_json_slist(&body, "add", args->add_group, json_type_string);
+            if (args->remove_group)
+                bugz_json_slist(&body, "remove", args->remove_group, json_type_string);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.remove_group) {
-            int j;
-            json_object *groups;
-            j=json_object_object_get_ex(json, "groups", &groups);
-            if (j == 0) {
-                groups = json_object_new_object();
-                json_object_object_add(json, "groups", groups);
-            }
-            json_object_object_add(groups, "remove",
-            bugz_slist_to_json_array(bugz_modify_arguments.remove_group, json_type_string));
+        if (args->set_keywords) {
+            bugz_json_begin(&body, "keywords", '{');
+            bugz_json_slist(&body, "set", args->set_keywords, json_type_string);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.set_keywords) {
-            int j;
-            json_object *keywords;
-            j=json_object_object_get_ex(json, "keywords", &keywords);
-            if (j == 0) {
-                keywords = json_object_new_object();
-                json_object_object_add(json, "keywords", keywords);
-            }
-            json_object_object_add(keywords, "set",
-            bugz_slist_to_json_array(bugz_modify_arguments.set_keywords, json_type_string));
-        }
+        if (args->op_sys)
+            bugz_json_last(&body, "op_sys", args->op_sys);
 
-        if (bugz_modify_arguments.op_sys)
-            json_object_object_add(json, "op_sys",
-            bugz_slist_to_json_string(bugz_modify_arguments.op_sys));
+        if (args->platform)
+            bugz_json_last(&body, "platform", args->platform);
 
-        if (bugz_modify_arguments.platform)
-            json_object_object_add(json, "platform",
-            bugz_slist_to_json_string(bugz_modify_arguments.platform));
+        if (args->priority)
+            bugz_json_last(&body, "priority", args->priority);
 
-        if (bugz_modify_arguments.priority)
-            json_object_object_add(json, "priority",
-            bugz_slist_to_json_string(bugz_modify_arguments.priority));
+        if (args->product)
+            bugz_json_last(&body, "product", args->product);
 
-        if (bugz_modify_arguments.product)
-            json_object_object_add(json, "product",
-            bugz_slist_to_json_string(bugz_modify_arguments.product));
+        if (resolution)
+            bugz_json_string(&body, "resolution", resolution);
 
-        if (bugz_modify_arguments.resolution) {
-            if (bugz_modify_arguments.duplicate == NULL)
-                json_object_object_add(json, "resolution",
-                bugz_slist_to_json_string(bugz_modify_arguments.resolution));
+        if (args->add_see_also || args->remove_see_also) {
+            bugz_json_begin(&body, "see_also", '{');
+            if (args->add_see_also)
+                bugz_json_slist(&body, "add", args->add_see_also, json_type_string);
+            if (args->remove_see_also)
+                bugz_json_slist(&body, "remove", args->remove_see_also, json_type_string);
+            bugz_json_end(&body, '}');
         }
 
-        if (bugz_modify_arguments.add_see_also) {
-            int j;
-            json_object *see_also;
-            j=json_object_object_get_ex(json, "see_also", &see_also);
-            if (j == 0) {
-                see_also = json_object_new_object();
-                json_object_object_add(json, "see_also", see_also);
-            }
-            json_object_object_add(see_also, "add",
-            bugz_slist_to_json_array(bugz_modify_arguments.add_see_also, json_type_string));
-        }
+        if (args->severity)
+            bugz_json_last(&body, "severity", args->severity);
 
-        if (bugz_modify_arguments.remove_see_also) {
-            int j;
-            json_object *see_also;
-            j=json_object_object_get_ex(json, "see_also", &see_also);
-            if (j == 0) {
-                see_also = json_object_new_object();
-                json_object_object_add(json, "see_also", see_also);
-            }
-            json_object_object_add(see_also, "remove",
-            bugz_slist_to_json_array(bugz_modify_arguments.remove_see_also, json_type_string));
-        }
+        if (status)
+            bugz_json_string(&body, "status", status);
 
-        if (bugz_modify_arguments.severity)
-            json_object_object_add(json, "severity",
-            bugz_slist_to_json_string(bugz_modify_arguments.severity));
+        if (args->title)
+            bugz_json_last(&body, "summary", args->title);
 
-        if (bugz_modify_arguments.status) {
-            if (bugz_modify_arguments.duplicate == NULL)
-                json_object_object_add(json, "status",
-                bugz_slist_to_json_string(bugz_modify_arguments.status));
-        }
-
-        if (bugz_modify_arguments.title)
-            json_object_object_add(json, "summary",
-            bugz_slist_to_json_string(bugz_modify_arguments.title));
-
-        if (bugz_modify_arguments.url)
-            json_object_object_add(json, "url",
-            bugz_slist_to_json_string(bugz_modify_arguments.url));
-
-        if (bugz_modify_arguments.version)
-            json_object_object_add(json, "version",
-            bugz_slist_to_json_string(bugz_modify_arguments.version));
+        if (args->url)
+            bugz_json_last(&body, "url", args->url);
 
-        if (bugz_modify_arguments.whiteboard)
-            json_object_object_add(json, "whiteboard",
-            bugz_slist_to_json_string(bugz_modify_arguments.whiteboard));
+        if (args->version)
+            bugz_json_last(&body, "version", args->version);
 
-        if (bugz_modify_arguments.fixed) {
-            json_object_object_add(json, "status",
-            json_object_new_string("RESOLVED"));
-            json_object_object_add(json, "resolution",
-            json_object_new_string("FIXED"));
-        }
-
-        if (bugz_modify_arguments.invalid) {
-            json_object_object_add(json, "status",
-            json_object_new_string("RESOLVED"));
-            json_object_object_add(json, "resolution",
-            json_object_new_string("INVALID"));
-        }
+        if (args->whiteboard)
+            bugz_json_last(&body, "whiteboard", args->whiteboard);
     }
-    if (json_object_object_length(json) < 2) {
+    bugz_input_close(&bugz_modify_comment_in);
+    if (bugz_json_members(&body) < 2) {
         fprintf(stderr, N_("No changes were specified\n"));
-        json_object_put(json);
+        bugz_json_free(&body);
         curl_easy_cleanup(curl);
         exit(1);
     }
+    bugz_json_end(&body, '}');
     curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(json));
+    bugz_json_setopt(curl, &body);
 
     fprintf(stderr, N_(" * Info: Using %s\n"), base);
 
@@ -757,6 +633,7 @@ int bugz_modify_main(int argc, char **argv) {
         json_object_put(json);
         retval = 0;
     }
+    bugz_json_free(&body);
     curl_easy_cleanup(curl);
 
     return retval;
@@ -0,0 +1,548 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <stdarg.h>
+
+#include "bugz.h"
+
+/*
+ * Buffered output sink, everything rendered for stdout goes through
+ * a single large buffer which is written out with fwrite(3) when full.
+ *
+ */
+#define BUGZ_SINK_SIZE (256 * 1024)
+
+struct bugz_sink_t bugz_stdout = { 0 };
+
+static void bugz_sink_atexit(void) {
+    bugz_sink_flush(&bugz_stdout);
+}
+
+static int bugz_sink_init(struct bugz_sink_t *sink) {
+    if (sink->data)
+        return TRUE;
+    if (sink->size == 0)
+        sink->size = BUGZ_SINK_SIZE;
+    if ((sink->data = (char *)malloc(sink->size)) == NULL) {
+        sink->size = 0;
+        return FALSE;
+    }
+    sink->used = 0;
+    if (sink == &bugz_stdout)
+        atexit(bugz_sink_atexit);
+    return TRUE;
+}
+
+void bugz_sink_flush(struct bugz_sink_t *sink) {
+    FILE *fp = sink->fp ? sink->fp : stdout;
+    if (sink->used) {
+        fwrite(sink->data, 1, sink->used, fp);
+        sink->used = 0;
+    }
+    fflush(fp);
+}
+
+void bugz_sink_write(struct bugz_sink_t *sink, const char *data, size_t len) {
+    if (bugz_sink_init(sink) == FALSE) {
+        fwrite(data, 1, len, sink->fp ? sink->fp : stdout);
+        return;
+    }
+    if (sink->used + len > sink->size) {
+        bugz_sink_flush(sink);
+        if (len > sink->size) { /* too large to be worth buffering */
+            fwrite(data, 1, len, sink->fp ? sink->fp : stdout);
+            return;
+        }
+    }
+    memcpy(sink->data + sink->used, data, len);
+    sink->used += len;
+}
+
+void bugz_sink_fill(struct bugz_sink_t *sink, int c, size_t n) {
+    char buf[256];
+    size_t i;
+    memset(buf, c, n < sizeof(buf) ? n : sizeof(buf));
+    for (i=0; i<n; i+=sizeof(buf))
+        bugz_sink_write(sink, buf, n - i < sizeof(buf) ? n - i : sizeof(buf));
+}
+
+void bugz_sink_printf(struct bugz_sink_t *sink, const char *fmt, ...) {
+    int len;
+    char *p;
+    va_list ap;
+
+    if (bugz_sink_init(sink)) {
+        va_start(ap, fmt);
+        len = vsnprintf(sink->data + sink->used, sink->size - sink->used, fmt, ap);
+        va_end(ap);
+        if (len < 0)
+            return;
+        if (sink->used + len < sink->size) {
+            sink->used += len;
+            return;
+        }
+    }
+    else {
+        va_start(ap, fmt);
+        len = vsnprintf(NULL, 0, fmt, ap);
+        va_end(ap);
+        if (len < 0)
+            return;
+    }
+    if ((p = (char *)malloc(len + 1)) == NULL)
+        return;
+    va_start(ap, fmt);
+    vsnprintf(p, len + 1, fmt, ap);
+    va_end(ap);
+    bugz_sink_write(sink, p, len);
+    free(p);
+}
+
+/*
+ * Width of the UTF-8 sequence starting with byte c, invalid lead bytes
+ * are treated as a single byte so the wrapper always makes progress.
+ */
+static inline size_t utf8_seqlen(unsigned char c) {
+    if (c < 0xc0)
+        return 1;
+    if (c < 0xe0)
+        return 2;
+    if (c < 0xf0)
+        return 3;
+    return c < 0xf8 ? 4 : 1;
+}
+
+/* only ASCII white space, bytes of multibyte sequences never match */
+static inline int utf8_isspace(unsigned char c) {
+    return c < 0x80 && isspace(c);
+}
+
+/*
+ * Wrap one line (no '\n' inside) at width columns, prefer to break
+ * on white space and fall back to a hard break on a character boundary.
+ */
+static void bugz_sink_wrap_line(struct bugz_sink_t *sink, const char *s, size_t len, int width) {
+    const unsigned char *p = (const unsigned char *)s;
+    size_t pos = 0;
+
+    while (pos < len) {
+        size_t q = pos, space = len, end;
+        int col = 0;
+
+        while (q < len && col < width) {
+            if (utf8_isspace(p[q]))
+                space = q;
+            q += utf8_seqlen(p[q]);
+            col++;
+        }
+        if (q >= len) {
+            bugz_sink_write(sink, s + pos, len - pos);
+            bugz_sink_write(sink, "\n", 1);
+            return;
+        }
+        if (utf8_isspace(p[q]))
+            space = q;
+        end = space < len ? space : q;
+        while (end > pos && utf8_isspace(p[end - 1]))
+            end--;
+        bugz_sink_write(sink, s + pos, end - pos);
+        bugz_sink_write(sink, "\n", 1);
+        pos = end;
+        while (pos < len && utf8_isspace(p[pos]))
+            pos++;
+    }
+}
+
+void bugz_sink_wrap(struct bugz_sink_t *sink, const char *text, size_t len, int width) {
+    const char *p, *eol, *end = text + len;
+
+    if (width < 1)
+        width = 1;
+    for (p = text; p < end; p = eol + 1) {
+        eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+        if (eol > p)
+            bugz_sink_wrap_line(sink, p, eol - p, width);
+        else
+            bugz_sink_write(sink, "\n", 1);
+    }
+}
+
+/*
+ * Machine readable output, records are written as they are streamed
+ * out of the response by bugz_get_records().
+ *
+ */
+static const char *bugz_output_names[] = {"text", "jsonl", "tsv", "csv", "raw", NULL};
+
+static const char *bugz_bug_columns[] = {
+    "id", "status", "resolution", "priority", "severity", "product", "component",
+    "assigned_to", "creator", "creation_time", "last_change_time", "summary", NULL
+};
+static const char *bugz_comment_columns[] = {
+    "bug_id", "id", "count", "creator", "time", "is_private", "text", NULL
+};
+static const char *bugz_attachment_columns[] = {
+    "bug_id", "id", "file_name", "content_type", "size", "creator", "creation_time",
+    "last_change_time", "is_patch", "is_obsolete", "is_private", "summary", NULL
+};
+static const char *bugz_history_columns[] = {
+    "bug_id", "when", "who", "field_name", "removed", "added", NULL
+};
+static const char *bugz_delta_columns[] = {
+    "change", "id", "status", "resolution", "priority", "severity", "product", "component",
+    "assigned_to", "creator", "creation_time", "last_change_time", "summary", NULL
+};
+static const char **bugz_record_columns[] = {
+    bugz_bug_columns, bugz_comment_columns, bugz_attachment_columns, bugz_history_columns,
+    bugz_delta_columns
+};
+static const char *bugz_record_names[] = {"bug", "comment", "attachment", "history", "delta"};
+
+/*
+ * Several record kinds in one tsv/csv stream (bugz_output_headers()), the rows
+ * start with the kind and share the union of the columns of these kinds
+ */
+static int bugz_output_mixed = FALSE;
+static const char *bugz_output_shared[64];
+
+int bugz_output_format(const char *name) {
+    int i;
+    for (i=0; bugz_output_names[i]; i++) {
+        if (strcmp(name, bugz_output_names[i]) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char **bugz_output_columns(int kind) {
+    return bugz_record_columns[kind];
+}
+
+static void bugz_output_field(struct bugz_sink_t *sink, const char *s, size_t len) {
+    size_t i, start = 0;
+    if (bugz_arguments.output_format == bugz_output_csv) {
+        if (strcspn(s, ",\"\r\n") >= len) {
+            bugz_sink_write(sink, s, len);
+            return;
+        }
+        bugz_sink_write(sink, "\"", 1);
+        for (i=0; i<len; i++) {
+            if (s[i] == '"') {
+                bugz_sink_write(sink, s + start, i + 1 - start);
+                start = i;
+            }
+        }
+        bugz_sink_write(sink, s + start, len - start);
+        bugz_sink_write(sink, "\"", 1);
+        return;
+    }
+    for (i=0; i<len; i++) { /* tsv */
+        const char *e;
+        switch (s[i]) {
+        case '\t' : e = "\\t";  break;
+        case '\n' : e = "\\n";  break;
+        case '\r' : e = "\\r";  break;
+        case '\\' : e = "\\\\"; break;
+        default   : continue;
+        }
+        bugz_sink_write(sink, s + start, i - start);
+        bugz_sink_write(sink, e, 2);
+        start = i + 1;
+    }
+    bugz_sink_write(sink, s + start, len - start);
+}
+
+static void bugz_output_value(struct bugz_sink_t *sink, json_object *val) {
+    int i, n;
+    const char *s;
+    char *buf = NULL, *t;
+    size_t k, len = 0, size = 0;
+    switch (json_object_get_type(val)) {
+    case json_type_null :
+        return;
+    case json_type_array :
+        /* one field, the elements joined with ',' */
+        n = json_object_array_length(val);
+        for (i=0; i<n; i++) {
+            s = json_object_get_string(json_object_array_get_idx(val, i));
+            k = s ? strlen(s) : 0;
+            if (len + k + 2 > size) {
+                size = (len + k + 2) * 2;
+                if ((t = (char *)realloc(buf, size)) == NULL)
+                    break;
+                buf = t;
+            }
+            if (i)
+                buf[len++] = ',';
+            memcpy(buf + len, s ? s : "", k);
+            len += k;
+            buf[len] = '\0';
+        }
+        if (buf)
+            bugz_output_field(sink, buf, len);
+        free(buf);
+        return;
+    case json_type_string :
+        bugz_output_field(sink, json_object_get_string(val), json_object_get_string_len(val));
+        return;
+    default :
+        s = json_object_to_json_string_ext(val, JSON_C_TO_STRING_PLAIN);
+        bugz_output_field(sink, s, strlen(s));
+    }
+}
+
+static int bugz_output_has_column(const char **columns, const char *name) {
+    int i;
+    for (i=0; columns[i]; i++) {
+        if (strcmp(columns[i], name) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static void bugz_output_row(struct bugz_sink_t *sink, int kind,
+                            json_object *record, json_object *extra) {
+    int i;
+    json_object *val;
+    const char **columns = bugz_record_columns[kind];
+    char sep = bugz_arguments.output_format == bugz_output_csv ? ',' : '\t';
+    if (bugz_output_mixed) {
+        bugz_sink_write(sink, bugz_record_names[kind], strlen(bugz_record_names[kind]));
+        for (i=0; bugz_output_shared[i]; i++) {
+            bugz_sink_write(sink, &sep, 1);
+            if (bugz_output_has_column(columns, bugz_output_shared[i]) &&
+               (json_object_object_get_ex(record, bugz_output_shared[i], &val) ||
+               (extra && json_object_object_get_ex(extra, bugz_output_shared[i], &val))))
+                bugz_output_value(sink, val);
+        }
+        bugz_sink_write(sink, "\n", 1);
+        return;
+    }
+    for (i=0; columns[i]; i++) {
+        if (i)
+            bugz_sink_write(sink, &sep, 1);
+        if (json_object_object_get_ex(record, columns[i], &val) ||
+           (extra && json_object_object_get_ex(extra, columns[i], &val)))
+            bugz_output_value(sink, val);
+    }
+    bugz_sink_write(sink, "\n", 1);
+}
+
+void bugz_output_header(struct bugz_sink_t *sink, int kind) {
+    int i;
+    const char **columns = bugz_record_columns[kind];
+    char sep = bugz_arguments.output_format == bugz_output_csv ? ',' : '\t';
+    if (bugz_arguments.output_format != bugz_output_tsv &&
+        bugz_arguments.output_format != bugz_output_csv)
+        return;
+    for (i=0; columns[i]; i++) {
+        if (i)
+            bugz_sink_write(sink, &sep, 1);
+        bugz_sink_write(sink, columns[i], strlen(columns[i]));
+    }
+    bugz_sink_write(sink, "\n", 1);
+}
+
+/*
+ * Header of a stream of the record kinds in the mask (1 << kind), with more
+ * than one kind a leading "kind" column tells the rows apart
+ */
+void bugz_output_headers(struct bugz_sink_t *sink, int kinds) {
+    int i, kind, n = 0;
+    const char **columns;
+    char sep = bugz_arguments.output_format == bugz_output_csv ? ',' : '\t';
+
+    for (kind=bugz_record_bug; kind<=bugz_record_delta; kind++) {
+        if (kinds == (1 << kind)) {
+            bugz_output_header(sink, kind);
+            return;
+        }
+    }
+    for (kind=bugz_record_bug; kind<=bugz_record_delta; kind++) {
+        if ((kinds & (1 << kind)) == 0)
+            continue;
+        columns = bugz_record_columns[kind];
+        for (i=0; columns[i]; i++) {
+            bugz_output_shared[n] = NULL;
+            if (bugz_output_has_column(bugz_output_shared, columns[i]) == FALSE)
+                bugz_output_shared[n++] = columns[i];
+        }
+    }
+    bugz_output_shared[n] = NULL;
+    bugz_output_mixed = TRUE;
+    if (bugz_arguments.output_format != bugz_output_tsv &&
+        bugz_arguments.output_format != bugz_output_csv)
+        return;
+    bugz_sink_write(sink, "kind", 4);
+    for (i=0; i<n; i++) {
+        bugz_sink_write(sink, &sep, 1);
+        bugz_sink_write(sink, bugz_output_shared[i], strlen(bugz_output_shared[i]));
+    }
+    bugz_sink_write(sink, "\n", 1);
+}
+
+void bugz_output_record(struct bugz_sink_t *sink, int kind, json_object *record) {
+    int i, n;
+    const char *s;
+    size_t len;
+    json_object *changes = NULL;
+
+    switch (bugz_arguments.output_format) {
+    case bugz_output_jsonl :
+        s = json_object_to_json_string_length(record, JSON_C_TO_STRING_PLAIN, &len);
+        bugz_sink_write(sink, s, len);
+        bugz_sink_write(sink, "\n", 1);
+        break;
+    case bugz_output_tsv :
+    case bugz_output_csv :
+        if (kind != bugz_record_history) {
+            bugz_output_row(sink, kind, record, NULL);
+            break;
+        }
+        /* one row per change */
+        json_object_object_get_ex(record, "changes", &changes);
+        n = json_object_is_type(changes, json_type_array) ? json_object_array_length(changes) : 0;
+        for (i=0; i<n; i++)
+            bugz_output_row(sink, kind, json_object_array_get_idx(changes, i), record);
+        break;
+    }
+}
+
+int bugz_output_callback(json_object *record, void *userp) {
+    struct bugz_output_t *output = (struct bugz_output_t *)userp;
+    if (output->bug_id > 0 && output->kind != bugz_record_bug &&
+        !json_object_object_get_ex(record, "bug_id", NULL))
+        json_object_object_add(record, "bug_id", json_object_new_int(output->bug_id));
+    bugz_output_record(&bugz_stdout, output->kind, record);
+    output->records++;
+    return 0;
+}
+
+/*
+ * Rows of a search bug table (--sort, --group-by, --count), the columns
+ * are the first ones of the table, as added by bugz_output_table_columns()
+ */
+int bugz_output_table_columns(struct bugz_table_t *t, int kind) {
+    int i;
+    const char **columns = bugz_record_columns[kind];
+    for (i=0; columns[i]; i++)
+        bugz_table_column(t, bugz_field_lookup(columns[i], strlen(columns[i])));
+    return i;
+}
+
+static void bugz_output_cell(struct bugz_sink_t *sink, struct bugz_json_t *w,
+                             const struct bugz_table_t *t, int row, int col) {
+    const char *name = t->columns[col].field->name;
+    const char *s = bugz_table_string(t, row, col);
+
+    if (bugz_arguments.output_format != bugz_output_jsonl) {
+        if (s)
+            bugz_output_field(sink, s, strlen(s));
+    }
+    else if (t->columns[col].kind == bugz_table_int) {
+        bugz_json_int(w, name, (int)bugz_table_cell(t, row, col));
+    }
+    else {
+        bugz_json_string(w, name, s);
+    }
+}
+
+static void bugz_output_table_header(struct bugz_sink_t *sink, const struct bugz_table_t *t,
+                                     const int *columns, int ncolumns, const char *count) {
+    int c;
+    const char *name;
+    char sep = bugz_arguments.output_format == bugz_output_csv ? ',' : '\t';
+    if (bugz_arguments.output_format != bugz_output_tsv &&
+        bugz_arguments.output_format != bugz_output_csv)
+        return;
+    for (c=0; c<ncolumns; c++) {
+        if (c)
+            bugz_sink_write(sink, &sep, 1);
+        name = t->columns[columns ? columns[c] : c].field->name;
+        bugz_sink_write(sink, name, strlen(name));
+    }
+    if (count) {
+        if (ncolumns)
+            bugz_sink_write(sink, &sep, 1);
+        bugz_sink_write(sink, count, strlen(count));
+    }
+    bugz_sink_write(sink, "\n", 1);
+}
+
+static void bugz_output_table_row(struct bugz_sink_t *sink, struct bugz_json_t *w,
+                                  const struct bugz_table_t *t, const int *columns, int ncolumns,
+                                  int row, int count) {
+    int c;
+    char buf[16], sep = bugz_arguments.output_format == bugz_output_csv ? ',' : '\t';
+
+    if (bugz_arguments.output_format == bugz_output_jsonl)
+        bugz_json_begin(w, NULL, '{');
+    for (c=0; c<ncolumns; c++) {
+        if (c && bugz_arguments.output_format != bugz_output_jsonl)
+            bugz_sink_write(sink, &sep, 1);
+        bugz_output_cell(sink, w, t, row, columns ? columns[c] : c);
+    }
+    if (count >= 0) {
+        if (bugz_arguments.output_format == bugz_output_jsonl) {
+            bugz_json_int(w, "count", count);
+        }
+        else {
+            if (ncolumns)
+                bugz_sink_write(sink, &sep, 1);
+            bugz_sink_write(sink, buf, snprintf(buf, sizeof(buf), "%d", count));
+        }
+    }
+    if (bugz_arguments.output_format == bugz_output_jsonl) {
+        bugz_json_end(w, '}');
+        bugz_sink_write(sink, w->data, w->used);
+        bugz_json_reset(w);
+    }
+    bugz_sink_write(sink, "\n", 1);
+}
+
+void bugz_output_table(struct bugz_sink_t *sink, const struct bugz_table_t *t, int ncolumns) {
+    int i;
+    struct bugz_json_t w = { 0 };
+
+    bugz_output_table_header(sink, t, NULL, ncolumns, NULL);
+    for (i=0; i<t->selected; i++)
+        bugz_output_table_row(sink, &w, t, NULL, ncolumns, t->order[i], -1);
+    bugz_json_free(&w);
+}
+
+/* one row per group with its count, col < 0 for the total only */
+void bugz_output_groups(struct bugz_sink_t *sink, const struct bugz_table_t *t, int col,
+                        const struct bugz_table_group_t *groups, int n) {
+    int i;
+    const char *s;
+    struct bugz_json_t w = { 0 };
+
+    if (bugz_arguments.output_format == bugz_output_text) {
+        if (col < 0)
+            bugz_sink_printf(sink, "%d\n", t->selected);
+        for (i=0; col>=0 && i<n; i++) {
+            s = bugz_table_string(t, groups[i].row, col);
+            bugz_sink_printf(sink, "%7d %s\n", groups[i].count, s ? s : "(null)");
+        }
+        return;
+    }
+    bugz_output_table_header(sink, t, &col, col < 0 ? 0 : 1, "count");
+    if (col < 0)
+        bugz_output_table_row(sink, &w, t, NULL, 0, 0, t->selected);
+    for (i=0; col>=0 && i<n; i++)
+        bugz_output_table_row(sink, &w, t, &col, 1, groups[i].row, groups[i].count);
+    bugz_json_free(&w);
+}
@@ -0,0 +1,616 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include <locale.h>
+#include <stdint.h>
+
+#include "bugz.h"
+
+#ifdef BUGZ_SIMD_JSON
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define BUGZ_PARSE_X86 1    /* AVX2 and PCLMUL kernels, picked at run time */
+#elif defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#endif
+
+/*
+ * Parse backends behind bugz_fetch_to_json(), data is NUL terminated
+ * at len. json-c's tokener is the default, with --enable-simd-json a
+ * structural index parser is built as well and takes its place.
+ *
+ */
+static int bugz_parse_tokener(const char *data, size_t len, json_object **jsonp) {
+    enum json_tokener_error err;
+
+    *jsonp = json_tokener_parse_verbose(data, &err);
+    if (err != json_tokener_success) {
+        json_object_put(*jsonp);
+        *jsonp = NULL;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+#ifdef BUGZ_SIMD_JSON
+/*
+ * Structural index parser, the input is classified 64 bytes at a time
+ * into bitmasks (quotes, backslashes, operators, whitespace) with SIMD
+ * compares. Escaped quotes and string contents are masked out with
+ * carry-less bit arithmetic, which leaves the positions of every
+ * operator, quote and scalar start. The json-c document is then built
+ * by walking those positions only, strings without escapes are copied
+ * in one go.
+ */
+#define BUGZ_PARSE_WINDOW (64 * 1024)
+#define BUGZ_PARSE_DEPTH 64
+
+struct bugz_parse_masks_t {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t space;
+};
+
+#ifdef BUGZ_PARSE_X86
+__attribute__((target("avx2")))
+static inline void bugz_parse_classify_avx2(const unsigned char *p, struct bugz_parse_masks_t *m) {
+    int i;
+    const __m256i quote = _mm256_set1_epi8('"'), backslash = _mm256_set1_epi8('\\');
+    const __m256i comma = _mm256_set1_epi8(','), colon = _mm256_set1_epi8(':');
+    const __m256i lbracket = _mm256_set1_epi8('['), rbracket = _mm256_set1_epi8(']');
+    const __m256i lbrace = _mm256_set1_epi8('{'), rbrace = _mm256_set1_epi8('}');
+    const __m256i space = _mm256_set1_epi8(' '), nl = _mm256_set1_epi8('\n');
+    const __m256i tab = _mm256_set1_epi8('\t'), cr = _mm256_set1_epi8('\r');
+    memset(m, 0, sizeof(*m));
+    for (i=0; i<2; i++) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + 32 * i));
+        __m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, comma), _mm256_cmpeq_epi8(v, colon)),
+                     _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lbracket), _mm256_cmpeq_epi8(v, rbracket)),
+                                     _mm256_or_si256(_mm256_cmpeq_epi8(v, lbrace), _mm256_cmpeq_epi8(v, rbrace))));
+        __m256i ws = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, nl)),
+                     _mm256_or_si256(_mm256_cmpeq_epi8(v, tab), _mm256_cmpeq_epi8(v, cr)));
+        m->quote |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)) << (32 * i);
+        m->backslash |= (uint64_t)(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, backslash)) << (32 * i);
+        m->op |= (uint64_t)(uint32_t)_mm256_movemask_epi8(op) << (32 * i);
+        m->space |= (uint64_t)(uint32_t)_mm256_movemask_epi8(ws) << (32 * i);
+    }
+}
+#endif
+
+static void bugz_parse_classify(const unsigned char *p, struct bugz_parse_masks_t *m) {
+#if defined(__SSE2__)
+    int i;
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\');
+    const __m128i comma = _mm_set1_epi8(','), colon = _mm_set1_epi8(':');
+    const __m128i lbracket = _mm_set1_epi8('['), rbracket = _mm_set1_epi8(']');
+    const __m128i lbrace = _mm_set1_epi8('{'), rbrace = _mm_set1_epi8('}');
+    const __m128i space = _mm_set1_epi8(' '), nl = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t'), cr = _mm_set1_epi8('\r');
+    memset(m, 0, sizeof(*m));
+    for (i=0; i<4; i++) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + 16 * i));
+        __m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, comma), _mm_cmpeq_epi8(v, colon)),
+                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lbracket), _mm_cmpeq_epi8(v, rbracket)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, lbrace), _mm_cmpeq_epi8(v, rbrace))));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, nl)),
+                     _mm_or_si128(_mm_cmpeq_epi8(v, tab), _mm_cmpeq_epi8(v, cr)));
+        m->quote |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)) << (16 * i);
+        m->backslash |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, backslash)) << (16 * i);
+        m->op |= (uint64_t)(uint16_t)_mm_movemask_epi8(op) << (16 * i);
+        m->space |= (uint64_t)(uint16_t)_mm_movemask_epi8(ws) << (16 * i);
+    }
+#else
+    int i;
+    memset(m, 0, sizeof(*m));
+    for (i=0; i<64; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        switch (p[i]) {
+        case '"'  : m->quote |= bit; break;
+        case '\\' : m->backslash |= bit; break;
+        case '{'  : case '}' : case '[' : case ']' : case ':' : case ',' :
+            m->op |= bit;
+            break;
+        case ' '  : case '\t' : case '\r' : case '\n' :
+            m->space |= bit;
+            break;
+        }
+    }
+#endif
+}
+
+/* bit i set when an odd number of quotes is at or before i */
+static inline uint64_t bugz_parse_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+#ifdef BUGZ_PARSE_X86
+/* the same as a carry-less multiply by all ones */
+__attribute__((target("pclmul")))
+static inline uint64_t bugz_parse_prefix_xor_clmul(uint64_t x) {
+    return (uint64_t)_mm_cvtsi128_si64(_mm_clmulepi64_si128(_mm_set_epi64x(0, (long long)x),
+                                                            _mm_set1_epi8((char)0xff), 0));
+}
+#endif
+
+/* characters escaped by a backslash, runs of backslashes escape each other */
+static inline uint64_t bugz_parse_escaped(uint64_t backslash, uint64_t *carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    uint64_t follows, odd_starts, sum, escaped;
+
+    backslash &= ~*carry;
+    follows = backslash << 1 | *carry;
+    odd_starts = backslash & ~even & ~follows;
+    sum = odd_starts + backslash;
+    *carry = sum < backslash; /* a run reaches into the next block */
+    escaped = (even ^ (sum << 1)) & follows;
+    return escaped;
+}
+
+struct bugz_parse_frame_t {
+    json_object *container;
+    int is_object;
+};
+
+struct bugz_parse_t {
+    const char *data;
+    size_t len;
+
+    /* stage 1 */
+    uint64_t escape_carry;
+    uint64_t string_carry;  /* all ones while inside a string */
+    uint64_t scalar_carry;
+    uint32_t *index;
+    size_t nindex;
+
+    /* stage 2 */
+    json_object *root;
+    struct bugz_parse_frame_t stack[BUGZ_PARSE_DEPTH];
+    int depth;
+    enum {
+        bugz_expect_value, bugz_expect_value_or_end,
+        bugz_expect_key, bugz_expect_key_or_end,
+        bugz_expect_colon, bugz_expect_comma_or_end, bugz_expect_done
+    } expect;
+    size_t open;            /* position of the opening quote + 1, 0 outside strings */
+    int open_is_key;
+    char *key;
+    size_t key_alloc;
+    char *scratch;
+    size_t scratch_alloc;
+    int error;
+};
+
+/*
+ * Positions in [base, base + len) of everything stage 2 looks at, fast
+ * is a constant in each caller so that every copy keeps one kernel.
+ */
+static inline __attribute__((always_inline))
+void bugz_parse_stage1_blocks(struct bugz_parse_t *ps, size_t base, size_t len, int fast) {
+    size_t i;
+    unsigned char block[64];
+
+    ps->nindex = 0;
+    for (i=0; i<len; i+=64) {
+        struct bugz_parse_masks_t m;
+        uint64_t quote, in_string, scalar, starts, bits;
+        const unsigned char *p = (const unsigned char *)ps->data + base + i;
+
+        if (len - i < 64) {
+            memset(block, ' ', sizeof(block));
+            memcpy(block, p, len - i);
+            p = block;
+        }
+#ifdef BUGZ_PARSE_X86
+        if (fast)
+            bugz_parse_classify_avx2(p, &m);
+        else
+#endif
+            bugz_parse_classify(p, &m);
+        quote = m.quote & ~bugz_parse_escaped(m.backslash, &ps->escape_carry);
+#ifdef BUGZ_PARSE_X86
+        if (fast)
+            in_string = bugz_parse_prefix_xor_clmul(quote) ^ ps->string_carry;
+        else
+#endif
+            in_string = bugz_parse_prefix_xor(quote) ^ ps->string_carry;
+        ps->string_carry = (uint64_t)((int64_t)in_string >> 63);
+
+        /* first byte of numbers and literals */
+        scalar = ~(m.op | m.space | quote);
+        starts = scalar & ~(scalar << 1 | ps->scalar_carry);
+        ps->scalar_carry = scalar >> 63;
+
+        bits = ((m.op | starts) & ~in_string) | quote;
+        if (len - i < 64)
+            bits &= ((uint64_t)1 << (len - i)) - 1;
+        while (bits) {
+            ps->index[ps->nindex++] = (uint32_t)(i + __builtin_ctzll(bits));
+            bits &= bits - 1;
+        }
+    }
+}
+
+static void bugz_parse_stage1_generic(struct bugz_parse_t *ps, size_t base, size_t len) {
+    bugz_parse_stage1_blocks(ps, base, len, FALSE);
+}
+
+#ifdef BUGZ_PARSE_X86
+__attribute__((target("avx2,pclmul")))
+static void bugz_parse_stage1_avx2(struct bugz_parse_t *ps, size_t base, size_t len) {
+    bugz_parse_stage1_blocks(ps, base, len, TRUE);
+}
+#endif
+
+/* the build runs anywhere, AVX2 and PCLMUL are only used when the CPU has them */
+static void bugz_parse_stage1(struct bugz_parse_t *ps, size_t base, size_t len) {
+#ifdef BUGZ_PARSE_X86
+    static void (*stage1)(struct bugz_parse_t *, size_t, size_t) = NULL;
+
+    if (stage1 == NULL) {
+        __builtin_cpu_init();
+        stage1 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("pclmul") ?
+                 bugz_parse_stage1_avx2 : bugz_parse_stage1_generic;
+    }
+    stage1(ps, base, len);
+#else
+    bugz_parse_stage1_generic(ps, base, len);
+#endif
+}
+
+static char *bugz_parse_reserve(char **buf, size_t *alloc, size_t n) {
+    char *t;
+    if (n <= *alloc)
+        return *buf;
+    if ((t = (char *)realloc(*buf, n * 2)) == NULL)
+        return NULL;
+    *alloc = n * 2;
+    return *buf = t;
+}
+
+static void bugz_parse_utf8(char **q, unsigned int cp) {
+    char *u = *q;
+    if (cp < 0x80)
+        *u++ = cp;
+    else if (cp < 0x800) {
+        *u++ = 0xc0 | (cp >> 6);
+        *u++ = 0x80 | (cp & 0x3f);
+    }
+    else if (cp < 0x10000) {
+        *u++ = 0xe0 | (cp >> 12);
+        *u++ = 0x80 | ((cp >> 6) & 0x3f);
+        *u++ = 0x80 | (cp & 0x3f);
+    }
+    else {
+        *u++ = 0xf0 | (cp >> 18);
+        *u++ = 0x80 | ((cp >> 12) & 0x3f);
+        *u++ = 0x80 | ((cp >> 6) & 0x3f);
+        *u++ = 0x80 | (cp & 0x3f);
+    }
+    *q = u;
+}
+
+static int bugz_parse_hex4(const char *s, unsigned int *cp) {
+    int i;
+    *cp = 0;
+    for (i=0; i<4; i++) {
+        char c = s[i];
+        if (c >= '0' && c <= '9')
+            *cp = (*cp << 4) | (c - '0');
+        else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+            *cp = (*cp << 4) | ((c | 0x20) - 'a' + 10);
+        else
+            return FALSE;
+    }
+    return TRUE;
+}
+
+/* unescaped into out (at least len + 1 bytes), returns the length or -1 */
+static long bugz_parse_unescape(const char *s, size_t len, char *out) {
+    const char *end = s + len;
+    char *q = out;
+    unsigned int cp, lo;
+
+    while (s < end) {
+        const char *b = memchr(s, '\\', end - s);
+        if (b == NULL)
+            b = end;
+        memcpy(q, s, b - s);
+        q += b - s;
+        if ((s = b) == end)
+            break;
+        if (++s == end)
+            return -1;
+        switch (*s++) {
+        case '"'  : *q++ = '"';  break;
+        case '\\' : *q++ = '\\'; break;
+        case '/'  : *q++ = '/';  break;
+        case 'b'  : *q++ = '\b'; break;
+        case 'f'  : *q++ = '\f'; break;
+        case 'n'  : *q++ = '\n'; break;
+        case 'r'  : *q++ = '\r'; break;
+        case 't'  : *q++ = '\t'; break;
+        case 'u'  :
+            if (end - s < 4 || !bugz_parse_hex4(s, &cp))
+                return -1;
+            s += 4;
+            if (cp >= 0xd800 && cp < 0xdc00 && end - s >= 6 && s[0] == '\\' && s[1] == 'u' &&
+                bugz_parse_hex4(s + 2, &lo) && lo >= 0xdc00 && lo < 0xe000) {
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                s += 6;
+            }
+            else if (cp >= 0xd800 && cp < 0xe000)
+                cp = 0xfffd; /* lone surrogate */
+            bugz_parse_utf8(&q, cp);
+            break;
+        default :
+            return -1;
+        }
+    }
+    *q = '\0';
+    return q - out;
+}
+
+/* number or literal starting at pos */
+static json_object *bugz_parse_scalar(struct bugz_parse_t *ps, size_t pos) {
+    const char *s = ps->data + pos, *p = s, *end = ps->data + ps->len;
+    int is_double = FALSE;
+    size_t n;
+
+    while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ':' && *p != '"' &&
+           *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '{' && *p != '[')
+        p++;
+    n = p - s;
+    if (n == 4 && memcmp(s, "true", 4) == 0)
+        return json_object_new_boolean(TRUE);
+    if (n == 5 && memcmp(s, "false", 5) == 0)
+        return json_object_new_boolean(FALSE);
+    if (n == 4 && memcmp(s, "null", 4) == 0)
+        return NULL;
+
+    /* -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+    p = s;
+    if (p < s + n && *p == '-')
+        p++;
+    if (p == s + n || *p < '0' || *p > '9' || (*p == '0' && p + 1 < s + n && p[1] >= '0' && p[1] <= '9'))
+        goto error;
+    while (p < s + n && *p >= '0' && *p <= '9')
+        p++;
+    if (p < s + n && *p == '.') {
+        is_double = TRUE;
+        if (++p == s + n || *p < '0' || *p > '9')
+            goto error;
+        while (p < s + n && *p >= '0' && *p <= '9')
+            p++;
+    }
+    if (p < s + n && (*p == 'e' || *p == 'E')) {
+        is_double = TRUE;
+        if (++p < s + n && (*p == '+' || *p == '-'))
+            p++;
+        if (p == s + n || *p < '0' || *p > '9')
+            goto error;
+        while (p < s + n && *p >= '0' && *p <= '9')
+            p++;
+    }
+    if (p != s + n)
+        goto error;
+
+    if (!is_double)
+        return json_object_new_int64(strtoll(s, NULL, 10));
+    else {
+        char buf[64], *dot;
+        const char *point = localeconv()->decimal_point;
+        if (n >= sizeof(buf))
+            goto error;
+        memcpy(buf, s, n);
+        buf[n] = '\0';
+        if (point[0] != '.' && point[1] == '\0' && (dot = strchr(buf, '.')))
+            *dot = point[0]; /* strtod(3) follows LC_NUMERIC */
+        return json_object_new_double(strtod(buf, NULL));
+    }
+error:
+    ps->error = TRUE;
+    return NULL;
+}
+
+/* value is complete, add it to the open container */
+static void bugz_parse_add(struct bugz_parse_t *ps, json_object *val) {
+    struct bugz_parse_frame_t *top;
+    if (ps->depth == 0) {
+        ps->root = val;
+        ps->expect = bugz_expect_done;
+        return;
+    }
+    top = &ps->stack[ps->depth - 1];
+    if (top->is_object)
+        json_object_object_add(top->container, ps->key, val);
+    else
+        json_object_array_add(top->container, val);
+    ps->expect = bugz_expect_comma_or_end;
+}
+
+static void bugz_parse_push(struct bugz_parse_t *ps, int is_object) {
+    json_object *val = is_object ? json_object_new_object() : json_object_new_array();
+    bugz_parse_add(ps, val);
+    if (ps->depth == BUGZ_PARSE_DEPTH) {
+        ps->error = TRUE;
+        return;
+    }
+    ps->stack[ps->depth].container = val;
+    ps->stack[ps->depth].is_object = is_object;
+    ps->depth++;
+    ps->expect = is_object ? bugz_expect_key_or_end : bugz_expect_value_or_end;
+}
+
+static void bugz_parse_pop(struct bugz_parse_t *ps, char c) {
+    if (ps->depth == 0 || ps->stack[ps->depth - 1].is_object != (c == '}')) {
+        ps->error = TRUE;
+        return;
+    }
+    ps->depth--;
+    ps->expect = ps->depth ? bugz_expect_comma_or_end : bugz_expect_done;
+}
+
+static void bugz_parse_string(struct bugz_parse_t *ps, size_t start, size_t end) {
+    const char *s = ps->data + start;
+    size_t len = end - start;
+    long n;
+
+    if (ps->open_is_key) {
+        if (bugz_parse_reserve(&ps->key, &ps->key_alloc, len + 1) == NULL ||
+            (n = bugz_parse_unescape(s, len, ps->key)) < 0) {
+            ps->error = TRUE;
+            return;
+        }
+        ps->expect = bugz_expect_colon;
+        return;
+    }
+    if (memchr(s, '\\', len) == NULL) {
+        bugz_parse_add(ps, json_object_new_string_len(s, (int)len));
+        return;
+    }
+    if (bugz_parse_reserve(&ps->scratch, &ps->scratch_alloc, len + 1) == NULL ||
+        (n = bugz_parse_unescape(s, len, ps->scratch)) < 0) {
+        ps->error = TRUE;
+        return;
+    }
+    bugz_parse_add(ps, json_object_new_string_len(ps->scratch, (int)n));
+}
+
+static void bugz_parse_stage2(struct bugz_parse_t *ps, size_t base) {
+    size_t i;
+    for (i=0; i<ps->nindex && !ps->error; i++) {
+        size_t pos = base + ps->index[i];
+        char c = ps->data[pos];
+
+        if (ps->open) { /* closing quote */
+            bugz_parse_string(ps, ps->open, pos);
+            ps->open = 0;
+            continue;
+        }
+        switch (ps->expect) {
+        case bugz_expect_value_or_end :
+            if (c == ']') {
+                bugz_parse_pop(ps, c);
+                break;
+            }
+            /* fall through */
+        case bugz_expect_value :
+            if (c == '{' || c == '[')
+                bugz_parse_push(ps, c == '{');
+            else if (c == '"') {
+                ps->open = pos + 1;
+                ps->open_is_key = FALSE;
+            }
+            else if (c == ',' || c == ':' || c == ']' || c == '}')
+                ps->error = TRUE;
+            else {
+                json_object *val = bugz_parse_scalar(ps, pos);
+                if (!ps->error)
+                    bugz_parse_add(ps, val);
+            }
+            break;
+        case bugz_expect_key_or_end :
+            if (c == '}') {
+                bugz_parse_pop(ps, c);
+                break;
+            }
+            /* fall through */
+        case bugz_expect_key :
+            if (c == '"') {
+                ps->open = pos + 1;
+                ps->open_is_key = TRUE;
+            }
+            else
+                ps->error = TRUE;
+            break;
+        case bugz_expect_colon :
+            if (c == ':')
+                ps->expect = bugz_expect_value;
+            else
+                ps->error = TRUE;
+            break;
+        case bugz_expect_comma_or_end :
+            if (c == ',')
+                ps->expect = ps->stack[ps->depth - 1].is_object ? bugz_expect_key : bugz_expect_value;
+            else if (c == '}' || c == ']')
+                bugz_parse_pop(ps, c);
+            else
+                ps->error = TRUE;
+            break;
+        case bugz_expect_done :
+            ps->error = TRUE;
+            break;
+        }
+    }
+}
+
+static int bugz_parse_simd(const char *data, size_t len, json_object **jsonp) {
+    size_t base;
+    struct bugz_parse_t ps;
+
+    memset(&ps, 0, sizeof(ps));
+    ps.data = data;
+    ps.len = len;
+    ps.expect = bugz_expect_value;
+    *jsonp = NULL;
+    if ((ps.index = (uint32_t *)malloc(BUGZ_PARSE_WINDOW * sizeof(uint32_t))) == NULL)
+        return FALSE;
+    for (base=0; base<len && !ps.error; base+=BUGZ_PARSE_WINDOW) {
+        bugz_parse_stage1(&ps, base, len - base < BUGZ_PARSE_WINDOW ? len - base : BUGZ_PARSE_WINDOW);
+        bugz_parse_stage2(&ps, base);
+    }
+    if (ps.open || ps.string_carry || ps.expect != bugz_expect_done)
+        ps.error = TRUE;
+    if (ps.error) {
+        json_object_put(ps.root);
+        ps.root = NULL;
+    }
+    free(ps.index);
+    free(ps.key);
+    free(ps.scratch);
+    *jsonp = ps.root;
+    return !ps.error;
+}
+#endif
+
+static const struct bugz_parser_t bugz_parsers[] = {
+#ifdef BUGZ_SIMD_JSON
+    { "simd",   bugz_parse_simd },
+#endif
+    { "json-c", bugz_parse_tokener },
+    { NULL,     NULL }
+};
+
+/* by name, NULL is the default one */
+const struct bugz_parser_t *bugz_parser_get(const char *name) {
+    int i;
+    for (i=0; bugz_parsers[i].name; i++) {
+        if (name == NULL || strcmp(name, bugz_parsers[i].name) == 0)
+            return &bugz_parsers[i];
+    }
+    return NULL;
+}
+
+/* FALSE on a syntax error, *jsonp is NULL then */
+int bugz_parse_json(const char *data, size_t len, json_object **jsonp) {
+    return bugz_parsers[0].parse(data, len, jsonp);
+}
@@ -113,11 +113,33 @@ struct bugz_post_arguments_t {
     int default_confirm;
 };
 static struct bugz_post_arguments_t bugz_post_arguments = { 0 };
+/*
+ * --description-from mapped and the --append-command output, both are
+ * written straight into the request body
+ */
+static struct bugz_input_t bugz_post_description_in = { 0 };
+static struct bugz_input_t bugz_post_append_in = { 0 };
 #define _append_post_arg_(m) bugz_post_arguments.m = \
-                             curl_slist_append(bugz_post_arguments.m, optarg)
+                             bugz_arena_slist_append(&bugz_arena, bugz_post_arguments.m, optarg)
+
+/* text of the description without the appended command, NULL if none yet */
+static const char *bugz_post_description(size_t *len) {
+    struct curl_slist *last;
+    if (bugz_post_description_in.data) {
+        *len = bugz_post_description_in.len;
+        return bugz_post_description_in.data;
+    }
+    last = bugz_slist_get_last(bugz_post_arguments.description);
+    if (last == NULL)
+        return NULL;
+    *len = strlen(last->data);
+    return last->data;
+}
 
 static void bugz_post_prompt_for_bug() {
     char *p, line[1024];
+    const char *description;
+    size_t len;
     struct curl_slist *last;
     fprintf(stderr, N_("Press Ctrl+C at any time to abort.\n"));
     
@@ -131,7 +153,7 @@ static void bugz_post_prompt_for_bug() {
             if (p)
                 *p = '\0';
         }
-        bugz_post_arguments.product = curl_slist_append(NULL, line);
+        bugz_post_arguments.product = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter product: %s\n", last->data);
@@ -146,7 +168,7 @@ static void bugz_post_prompt_for_bug() {
             if (p)
                 *p = '\0';
         }
-        bugz_post_arguments.component = curl_slist_append(NULL, line);
+        bugz_post_arguments.component = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter component: %s\n", last->data);
@@ -160,7 +182,7 @@ static void bugz_post_prompt_for_bug() {
             *p = '\0';
         if (strlen(line) == 0)
             strcpy(line, "unspecified");
-        bugz_post_arguments.version = curl_slist_append(NULL, line);
+        bugz_post_arguments.version = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter version: %s\n", last->data);
@@ -175,20 +197,20 @@ static void bugz_post_prompt_for_bug() {
             if (p)
                 *p = '\0';
         }
-        bugz_post_arguments.title = curl_slist_append(NULL, line);
+        bugz_post_arguments.title = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter title: %s\n", last->data);
 
-    last = bugz_slist_get_last(bugz_post_arguments.description);
-    if (last == NULL) {
+    description = bugz_post_description(&len);
+    if (description == NULL) {
         p = bugz_raw_input("Enter bug description (Press Ctrl+D to end): ");
         if (p)
-            bugz_post_arguments.description = curl_slist_append(NULL, p);
+            bugz_post_arguments.description = bugz_arena_slist_append(&bugz_arena, NULL, p);
         free(p);
     }
     else
-        fprintf(stderr, "Enter bug description: %s\n", last->data);
+        fprintf(stderr, "Enter bug description: %.*s\n", (int)len, description);
 
     last = bugz_slist_get_last(bugz_post_arguments.op_sys);
     if (last == NULL) {
@@ -198,7 +220,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.op_sys = curl_slist_append(NULL, line);
+            bugz_post_arguments.op_sys = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter operating system: %s\n", last->data);
@@ -211,7 +233,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.platform = curl_slist_append(NULL, line);
+            bugz_post_arguments.platform = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter hardware platform: %s\n", last->data);
@@ -224,7 +246,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.priority = curl_slist_append(NULL, line);
+            bugz_post_arguments.priority = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter priority (optional): %s\n", last->data);
@@ -237,7 +259,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.severity = curl_slist_append(NULL, line);
+            bugz_post_arguments.severity = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter severity (optional): %s\n", last->data);
@@ -250,7 +272,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.alias = curl_slist_append(NULL, line);
+            bugz_post_arguments.alias = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter alias (optional): %s\n", last->data);
@@ -263,7 +285,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.assigned_to = curl_slist_append(NULL, line);
+            bugz_post_arguments.assigned_to = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter assignee (optional): %s\n", last->data);
@@ -276,7 +298,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.cc = curl_slist_append(NULL, line);
+            bugz_post_arguments.cc = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter a CC list (optional): %s\n", last->data);
@@ -289,7 +311,7 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.url = curl_slist_append(NULL, line);
+            bugz_post_arguments.url = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Enter a URL (optional): %s\n", last->data);
@@ -303,62 +325,32 @@ static void bugz_post_prompt_for_bug() {
         if (p)
             *p = '\0';
         if (strlen(line))
-            bugz_post_arguments.append_command = curl_slist_append(NULL, line);
+            bugz_post_arguments.append_command = bugz_arena_slist_append(&bugz_arena, NULL, line);
     }
     else
         fprintf(stderr, "Append command (optional): %s\n", last->data);
 }
 
+/* output of the command, appended to the description in the body */
 static void bugz_post_append_command() {
-    char *p, *q;
-    int i = 0, s = 1024;
     FILE *fd = popen(bugz_post_arguments.append_command->data, "r");
-    
-    p = q = NULL;
-    while (fd && feof(fd) == 0) {
-        if (i == 0) {
-            i += s;
-            p = (char *)malloc(i);
-            memset(p, 0, i);
-        }
-        if (strlen(p) >= i-1) {
-            i += s;
-            q = (char *)malloc(i);
-            memset(q, 0, i);
-            strcpy(q, p);
-            free(p);
-            p = q;
-        }
-        fgets(p+strlen(p), i - strlen(p), fd);
-    }
-    pclose(fd);
-    if (p) {
-        i = 0;
-        json_object *val = bugz_slist_to_json_string(bugz_post_arguments.description);
-        if (val)
-            i += json_object_get_string_len(val);
-        i += strlen(bugz_post_arguments.append_command->data);
-        i += strlen(p);
-        q = (char *)malloc(i+8);
-        strcpy(q, json_object_get_string(val));
-        strcat(q, "\n\n$");
-        strcat(q, bugz_post_arguments.append_command->data);
-        strcat(q, "\n");
-        strcat(q, p);
-        curl_slist_free_all(bugz_post_arguments.description);
-        bugz_post_arguments.description = curl_slist_append(NULL, q);
-        free(p); free(q);
+
+    if (fd) {
+        bugz_input_file(&bugz_post_append_in, fd, BUGZ_INPUT_TEXT_MAX);
+        pclose(fd);
     }
 }
 
 int bugz_post_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
-    char url[PATH_MAX] = {0};
+    char *url;
     char *base, *username, *password;
     int opt, longindex, retval = 1;
     struct bugz_config_t *config;
     struct curl_slist *headers = NULL;
+    struct bugz_json_t body = { 0 };
+    int id = 0;
 
     optind++;
     while (optind < argc) {
@@ -447,40 +439,18 @@ int bugz_post_main(int argc, char **argv) {
     else
         bugz_post_arguments.default_confirm = 'y';
     if (bugz_post_arguments.description_from) {
-        FILE *fp;
-        char *q, *p = bugz_post_arguments.description_from->data;
-        int i = 0, s = 1024;
-        if (strcmp(p, "-")) {
-            if ((fp = fopen(p, "rb")) == NULL) {
-                fprintf(stderr,
-                        N_("ERROR: unable to read file for '--description-from': %s\n"), p);
-                exit(1);
-            }
+        struct bugz_input_t *in = &bugz_post_description_in;
+        int ok = bugz_input_open(in, bugz_post_arguments.description_from->data);
+        if (ok && in->len > BUGZ_INPUT_TEXT_MAX) {
+            bugz_input_close(in);
+            errno = EFBIG;
+            ok = FALSE;
         }
-        else
-            fp = stdin;
-        p = q = NULL;
-        while (feof(fp) == 0) {
-            if (i == 0) {
-                i += s;
-                p = (char *)malloc(i);
-                memset(p, 0, i);
-            }
-            if (strlen(p) >= i-1) {
-                i += s;
-                q = (char *)malloc(i);
-                memset(q, 0, i);
-                strcpy(q, p);
-                free(p);
-                p = q;
-            }
-            fgets(p+strlen(p), i - strlen(p), fp);
+        if (!ok) {
+            fprintf(stderr, N_("ERROR: unable to read file for '--description-from': %s: %s\n"),
+                            bugz_post_arguments.description_from->data, strerror(errno));
+            exit(1);
         }
-        curl_slist_free_all(bugz_post_arguments.description);
-        bugz_post_arguments.description = curl_slist_append(NULL, p);
-        free(p);
-        if (fp != stdin)
-            fclose(fp);
     }
     if (bugz_post_arguments.batch == FALSE)
         bugz_post_prompt_for_bug();
@@ -499,7 +469,7 @@ int bugz_post_main(int argc, char **argv) {
                         argv[0]);
         exit(1);
     }
-    if (bugz_post_arguments.description == NULL) {
+    if (bugz_post_arguments.description == NULL && bugz_post_description_in.data == NULL) {
         fprintf(stderr, N_("ERROR: %s post: Description not specified\n"),
                         argv[0]);
         exit(1);
@@ -525,81 +495,99 @@ int bugz_post_main(int argc, char **argv) {
         }
     }
     if (password)
-        sprintf(url, "%s/rest/bug?login=%s&password=%s", base,
-                username, password);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug?login=%s&password=%s", base,
+                                username, password);
     else if (username)
-        sprintf(url, "%s/rest/bug?api_key=%s", base, username);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug?api_key=%s", base, username);
     else
-        sprintf(url, "%s/rest/bug", base);
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug", base);
     bugz_config_free(config);
     
-    json = json_object_new_object();
+    bugz_json_begin(&body, NULL, '{');
     if (1) {
         int j;
-        json_object *val;
+        size_t start, len;
+        const char *val;
         for (j=0; j<bugz_arguments.columns; j++)
             fprintf(stdout, "%c", '-');
         fprintf(stdout, "\n");
 
-        val = bugz_slist_to_json_string(bugz_post_arguments.product);
-        json_object_object_add(json, "product", val);
-        fprintf(stdout, "%-12s: %s\n", "Product", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_post_arguments.product)->data;
+        bugz_json_string(&body, "product", val);
+        fprintf(stdout, "%-12s: %s\n", "Product", val);
 
-        val = bugz_slist_to_json_string(bugz_post_arguments.component);
-        json_object_object_add(json, "component", val);
-        fprintf(stdout, "%-12s: %s\n", "Component", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_post_arguments.component)->data;
+        bugz_json_string(&body, "component", val);
+        fprintf(stdout, "%-12s: %s\n", "Component", val);
 
-        val = bugz_slist_to_json_string(bugz_post_arguments.title);
-        json_object_object_add(json, "summary", val);
-        fprintf(stdout, "%-12s: %s\n", "Title", json_object_get_string(val));
+        val = bugz_slist_get_last(bugz_post_arguments.title)->data;
+        bugz_json_string(&body, "summary", val);
+        fprintf(stdout, "%-12s: %s\n", "Title", val);
 
         if (bugz_post_arguments.version) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.version);
-            json_object_object_add(json, "version", val);
-            fprintf(stdout, "%-12s: %s\n", "Version", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.version)->data;
+            bugz_json_string(&body, "version", val);
+            fprintf(stdout, "%-12s: %s\n", "Version", val);
         }
 
-        val = NULL;
-        if (bugz_post_arguments.description) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.description);
-            json_object_object_add(json, "description", val);
+        if ((val = bugz_post_description(&len))) {
+            const struct bugz_input_t *out = &bugz_post_append_in;
+            bugz_json_string_begin(&body, "description");
+            bugz_json_string_append(&body, val, len);
+            if (out->data) {
+                const char *command = bugz_post_arguments.append_command->data;
+                bugz_json_string_append(&body, "\n\n$", 3);
+                bugz_json_string_append(&body, command, strlen(command));
+                bugz_json_string_append(&body, "\n", 1);
+                bugz_json_string_append(&body, out->data, out->len);
+                fprintf(stdout, "%-12s: %.*s\n\n$%s\n%.*s\n", "Description", (int)len, val,
+                                command, (int)out->len, out->data);
+            }
+            else
+                fprintf(stdout, "%-12s: %.*s\n", "Description", (int)len, val);
+            bugz_json_string_end(&body);
         }
-        fprintf(stdout, "%-12s: %s\n", "Description", json_object_get_string(val));
+        else
+            fprintf(stdout, "%-12s: %s\n", "Description", "(null)");
 
         if (bugz_post_arguments.op_sys) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.op_sys);
-            json_object_object_add(json, "op_sys", val);
-            fprintf(stdout, "%-12s: %s\n", "Operating System", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.op_sys)->data;
+            bugz_json_string(&body, "op_sys", val);
+            fprintf(stdout, "%-12s: %s\n", "Operating System", val);
         }
         if (bugz_post_arguments.platform) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.platform);
-            json_object_object_add(json, "platform", val);
-            fprintf(stdout, "%-12s: %s\n", "Platform", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.platform)->data;
+            bugz_json_string(&body, "platform", val);
+            fprintf(stdout, "%-12s: %s\n", "Platform", val);
         }
         if (bugz_post_arguments.priority) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.priority);
-            json_object_object_add(json, "priority", val);
-            fprintf(stdout, "%-12s: %s\n", "Priority", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.priority)->data;
+            bugz_json_string(&body, "priority", val);
+            fprintf(stdout, "%-12s: %s\n", "Priority", val);
         }
         if (bugz_post_arguments.severity) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.severity);
-            json_object_object_add(json, "severity", val);
-            fprintf(stdout, "%-12s: %s\n", "Severity", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.severity)->data;
+            bugz_json_string(&body, "severity", val);
+            fprintf(stdout, "%-12s: %s\n", "Severity", val);
         }
         if (bugz_post_arguments.alias) {
-            val = bugz_slist_to_json_array(bugz_post_arguments.alias, json_type_string);
-            json_object_object_add(json, "alias", val);
-            fprintf(stdout, "%-12s: %s\n", "Alias", json_object_get_string(val));
+            struct curl_slist *list;
+            /* arrays are shown as they are sent */
+            bugz_json_begin(&body, "alias", '[');
+            start = body.used - 1;
+            for (list = bugz_post_arguments.alias; list; list = list->next)
+                bugz_json_string(&body, NULL, list->data);
+            bugz_json_end(&body, ']');
+            fprintf(stdout, "%-12s: %.*s\n", "Alias", (int)(body.used - start), body.data + start);
         }
         if (bugz_post_arguments.assigned_to) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.assigned_to);
-            json_object_object_add(json, "assigned_to", val);
-            fprintf(stdout, "%-12s: %s\n", "Assigned to", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.assigned_to)->data;
+            bugz_json_string(&body, "assigned_to", val);
+            fprintf(stdout, "%-12s: %s\n", "Assigned to", val);
         }
         if (bugz_post_arguments.cc) {
             char *q, *p;
             struct curl_slist *last = bugz_slist_get_last(bugz_post_arguments.cc);
-            val = json_object_new_array();
             p = last->data;
             q = p;
             while (*q) {
@@ -607,24 +595,29 @@ int bugz_post_main(int argc, char **argv) {
                     *q = ',';
                 q++;
             }
+            bugz_json_begin(&body, "cc", '[');
+            start = body.used - 1;
             q = strtok(p, ",");
             while (q != NULL){
                 if (strlen(q) > 0)
-                    json_object_array_add(val, json_object_new_string(q));
+                    bugz_json_string(&body, NULL, q);
                 q = strtok(NULL, ",");
             }
-            json_object_object_add(json, "cc", val);
-            fprintf(stdout, "%-12s: %s\n", "CC", json_object_get_string(val));
+            bugz_json_end(&body, ']');
+            fprintf(stdout, "%-12s: %.*s\n", "CC", (int)(body.used - start), body.data + start);
         }
         if (bugz_post_arguments.url) {
-            val = bugz_slist_to_json_string(bugz_post_arguments.url);
-            json_object_object_add(json, "url", val);
-            fprintf(stdout, "%-12s: %s\n", "URL", json_object_get_string(val));
+            val = bugz_slist_get_last(bugz_post_arguments.url)->data;
+            bugz_json_string(&body, "url", val);
+            fprintf(stdout, "%-12s: %s\n", "URL", val);
         }
         for (j=0; j<bugz_arguments.columns; j++)
             fprintf(stdout, "%c", '-');
         fprintf(stdout, "\n");
     }
+    bugz_json_end(&body, '}');
+    bugz_input_close(&bugz_post_description_in);
+    bugz_input_close(&bugz_post_append_in);
     if (bugz_post_arguments.batch == FALSE) {
         char *p, confirm[1024] = {0};
         if (bugz_post_arguments.default_confirm == 'y' ||
@@ -645,34 +638,32 @@ int bugz_post_main(int argc, char **argv) {
         }
         if (confirm[0] != 'y' && confirm[0] != 'Y') {
             fprintf(stderr, N_("Submission aborted\n"));
-            json_object_put(json);
+            bugz_json_free(&body);
             exit(1);
         }
     }
 
     if ((curl = curl_easy_init()) == NULL) {
         fprintf(stderr, N_("ERROR: %s post: curl_easy_init() failed\n"), argv[0]);
-        json_object_put(json);
+        bugz_json_free(&body);
         exit(1);
     }
-    headers = curl_slist_append(headers, "charsets: utf-8");
-    headers = curl_slist_append(headers, "Accept: application/json");
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "charsets: utf-8");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Accept: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Content-Type: application/json");
     curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "POST");
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_object_to_json_string(json));
+    bugz_json_setopt(curl, &body);
 
     fprintf(stderr, N_(" * Info: Using %s\n"), base);
-    bugz_get_result(curl, url, &json);
+    bugz_get_fields(curl, url, "id", bugz_int_callback, &id, &json);
     if (bugz_check_result(json)) {
-        json_object *id;
-        json_object_object_get_ex(json, "id", &id);
-        fprintf(stderr, N_(" * Info: Bug %d submitted\n"),
-                        json_object_get_int(id));
-        fprintf(stdout, "Bug %d submitted\n", json_object_get_int(id));
+        fprintf(stderr, N_(" * Info: Bug %d submitted\n"), id);
+        fprintf(stdout, "Bug %d submitted\n", id);
         json_object_put(json);
         retval = 0;
     }
+    bugz_json_free(&body);
     curl_easy_cleanup(curl);
 
     return retval;
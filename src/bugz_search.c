@@ -12,6 +12,9 @@
  *
  */
 
+#include <limits.h>
+#include <sys/stat.h>
+
 #include "bugz.h"
 
 static struct option bugz_search_options[] = {
@@ -38,6 +41,12 @@ static struct option bugz_search_options[] = {
     {"show-status",      no_argument,       0,  0 },
     {"show-priority",    no_argument,       0,  0 },
     {"show-severity",    no_argument,       0,  0 },
+    {"sort",             required_argument, 0,  0 },
+    {"group-by",         required_argument, 0,  0 },
+    {"count",            no_argument,       0,  0 },
+    {"filter",           required_argument, 0,  0 },
+    {"save",             required_argument, 0,  0 },
+    {"refresh",          required_argument, 0,  0 },
     { 0 }
 };
 
@@ -65,6 +74,12 @@ typedef enum bugz_search_longopt_t {
     opt_search_show_status,
     opt_search_show_priority,
     opt_search_show_severity,
+    opt_search_sort,
+    opt_search_group_by,
+    opt_search_count,
+    opt_search_filter,
+    opt_search_save,
+    opt_search_refresh,
     opt_search_end
 } bugz_search_longopt_t;
 
@@ -101,6 +116,17 @@ void bugz_search_helper(int status) {
        "--show-status              : show status of bugs\n"
        "--show-priority            : show priority of bugs\n"
        "--show-severity            : show severity of bugs\n"
+       "--sort FIELD[,FIELD]       : sort bugs by fields, -FIELD for descending,\n"
+       "                             count orders the groups of --count\n"
+       "--group-by FIELD           : group bugs by the value of a field\n"
+       "--count                    : only count bugs, per group with --group-by\n"
+       "--filter EXPR              : keep the bugs matching EXPR, evaluated locally,\n"
+       "                             e.g. 'status in (NEW,ASSIGNED) and\n"
+       "                             priority <= P2 and last_change_time > -7d'\n"
+       "--save NAME                : save the search and its result as NAME\n"
+       "--refresh NAME             : run the saved search NAME again, only bugs\n"
+       "                             changed since the last run are fetched and\n"
+       "                             the new, changed and dropped ones are shown\n"
        "\n"
        "Type 'bugz --help' for valid global options\n");
     fprintf(stderr, "%s", help_header);
@@ -125,58 +151,482 @@ struct bugz_search_arguments_t {
     struct curl_slist *whiteboard;
     struct curl_slist *creation_time;
     struct curl_slist *last_change_time;
+    struct curl_slist *sort;
+    char *group_by;
+    char *filter;
+    char *save;
+    char *refresh;
     int limit;
     int offset;
     int comments;
     int show_status;
     int show_priority;
     int show_severity;
+    int count;
 };
 static struct bugz_search_arguments_t bugz_search_arguments = { 0 };
 #define _append_search_arg_(m) bugz_search_arguments.m = \
-                               curl_slist_append(bugz_search_arguments.m, optarg)
-
-static void bugz_search_list_bugs(json_object *bugs) {
-    int i, len;
-    json_object *bug;
-    char line[1024] = {0};
-
-    len = json_object_array_length(bugs);
-    fprintf(stderr, N_(" * Info: %d bug(s) found.\n"), len);
-    for (i=0; i<len; i++) {
-        bug = json_object_array_get_idx(bugs, i);
-        if (1) {
-            json_object *id, *status, *priority, *severity, *assigned_to, *summary;
-            
-            json_object_object_get_ex(bug, "id", &id);
-            sprintf(line, "%d", json_object_get_int(id));
-            if (bugz_search_arguments.show_status) {
-                json_object_object_get_ex(bug, "status", &status);
-                sprintf(line + strlen(line), " %-12s", json_object_get_string(status));
+                               bugz_arena_slist_append(&bugz_arena, bugz_search_arguments.m, optarg)
+
+/* --sort, --group-by and --filter, resolved before the search is sent */
+struct bugz_search_key_t {
+    const struct bugz_field_t *field;  /* NULL for the group count */
+    int desc;
+};
+static struct bugz_search_key_t bugz_search_keys[BUGZ_EXTRACT_FIELDS];
+static int bugz_search_nkeys = 0;
+static const struct bugz_field_t *bugz_search_group = NULL;
+static struct bugz_filter_t *bugz_search_filter = NULL;
+
+static int bugz_search_parse_keys(const char *prog) {
+    struct curl_slist *head;
+    char *name, *save, *spec, error[256];
+
+    bugz_search_nkeys = 0;
+    if (bugz_search_arguments.filter &&
+       (bugz_search_filter = bugz_filter_compile(bugz_search_arguments.filter,
+                                                 error, sizeof(error))) == NULL) {
+        fprintf(stderr, N_("ERROR: %s search: --filter: %s\n"), prog, error);
+        return FALSE;
+    }
+
+    if (bugz_search_arguments.group_by) {
+        name = bugz_search_arguments.group_by;
+        bugz_search_group = bugz_field_lookup(name, strlen(name));
+        if (bugz_search_group == NULL) {
+            fprintf(stderr, N_("ERROR: %s search: unknown field '%s'\n"), prog, name);
+            return FALSE;
+        }
+    }
+    for (head = bugz_search_arguments.sort; head; head = head->next) {
+        spec = bugz_arena_strdup(&bugz_arena, head->data);
+        for (name = strtok_r(spec, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+            struct bugz_search_key_t *key = &bugz_search_keys[bugz_search_nkeys];
+            if (bugz_search_nkeys >= BUGZ_EXTRACT_FIELDS) {
+                fprintf(stderr, N_("ERROR: %s search: too many sort fields\n"), prog);
+                return FALSE;
             }
-            if (bugz_search_arguments.show_priority) {
-                json_object_object_get_ex(bug, "priority", &priority);
-                sprintf(line + strlen(line), " %-12s", json_object_get_string(priority));
+            key->desc = *name == '-';
+            if (*name == '-' || *name == '+')
+                name++;
+            if (strcmp(name, "count") == 0 && bugz_search_arguments.count && bugz_search_group) {
+                key->field = NULL;
             }
-            if (bugz_search_arguments.show_severity) {
-                json_object_object_get_ex(bug, "severity", &severity);
-                sprintf(line + strlen(line), " %-12s", json_object_get_string(severity));
+            else if ((key->field = bugz_field_lookup(name, strlen(name))) == NULL) {
+                fprintf(stderr, N_("ERROR: %s search: unknown field '%s'\n"), prog, name);
+                return FALSE;
             }
-            json_object_object_get_ex(bug, "assigned_to", &assigned_to);
-            json_object_object_get_ex(bug, "summary", &summary);
-            sprintf(line + strlen(line), " %-20s", json_object_get_string(assigned_to));
-            sprintf(line + strlen(line), " %s", json_object_get_string(summary));
-            line[bugz_arguments.columns] = '\0';
-            fprintf(stdout, "%s\n", line);
+            bugz_search_nkeys++;
+        }
+    }
+    if (bugz_arguments.output_format == bugz_output_raw &&
+        (bugz_search_nkeys || bugz_search_group || bugz_search_arguments.count ||
+         bugz_search_filter)) {
+        fprintf(stderr, N_("ERROR: %s search: --sort, --group-by, --count and --filter "
+                           "need another output than raw\n"), prog);
+        return FALSE;
+    }
+    if ((bugz_search_arguments.save || bugz_search_arguments.refresh) &&
+        (bugz_search_nkeys || bugz_search_group || bugz_search_arguments.count ||
+         bugz_search_filter)) {
+        fprintf(stderr, N_("ERROR: %s search: --sort, --group-by, --count and --filter "
+                           "can not be used with --save or --refresh\n"), prog);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* text listing, with a header line in front of every group */
+static void bugz_search_render(struct bugz_sink_t *sink, struct bugz_table_t *table,
+                               int ncolumns, int group) {
+    int i, j, r, c;
+    char line[1024];
+    size_t used, width;
+    const char *s;
+
+    width = bugz_arguments.columns < sizeof(line) ? bugz_arguments.columns : sizeof(line) - 1;
+    for (i=0; i<table->selected; i++) {
+        r = table->order[i];
+        if (group >= 0 && (i == 0 ||
+            bugz_table_cell(table, r, group) != bugz_table_cell(table, table->order[i - 1], group))) {
+            for (j=i+1; j<table->selected &&
+                        bugz_table_cell(table, table->order[j], group) == bugz_table_cell(table, r, group); j++)
+                ;
+            s = bugz_table_string(table, r, group);
+            bugz_sink_printf(sink, "%s%s: %s (%d)\n", i ? "\n" : "",
+                             table->columns[group].field->name, s ? s : "(null)", j - i);
         }
+        used = snprintf(line, sizeof(line), "%d", (int)bugz_table_cell(table, r, 0));
+        for (c=1; c<ncolumns && used < sizeof(line); c++) {
+            s = bugz_table_string(table, r, c);
+            used += snprintf(line + used, sizeof(line) - used, " %-*s",
+                             table->columns[c].field->width, s ? s : "(null)");
+        }
+        line[width] = '\0';
+        bugz_sink_printf(sink, "%s\n", line);
     }
 }
 
+/*
+ * Text listing, and --sort, --group-by, --count or --filter in any output.
+ * The shown fields are collected into a bug table, filtered, sorted and
+ * counted there.
+ */
+static int bugz_search_list_bugs(CURL *curl, const char *url) {
+    int i, n = 0, listed, group = -1;
+    char pattern[512];
+    json_object *json;
+    struct bugz_table_t table;
+    struct bugz_table_key_t keys[BUGZ_EXTRACT_FIELDS + 1], by, *count = NULL;
+    struct bugz_table_group_t *groups = NULL;
+    const struct bugz_field_t *columns[8];
+
+    if (bugz_arguments.output_format == bugz_output_text) {
+        columns[n++] = bugz_field_get(id);
+        if (bugz_search_arguments.show_status)
+            columns[n++] = bugz_field_get(status);
+        if (bugz_search_arguments.show_priority)
+            columns[n++] = bugz_field_get(priority);
+        if (bugz_search_arguments.show_severity)
+            columns[n++] = bugz_field_get(severity);
+        columns[n++] = bugz_field_get(assigned_to);
+        columns[n++] = bugz_field_get(summary);
+        bugz_table_init(&table, columns, n);
+    }
+    else {
+        bugz_table_init(&table, NULL, 0);
+        n = bugz_output_table_columns(&table, bugz_record_bug);
+    }
+    listed = n;
+    /* the rows are ordered by group first, unless only counted */
+    if (bugz_search_group && (group = bugz_table_column(&table, bugz_search_group)) >= 0 &&
+        bugz_search_arguments.count == FALSE) {
+        keys[0].column = group;
+        keys[0].desc = FALSE;
+        for (i=0; i<bugz_search_nkeys; i++) {
+            if (bugz_search_keys[i].field == bugz_search_group)
+                keys[0].desc = bugz_search_keys[i].desc;
+        }
+    }
+    for (i=0, n=(group >= 0 && bugz_search_arguments.count == FALSE); i<bugz_search_nkeys; i++) {
+        if (bugz_search_keys[i].field == NULL) {
+            if (count == NULL) {
+                by.column = -1;
+                by.desc = bugz_search_keys[i].desc;
+                count = &by;
+            }
+            continue;
+        }
+        keys[n].desc = bugz_search_keys[i].desc;
+        if ((keys[n].column = bugz_table_column(&table, bugz_search_keys[i].field)) < 0)
+            break;
+        if (keys[n].column == group && bugz_search_arguments.count && count == NULL) {
+            by = keys[n];
+            count = &by;
+        }
+        n++;
+    }
+    if (i < bugz_search_nkeys || (bugz_search_group && group < 0) ||
+        (bugz_search_filter && bugz_filter_bind(bugz_search_filter, &table) == FALSE)) {
+        fprintf(stderr, N_("ERROR: too many fields to sort, group and filter by\n"));
+        bugz_table_free(&table);
+        return 1;
+    }
+
+    bugz_get_fields(curl, url, bugz_table_pattern(&table, "bugs[*]", pattern, sizeof(pattern)),
+                    bugz_table_add, &table, &json);
+    if (bugz_check_result(json) == FALSE) {
+        bugz_table_free(&table);
+        json_object_put(json);
+        return 1;
+    }
+    bugz_trace_begin("render", "render bugs");
+    if (bugz_search_filter)
+        bugz_filter_apply(bugz_search_filter, &table);
+    if (n > 0 && bugz_search_arguments.count == FALSE)
+        bugz_table_sort(&table, keys, n);
+    if (bugz_search_arguments.count) {
+        i = group >= 0 ? bugz_table_group(&table, group, &groups) : 0;
+        if (group >= 0)
+            bugz_table_sort_groups(&table, group, count, groups, i);
+        bugz_output_groups(&bugz_stdout, &table, group, groups, i);
+        free(groups);
+    }
+    else if (bugz_arguments.output_format == bugz_output_text) {
+        bugz_search_render(&bugz_stdout, &table, listed, group);
+    }
+    else {
+        bugz_output_table(&bugz_stdout, &table, listed);
+    }
+    bugz_trace_end();
+    bugz_sink_flush(&bugz_stdout);
+    if (table.selected <= 0)
+        fprintf(stderr, N_(" * Info: No bugs found.\n"));
+    else
+        fprintf(stderr, N_(" * Info: %d bug(s) found.\n"), table.selected);
+    bugz_table_free(&table);
+    json_object_put(json);
+    return 0;
+}
+
+/* --output other than text, bugs are written while being received */
+static int bugz_search_output(CURL *curl, const char *url) {
+    json_object *json;
+    struct bugz_output_t output = { bugz_record_bug, 0, 0 };
+    int raw = bugz_arguments.output_format == bugz_output_raw;
+
+    bugz_output_header(&bugz_stdout, bugz_record_bug);
+    bugz_get_records(curl, url, raw ? NULL : "bugs", bugz_output_callback, &output, &json);
+    bugz_sink_flush(&bugz_stdout);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        return 1;
+    }
+    if (!raw)
+        fprintf(stderr, N_(" * Info: %d bug(s) found.\n"), output.records);
+    json_object_put(json);
+    return 0;
+}
+
+/*
+ * Saved searches, ~/.bugz/searches/NAME.json holds the criteria, the bugs
+ * of the last run and the latest last_change_time among them. A refresh
+ * only asks for bugs changed since then and merges them in.
+ */
+#define BUGZ_SEARCH_DROP_IDS 100
+
+static char *bugz_search_saved_path(const char *name, int create) {
+    const char *home = getenv("HOME");
+    char *path;
+
+    if (home == NULL || *name == '\0' || *name == '.' || strchr(name, '/')) {
+        fprintf(stderr, N_("ERROR: invalid saved search name '%s'\n"), name);
+        return NULL;
+    }
+    path = bugz_arena_printf(&bugz_arena, "%s/.bugz", home);
+    if (create)
+        mkdir(path, 0700);
+    path = bugz_arena_printf(&bugz_arena, "%s/.bugz/searches", home);
+    if (create)
+        mkdir(path, 0700);
+    return bugz_arena_printf(&bugz_arena, "%s/%s.json", path, name);
+}
+
+json_object *bugz_search_saved_load(const char *name) {
+    json_object *saved, *val;
+    char *path = bugz_search_saved_path(name, FALSE);
+
+    if (path == NULL)
+        return NULL;
+    if ((saved = json_object_from_file(path)) == NULL ||
+        !json_object_object_get_ex(saved, "criteria", &val) ||
+        !json_object_is_type(val, json_type_object)) {
+        fprintf(stderr, N_("ERROR: no saved search '%s' in %s\n"), name, path);
+        json_object_put(saved);
+        return NULL;
+    }
+    return saved;
+}
+
+static int bugz_search_saved_store(const char *name, json_object *saved) {
+    char *path, *tmp;
+
+    if ((path = bugz_search_saved_path(name, TRUE)) == NULL)
+        return FALSE;
+    tmp = bugz_arena_printf(&bugz_arena, "%s.%ld", path, (long)getpid());
+    if (json_object_to_file_ext(tmp, saved, JSON_C_TO_STRING_PLAIN) ||
+        rename(tmp, path)) {
+        fprintf(stderr, N_("ERROR: failed to save search to %s: %s\n"), path, strerror(errno));
+        unlink(tmp);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* the bug columns of each record, by id */
+static int bugz_search_collect(json_object *record, void *userp) {
+    int i;
+    json_object *id, *bug, *val;
+    const char **columns = bugz_output_columns(bugz_record_bug);
+
+    if (!json_object_object_get_ex(record, "id", &id))
+        return 0;
+    bug = json_object_new_object();
+    for (i=0; columns[i]; i++) {
+        if (json_object_object_get_ex(record, columns[i], &val))
+            json_object_object_add(bug, columns[i], json_object_get(val));
+    }
+    json_object_object_add((json_object *)userp, json_object_get_string(id), bug);
+    return 0;
+}
+
+static int bugz_search_collect_id(const struct bugz_value_t *values, void *userp) {
+    if (values[0].data)
+        json_object_array_add((json_object *)userp, json_object_new_int(atoi(values[0].data)));
+    return 0;
+}
+
+static int bugz_search_same(json_object *a, json_object *b) {
+    int i;
+    json_object *x, *y;
+    const char **columns = bugz_output_columns(bugz_record_bug);
+
+    for (i=0; columns[i]; i++) {
+        int hx = json_object_object_get_ex(a, columns[i], &x);
+        int hy = json_object_object_get_ex(b, columns[i], &y);
+        if (hx != hy || (hx && strcmp(json_object_to_json_string(x), json_object_to_json_string(y))))
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static void bugz_search_change(json_object *bug, const char *change) {
+    char line[1024];
+    size_t width;
+    const char *status, *assigned_to, *summary;
+
+    if (bugz_arguments.output_format != bugz_output_text) {
+        json_object_object_add(bug, "change", json_object_new_string(change));
+        bugz_output_record(&bugz_stdout, bugz_record_delta, bug);
+        json_object_object_del(bug, "change");
+        return;
+    }
+    /* a dropped bug may lack any of them */
+    status = bugz_doc_string(bug, "status");
+    assigned_to = bugz_doc_string(bug, "assigned_to");
+    summary = bugz_doc_string(bug, "summary");
+    width = bugz_arguments.columns < sizeof(line) ? bugz_arguments.columns : sizeof(line) - 1;
+    snprintf(line, sizeof(line), "%c %d %-*s %-*s %s",
+             *change == 'n' ? '+' : *change == 'c' ? '~' : '-',
+             bugz_doc_int(bug, "id", 0),
+             bugz_field_get(status)->width, status ? status : "",
+             bugz_field_get(assigned_to)->width, assigned_to ? assigned_to : "",
+             summary ? summary : "");
+    line[width] = '\0';
+    bugz_sink_printf(&bugz_stdout, "%s\n", line);
+}
+
+/* changed since the last run but no longer matching, out of bugs not seen again */
+static int bugz_search_dropped(CURL *curl, const char *base, json_object *auth,
+                               json_object *bugs, json_object *seen, const char *since) {
+    int i, n, dropped = 0;
+    char *url, *q;
+    json_object *query, *ids, *found, *json, *bug;
+
+    ids = json_object_new_array();
+    json_object_object_foreach(bugs, key, val) {
+        (void)val;
+        if (!json_object_object_get_ex(seen, key, NULL))
+            json_object_array_add(ids, json_object_new_int(atoi(key)));
+    }
+    for (i=0; i<(int)json_object_array_length(ids); i+=BUGZ_SEARCH_DROP_IDS) {
+        query = json_object_new_object();
+        json_object_object_add(query, "id", json_object_new_array());
+        for (n=i; n<i+BUGZ_SEARCH_DROP_IDS && n<(int)json_object_array_length(ids); n++)
+            json_object_array_add(json_object_object_get(query, "id"),
+                                  json_object_get(json_object_array_get_idx(ids, n)));
+        json_object_object_add(query, "last_change_time", json_object_new_string(since));
+        json_object_object_add(query, "include_fields", json_object_new_string("id"));
+        json_object_object_foreach(auth, k, v)
+            json_object_object_add(query, k, json_object_get(v));
+        q = bugz_urlencode(query);
+        json_object_put(query);
+        if (q == NULL)
+            break;
+        url = bugz_arena_printf(&bugz_arena, "%s/rest/bug?%s", base, q);
+        free(q);
+        found = json_object_new_array();
+        bugz_get_fields(curl, url, "bugs[*].{id}", bugz_search_collect_id, found, &json);
+        if (bugz_check_result(json) == FALSE) {
+            json_object_put(found);
+            json_object_put(json);
+            json_object_put(ids);
+            return -1;
+        }
+        json_object_put(json);
+        for (n=0; n<(int)json_object_array_length(found); n++) {
+            const char *id = json_object_get_string(json_object_array_get_idx(found, n));
+            if (json_object_object_get_ex(bugs, id, &bug)) {
+                bugz_search_change(bug, "dropped");
+                json_object_object_del(bugs, id);
+                dropped++;
+            }
+        }
+        json_object_put(found);
+    }
+    json_object_put(ids);
+    return dropped;
+}
+
+static int bugz_search_delta(CURL *curl, const char *url, const char *base, json_object *auth,
+                             const char *name, json_object *saved) {
+    int added = 0, changed = 0, dropped = 0;
+    const char *since = NULL, *latest;
+    json_object *bugs, *seen, *json, *old, *val;
+
+    if (!json_object_object_get_ex(saved, "bugs", &bugs) ||
+        !json_object_is_type(bugs, json_type_object)) {
+        bugs = json_object_new_object();
+        json_object_object_add(saved, "bugs", bugs);
+    }
+    if (json_object_object_get_ex(saved, "last_change_time", &val))
+        since = json_object_get_string(val);
+
+    seen = json_object_new_object();
+    bugz_output_header(&bugz_stdout, bugz_record_delta);
+    bugz_get_records(curl, url, "bugs", bugz_search_collect, seen, &json);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(seen);
+        json_object_put(json);
+        return 1;
+    }
+    json_object_put(json);
+
+    bugz_trace_begin("render", "merge saved search");
+    json_object_object_foreach(seen, key, bug) {
+        if (json_object_object_get_ex(bugs, key, &old)) {
+            if (bugz_search_same(old, bug))
+                continue;
+            bugz_search_change(bug, "changed");
+            changed++;
+        }
+        else {
+            bugz_search_change(bug, "new");
+            added++;
+        }
+        json_object_object_add(bugs, key, json_object_get(bug));
+    }
+    if (since && (dropped = bugz_search_dropped(curl, base, auth, bugs, seen, since)) < 0) {
+        bugz_trace_end();
+        json_object_put(seen);
+        return 1;
+    }
+    bugz_trace_end();
+    bugz_sink_flush(&bugz_stdout);
+    json_object_put(seen);
+
+    latest = since;
+    json_object_object_foreach(bugs, k, b) {
+        const char *t = bugz_doc_string(b, "last_change_time");
+        (void)k;
+        if (t && (latest == NULL || strcmp(t, latest) > 0))
+            latest = t;
+    }
+    if (latest)
+        json_object_object_add(saved, "last_change_time", json_object_new_string(latest));
+    if (bugz_search_saved_store(name, saved) == FALSE)
+        return 1;
+    fprintf(stderr, N_(" * Info: %d new, %d changed, %d dropped, %d bug(s) in '%s'.\n"),
+                    added, changed, dropped, json_object_object_length(bugs), name);
+    return 0;
+}
+
 int bugz_search_main(int argc, char **argv) {
     CURL *curl;
     json_object *json;
-    char *url, *base, *username, *password;
-    int opt, longindex, retval;
+    char *url, *base, *username, *password, *name;
+    int i, opt, longindex, retval;
+    json_object *saved = NULL, *auth, *val;
     struct bugz_config_t *config;
     struct curl_slist *headers = NULL;
 
@@ -188,7 +638,7 @@ int bugz_search_main(int argc, char **argv) {
         switch (opt) {
         case -1 :
             bugz_search_arguments.terms = \
-            curl_slist_append(bugz_search_arguments.terms, argv[optind++]);
+            bugz_arena_slist_append(&bugz_arena, bugz_search_arguments.terms, argv[optind++]);
             break;
         case ':' :
         case '?' :
@@ -266,10 +716,44 @@ int bugz_search_main(int argc, char **argv) {
             case opt_search_show_severity :
                 bugz_search_arguments.show_severity = TRUE;
                 break;
+            case opt_search_sort :
+                _append_search_arg_(sort);
+                break;
+            case opt_search_group_by :
+                bugz_search_arguments.group_by = optarg;
+                break;
+            case opt_search_count :
+                bugz_search_arguments.count = TRUE;
+                break;
+            case opt_search_filter :
+                bugz_search_arguments.filter = optarg;
+                break;
+            case opt_search_save :
+                bugz_search_arguments.save = optarg;
+                break;
+            case opt_search_refresh :
+                bugz_search_arguments.refresh = optarg;
+                break;
             }
         }
     }
 
+    if (bugz_search_parse_keys(argv[0]) == FALSE)
+        exit(1);
+    name = bugz_search_arguments.refresh ? bugz_search_arguments.refresh : bugz_search_arguments.save;
+    if (bugz_search_arguments.save && bugz_search_arguments.refresh) {
+        fprintf(stderr, N_("ERROR: %s search: --save and --refresh are exclusive\n"), argv[0]);
+        exit(1);
+    }
+    if (name && bugz_arguments.output_format == bugz_output_raw) {
+        fprintf(stderr, N_("ERROR: %s search: saved searches need another output than raw\n"),
+                        argv[0]);
+        exit(1);
+    }
+    if (bugz_search_arguments.refresh &&
+       (saved = bugz_search_saved_load(bugz_search_arguments.refresh)) == NULL)
+        exit(1);
+
     config = bugz_config();
     base = bugz_get_base(config);
     if (base == NULL) {
@@ -336,28 +820,20 @@ int bugz_search_main(int argc, char **argv) {
             bugz_slist_to_json_array(bugz_search_arguments.status, json_type_string));
     }
     if (bugz_search_arguments.terms) {
-        int i;
-        char *q, *p = NULL;
-        struct curl_slist *head = bugz_search_arguments.terms;
-        while (head) {
+        size_t i = 0;
+        char *q, *p;
+        struct curl_slist *head;
+        for (head = bugz_search_arguments.terms; head; head = head->next)
+            i += strlen(head->data) + 1;
+        p = q = (char *)bugz_arena_alloc(&bugz_arena, i);
+        for (head = bugz_search_arguments.terms; head; head = head->next) {
+            if (head != bugz_search_arguments.terms)
+                *q++ = '\x20';
             i = strlen(head->data);
-            if (p == NULL) {
-                p = (char *)malloc(i+1);
-                memcpy(p, head->data, i);
-                p[i] = '\0';
-            }
-            else {
-                q = (char *)malloc(i+strlen(p)+2);
-                memcpy(q, p, strlen(p));
-                q[strlen(p)] = '\x20';
-                memcpy(q+strlen(p)+1, head->data, i);
-                q[i+strlen(p)+1] = '\0';
-                free(p);
-                p = q;
-            }
-            head = head->next;
+            memcpy(q, head->data, i);
+            q += i;
         }
-        q = p + strlen(p);
+        *q = '\0';
         while (q > p && isspace((unsigned char)(*--q)))
             *p = '\0';
         q = p;
@@ -379,7 +855,17 @@ int bugz_search_main(int argc, char **argv) {
             json_object_object_add(json, "summary",
             json_object_new_string(q));
         }
-        free(p);
+    }
+    if (saved) {
+        /* the criteria saved with the search */
+        json_object_put(json);
+        json_object_object_get_ex(saved, "criteria", &val);
+        json = json_tokener_parse(json_object_to_json_string(val));
+    }
+    else if (name) {
+        saved = json_object_new_object();
+        json_object_object_add(saved, "criteria",
+                               json_tokener_parse(json_object_to_json_string(json)));
     }
     if (json_object_object_length(json) <= 0) {
         fprintf(stderr, N_("Please give search terms or options.\n"));
@@ -392,22 +878,34 @@ int bugz_search_main(int argc, char **argv) {
             fprintf(stderr, " * Info: %-20s = %s\n", key, json_object_get_string(val));
         }
     }
+    if (saved) {
+        /* only what changed since the last run, with the stored fields */
+        const char **columns = bugz_output_columns(bugz_record_bug);
+        char fields[512] = "";
+        if (json_object_object_get_ex(saved, "last_change_time", &val))
+            json_object_object_add(json, "last_change_time", json_object_get(val));
+        for (i=0; columns[i]; i++) {
+            strcat(fields, i ? "," : "");
+            strcat(fields, columns[i]);
+        }
+        json_object_object_add(json, "include_fields", json_object_new_string(fields));
+    }
+    auth = json_object_new_object();
     if (password) {
-        json_object_object_add(json, "login",
+        json_object_object_add(auth, "login",
         json_object_new_string(username));
-        json_object_object_add(json, "password",
+        json_object_object_add(auth, "password",
         json_object_new_string(password));
     }
     else if (username) {
-        json_object_object_add(json, "api_key",
+        json_object_object_add(auth, "api_key",
         json_object_new_string(username));
     }
+    json_object_object_foreach(auth, ak, av)
+        json_object_object_add(json, ak, json_object_get(av));
 
     if ((url = bugz_urlencode(json)) != NULL) {
-        int i = strlen(base) + strlen("/rest/bug?") + strlen(url);
-        char *p = (char *)malloc(i+1);
-        memset(p, 0, i+1);
-        sprintf(p, "%s/rest/bug?%s", base, url);
+        char *p = bugz_arena_printf(&bugz_arena, "%s/rest/bug?%s", base, url);
         free(url);
         url = p;
     }
@@ -421,24 +919,31 @@ int bugz_search_main(int argc, char **argv) {
         fprintf(stderr, N_("ERROR: %s search: curl_easy_init() failed\n"), argv[0]);
         exit(1);
     }
-    headers = curl_slist_append(headers, "charsets: utf-8");
-    headers = curl_slist_append(headers, "Accept: application/json");
-    headers = curl_slist_append(headers, "Content-Type: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "charsets: utf-8");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Accept: application/json");
+    headers = bugz_arena_slist_append(&bugz_arena, headers, "Content-Type: application/json");
     curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
 
-    bugz_get_result(curl, url, &json);
-    if (bugz_check_result(json)) {
-        json_object *bugs;
-        json_object_object_get_ex(json, "bugs", &bugs);
-        if (json_object_array_length(bugs) <= 0)
-            fprintf(stderr, N_(" * Info: No bugs found.\n"));
-        else
-            bugz_search_list_bugs(bugs);
-        json_object_put(json);
-        retval = 0;
+    if (saved) {
+        retval = bugz_search_delta(curl, url, base, auth, name, saved);
+        curl_easy_cleanup(curl);
+        json_object_put(saved);
+        json_object_put(auth);
+        return retval;
+    }
+    json_object_put(auth);
+    if (bugz_arguments.output_format != bugz_output_text && bugz_search_nkeys == 0 &&
+        bugz_search_group == NULL && bugz_search_arguments.count == FALSE &&
+        bugz_search_filter == NULL) {
+        retval = bugz_search_output(curl, url);
+        curl_easy_cleanup(curl);
+        return retval;
     }
-    free(url);
+
+    retval = bugz_search_list_bugs(curl, url);
     curl_easy_cleanup(curl);
+    bugz_filter_free(bugz_search_filter);
+    bugz_search_filter = NULL;
 
     return retval;
 }
@@ -0,0 +1,379 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz.h"
+
+/*
+ * Columnar bug table for search results, one array of 32-bit cells per
+ * field. Status, priority, assignee and other values shared by many bugs
+ * are interned once in a table wide symbol pool, summaries and times are
+ * appended to a per-column text heap. Sorting and grouping work on the
+ * order array of selected rows, never on the cells themselves.
+ *
+ */
+#define BUGZ_TABLE_ROWS 256
+#define BUGZ_TABLE_TEXT (16 * 1024)
+
+static void *bugz_table_realloc(void *p, size_t size) {
+    if ((p = realloc(p, size)) == NULL) {
+        fprintf(stderr, "ERROR: expand table in bugz_table_realloc failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+static int bugz_table_kind(const struct bugz_field_t *field) {
+    switch (field - bugz_fields) {
+    case bugz_field_id :
+    case bugz_field_dupe_of :
+        return bugz_table_int;
+    case bugz_field_summary :
+    case bugz_field_whiteboard :
+    case bugz_field_url :
+    case bugz_field_deadline :
+    case bugz_field_creation_time :
+    case bugz_field_last_change_time :
+        return bugz_table_text;
+    default :
+        return bugz_table_symbol;
+    }
+}
+
+void bugz_table_init(struct bugz_table_t *t, const struct bugz_field_t **fields, int n) {
+    int c;
+    memset(t, 0, sizeof(*t));
+    for (c=0; c<n; c++)
+        bugz_table_column(t, fields[c]);
+}
+
+/* index of the column holding field, added while the table is empty */
+int bugz_table_column(struct bugz_table_t *t, const struct bugz_field_t *field) {
+    int c;
+    for (c=0; c<t->ncolumns; c++) {
+        if (t->columns[c].field == field)
+            return c;
+    }
+    if (t->rows || t->ncolumns >= BUGZ_EXTRACT_FIELDS)
+        return -1;
+    t->columns[c].field = field;
+    t->columns[c].kind = bugz_table_kind(field);
+    t->ncolumns++;
+    return c;
+}
+
+/* bugz_get_fields() pattern for the columns of the table */
+char *bugz_table_pattern(struct bugz_table_t *t, const char *path, char *buf, size_t size) {
+    int c;
+    size_t used = snprintf(buf, size, "%s.{", path);
+    for (c=0; c<t->ncolumns && used < size; c++)
+        used += snprintf(buf + used, size - used, "%s%s", c ? "," : "", t->columns[c].field->name);
+    if (used < size)
+        snprintf(buf + used, size - used, "}");
+    return buf;
+}
+
+static uint32_t bugz_table_intern(struct bugz_table_t *t, const char *s, size_t len) {
+    uint32_t i, id, mask;
+    uint32_t hash = jenkins_one_at_a_time_hash(s, len);
+
+    if (t->nsymbols * 2 >= t->nslots) {
+        /* keep the load under one half */
+        uint32_t nslots = t->nslots ? t->nslots * 2 : 64;
+        uint32_t *slots = (uint32_t *)calloc(nslots, sizeof(uint32_t));
+        if (slots == NULL) {
+            fprintf(stderr, "ERROR: expand symbols in bugz_table_intern failed\n");
+            exit(1);
+        }
+        for (id=0; id<t->nsymbols; id++) {
+            const char *p = t->symbols + t->offsets[id];
+            i = jenkins_one_at_a_time_hash(p, strlen(p)) & (nslots - 1);
+            while (slots[i])
+                i = (i + 1) & (nslots - 1);
+            slots[i] = id + 1;
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->nslots = nslots;
+        t->offsets = (uint32_t *)bugz_table_realloc(t->offsets, nslots / 2 * sizeof(uint32_t));
+    }
+    mask = t->nslots - 1;
+    for (i = hash & mask; t->slots[i]; i = (i + 1) & mask) {
+        const char *p = t->symbols + t->offsets[t->slots[i] - 1];
+        if (strncmp(p, s, len) == 0 && p[len] == '\0')
+            return t->slots[i] - 1;
+    }
+    if (t->used + len + 1 > t->capacity) {
+        while (t->used + len + 1 > t->capacity)
+            t->capacity = t->capacity ? t->capacity * 2 : BUGZ_TABLE_TEXT;
+        t->symbols = (char *)bugz_table_realloc(t->symbols, t->capacity);
+    }
+    memcpy(t->symbols + t->used, s, len);
+    t->symbols[t->used + len] = '\0';
+    t->offsets[t->nsymbols] = (uint32_t)t->used;
+    t->used += len + 1;
+    t->slots[i] = t->nsymbols + 1;
+    return t->nsymbols++;
+}
+
+static uint32_t bugz_table_text_append(struct bugz_table_column_t *col, const char *s, size_t len) {
+    uint32_t offset = (uint32_t)col->used;
+    if (col->used + len + 1 > col->size) {
+        while (col->used + len + 1 > col->size)
+            col->size = col->size ? col->size * 2 : BUGZ_TABLE_TEXT;
+        col->text = (char *)bugz_table_realloc(col->text, col->size);
+    }
+    memcpy(col->text + col->used, s, len);
+    col->text[col->used + len] = '\0';
+    col->used += len + 1;
+    return offset;
+}
+
+/* bugz_value_callback_t, values are in column order */
+int bugz_table_add(const struct bugz_value_t *values, void *userp) {
+    int c;
+    struct bugz_table_t *t = (struct bugz_table_t *)userp;
+
+    if (t->rows == t->size) {
+        t->size = t->size ? t->size * 2 : BUGZ_TABLE_ROWS;
+        for (c=0; c<t->ncolumns; c++)
+            t->columns[c].cells = (uint32_t *)bugz_table_realloc(t->columns[c].cells,
+                                                                 t->size * sizeof(uint32_t));
+        t->order = (int *)bugz_table_realloc(t->order, t->size * sizeof(int));
+    }
+    for (c=0; c<t->ncolumns; c++) {
+        struct bugz_table_column_t *col = &t->columns[c];
+        const struct bugz_value_t *val = &values[c];
+        uint32_t cell = BUGZ_TABLE_NULL;
+        if (val->data && val->type != json_type_null) {
+            switch (col->kind) {
+            case bugz_table_int :
+                cell = (uint32_t)atoi(val->data);
+                break;
+            case bugz_table_symbol :
+                cell = bugz_table_intern(t, val->data, val->len);
+                break;
+            default :
+                cell = bugz_table_text_append(col, val->data, val->len);
+            }
+        }
+        else if (col->kind == bugz_table_int) {
+            cell = 0;
+        }
+        col->cells[t->rows] = cell;
+    }
+    t->order[t->selected++] = t->rows++;
+    return 0;
+}
+
+/* cell as a string, the int columns go through a static buffer */
+const char *bugz_table_string(const struct bugz_table_t *t, int row, int col) {
+    static char buf[16];
+    const struct bugz_table_column_t *column = &t->columns[col];
+    uint32_t cell = column->cells[row];
+
+    switch (column->kind) {
+    case bugz_table_int :
+        snprintf(buf, sizeof(buf), "%d", (int)cell);
+        return buf;
+    case bugz_table_symbol :
+        return cell == BUGZ_TABLE_NULL ? NULL : t->symbols + t->offsets[cell];
+    default :
+        return cell == BUGZ_TABLE_NULL ? NULL : column->text + cell;
+    }
+}
+
+/*
+ * Sorting, interned values compare by the rank of their symbol so the
+ * strings are only compared once per distinct value
+ */
+static struct {
+    const struct bugz_table_t *t;
+    const struct bugz_table_key_t *keys;
+    int nkeys;
+    uint32_t *ranks;
+} bugz_table_sorting;
+
+static int bugz_table_symbol_cmp(const void *a, const void *b) {
+    const struct bugz_table_t *t = bugz_table_sorting.t;
+    return strcmp(t->symbols + t->offsets[*(const uint32_t *)a],
+                  t->symbols + t->offsets[*(const uint32_t *)b]);
+}
+
+static uint32_t *bugz_table_ranks(const struct bugz_table_t *t) {
+    uint32_t i, *ids, *ranks;
+
+    ids = (uint32_t *)bugz_table_realloc(NULL, (t->nsymbols + 1) * sizeof(uint32_t));
+    ranks = (uint32_t *)bugz_table_realloc(NULL, (t->nsymbols + 1) * sizeof(uint32_t));
+    for (i=0; i<t->nsymbols; i++)
+        ids[i] = i;
+    bugz_table_sorting.t = t;
+    qsort(ids, t->nsymbols, sizeof(uint32_t), bugz_table_symbol_cmp);
+    for (i=0; i<t->nsymbols; i++)
+        ranks[ids[i]] = i;
+    free(ids);
+    return ranks;
+}
+
+/* null values first */
+static int bugz_table_cmp_key(const struct bugz_table_key_t *key, int a, int b) {
+    int r;
+    const struct bugz_table_t *t = bugz_table_sorting.t;
+    const struct bugz_table_column_t *col = &t->columns[key->column];
+    uint32_t x = col->cells[a], y = col->cells[b];
+
+    if (x == y)
+        return 0;
+    switch (col->kind) {
+    case bugz_table_int :
+        r = (int)x < (int)y ? -1 : 1;
+        break;
+    case bugz_table_symbol :
+        r = x == BUGZ_TABLE_NULL ? -1 : y == BUGZ_TABLE_NULL ? 1 :
+            bugz_table_sorting.ranks[x] < bugz_table_sorting.ranks[y] ? -1 : 1;
+        break;
+    default :
+        r = x == BUGZ_TABLE_NULL ? -1 : y == BUGZ_TABLE_NULL ? 1 :
+            strcmp(col->text + x, col->text + y);
+    }
+    return key->desc ? -r : r;
+}
+
+static int bugz_table_cmp_rows(const void *a, const void *b) {
+    int i, r, x = *(const int *)a, y = *(const int *)b;
+    for (i=0; i<bugz_table_sorting.nkeys; i++) {
+        if ((r = bugz_table_cmp_key(&bugz_table_sorting.keys[i], x, y)) != 0)
+            return r;
+    }
+    return x - y; /* stable */
+}
+
+void bugz_table_sort(struct bugz_table_t *t, const struct bugz_table_key_t *keys, int nkeys) {
+    bugz_table_sorting.t = t;
+    bugz_table_sorting.keys = keys;
+    bugz_table_sorting.nkeys = nkeys;
+    bugz_table_sorting.ranks = bugz_table_ranks(t);
+    qsort(t->order, t->selected, sizeof(int), bugz_table_cmp_rows);
+    free(bugz_table_sorting.ranks);
+    bugz_table_sorting.ranks = NULL;
+}
+
+static uint32_t bugz_table_hash(const struct bugz_table_column_t *col, uint32_t cell) {
+    if (cell == BUGZ_TABLE_NULL)
+        return 0;
+    if (col->kind == bugz_table_text)
+        return jenkins_one_at_a_time_hash(col->text + cell, strlen(col->text + cell));
+    return cell * 0x9e3779b1U;
+}
+
+static int bugz_table_equal(const struct bugz_table_column_t *col, uint32_t x, uint32_t y) {
+    if (x == y)
+        return TRUE;
+    if (col->kind != bugz_table_text || x == BUGZ_TABLE_NULL || y == BUGZ_TABLE_NULL)
+        return FALSE;
+    return strcmp(col->text + x, col->text + y) == 0;
+}
+
+/*
+ * Count the selected rows per value of col, in order of first appearance.
+ * Interned values index a flat array by symbol, the other kinds go through
+ * an open addressing table of group numbers.
+ */
+int bugz_table_group(const struct bugz_table_t *t, int col, struct bugz_table_group_t **groupsp) {
+    int i, n = 0, size = 0;
+    int *slots;
+    uint32_t nslots, mask, h;
+    struct bugz_table_group_t *groups = NULL;
+    const struct bugz_table_column_t *column = &t->columns[col];
+
+    if (column->kind == bugz_table_symbol)
+        nslots = t->nsymbols + 1;
+    else
+        for (nslots = 256; nslots < (uint32_t)t->selected * 2; nslots *= 2)
+            ;
+    mask = nslots - 1;
+    slots = (int *)calloc(nslots, sizeof(int));
+    if (slots == NULL) {
+        fprintf(stderr, "ERROR: allocate slots in bugz_table_group failed\n");
+        exit(1);
+    }
+    for (i=0; i<t->selected; i++) {
+        int row = t->order[i];
+        uint32_t cell = column->cells[row];
+        if (column->kind == bugz_table_symbol) {
+            h = cell == BUGZ_TABLE_NULL ? t->nsymbols : cell;
+        }
+        else {
+            for (h = bugz_table_hash(column, cell) & mask; slots[h]; h = (h + 1) & mask) {
+                if (bugz_table_equal(column, column->cells[groups[slots[h] - 1].row], cell))
+                    break;
+            }
+        }
+        if (slots[h] == 0) {
+            if (n == size) {
+                size = size ? size * 2 : 64;
+                groups = (struct bugz_table_group_t *)bugz_table_realloc(groups, size * sizeof(*groups));
+            }
+            groups[n].row = row;
+            groups[n].count = 0;
+            slots[h] = ++n;
+        }
+        groups[slots[h] - 1].count++;
+    }
+    free(slots);
+    *groupsp = groups;
+    return n;
+}
+
+static struct bugz_table_key_t bugz_table_group_key;
+
+static int bugz_table_cmp_groups(const void *a, const void *b) {
+    int r;
+    const struct bugz_table_group_t *x = (const struct bugz_table_group_t *)a;
+    const struct bugz_table_group_t *y = (const struct bugz_table_group_t *)b;
+    const struct bugz_table_key_t *key = bugz_table_sorting.keys;
+
+    if (key->column < 0 && x->count != y->count)
+        return (x->count < y->count) == !key->desc ? -1 : 1;
+    if ((r = bugz_table_cmp_key(&bugz_table_group_key, x->row, y->row)) != 0)
+        return key->column < 0 ? r : key->desc ? -r : r;
+    return x->row - y->row;
+}
+
+/* by count or by value of the group column, largest groups first by default */
+void bugz_table_sort_groups(const struct bugz_table_t *t, int col, const struct bugz_table_key_t *key,
+                            struct bugz_table_group_t *groups, int n) {
+    static const struct bugz_table_key_t by_count = { -1, TRUE };
+
+    bugz_table_group_key.column = col;
+    bugz_table_group_key.desc = FALSE;
+    bugz_table_sorting.t = t;
+    bugz_table_sorting.keys = key ? key : &by_count;
+    bugz_table_sorting.ranks = bugz_table_ranks(t);
+    qsort(groups, n, sizeof(*groups), bugz_table_cmp_groups);
+    free(bugz_table_sorting.ranks);
+    bugz_table_sorting.ranks = NULL;
+}
+
+void bugz_table_free(struct bugz_table_t *t) {
+    int c;
+    for (c=0; c<t->ncolumns; c++) {
+        free(t->columns[c].cells);
+        free(t->columns[c].text);
+    }
+    free(t->symbols);
+    free(t->offsets);
+    free(t->slots);
+    free(t->order);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,616 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz.h"
+
+#include <sys/mman.h>
+
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*
+ * Streamed attachment upload, the request body is the JSON written so
+ * far (up to the opening quote of the last member), the base64 of the
+ * file, compressed or not, and the closing '"}'.
+ *
+ * The upload is a pipeline around a bounded queue of blocks, in file order:
+ *
+ *  - a producer thread reads the file, faulting in the mapped pages
+ *    ahead of the encoders, or compresses it, and cuts it into blocks
+ *    of a multiple of 3 bytes, so that each is base64 encoded on its own,
+ *  - worker threads encode the blocks, any of them in any order,
+ *  - the curl read callback sends the encoded blocks in order, and
+ *    encodes the first block itself if no worker has taken it yet.
+ *
+ * Without threads the read callback does all of it, one block at a
+ * time. Uncompressed, the size of the body is known up front, the
+ * compressed size is not and the body is sent chunked.
+ *
+ */
+#define BUGZ_UPLOAD_BLOCK (768 * 1024)      /* multiple of 3 */
+#define BUGZ_UPLOAD_BLOCKS 16               /* blocks queued */
+#define BUGZ_UPLOAD_INPUT (1024 * 1024)     /* input compressed at a time */
+#define BUGZ_UPLOAD_WORKERS 8
+#define BUGZ_UPLOAD_PAGE 4096
+
+static const struct {
+    const char *name;
+    const char *suffix;
+    const char *content_type;
+    int available;
+} bugz_compress_methods[] = {
+    [bugz_compress_none] = { "none", "",     NULL, TRUE },
+#ifdef HAVE_ZLIB
+    [bugz_compress_gzip] = { "gzip", ".gz",  "application/gzip", TRUE },
+#else
+    [bugz_compress_gzip] = { "gzip", ".gz",  "application/gzip", FALSE },
+#endif
+#ifdef HAVE_ZSTD
+    [bugz_compress_zstd] = { "zstd", ".zst", "application/zstd", TRUE },
+#else
+    [bugz_compress_zstd] = { "zstd", ".zst", "application/zstd", FALSE },
+#endif
+};
+
+/* -1 if unknown, see bugz_compress_available() for the build */
+int bugz_compress_lookup(const char *name) {
+    int i;
+    for (i=0; i<(int)(sizeof(bugz_compress_methods) / sizeof(bugz_compress_methods[0])); i++) {
+        if (strcmp(name, bugz_compress_methods[i].name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int bugz_compress_available(int method) {
+    return bugz_compress_methods[method].available;
+}
+
+const char *bugz_compress_suffix(int method) {
+    return bugz_compress_methods[method].suffix;
+}
+
+const char *bugz_compress_content_type(int method) {
+    return bugz_compress_methods[method].content_type;
+}
+
+struct bugz_upload_block_t {
+    struct bugz_upload_block_t *next;
+    const unsigned char *data;  /* the input, or buffer when compressed */
+    size_t len;
+    char *text;                 /* base64 of data */
+    size_t tlen;
+    int state;                  /* 0 queued, 1 encoding, 2 encoded */
+    unsigned char buffer[];
+};
+
+struct bugz_upload_t {
+    struct bugz_json_t *head;
+    const struct bugz_input_t *in;
+    int method;
+    size_t consumed;    /* input read or compressed */
+    size_t packed;      /* compressed bytes */
+    struct bugz_upload_block_t *open;   /* being compressed into */
+
+    /* queue, shared by all the threads */
+    struct bugz_upload_block_t *first;
+    struct bugz_upload_block_t *last;
+    struct bugz_upload_block_t *todo;   /* first block not taken by an encoder */
+    int queued;
+    int done;
+    int error;
+    int quit;
+#ifdef HAVE_PTHREAD
+    pthread_t producer;
+    pthread_t workers[BUGZ_UPLOAD_WORKERS];
+    int nworkers;
+    int producing;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int started;
+#endif
+#ifdef HAVE_ZLIB
+    z_stream z;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_CCtx *zstd;
+#endif
+
+    /* read callback */
+    int stage;          /* 0 head, 1 data, 2 tail, 3 end */
+    size_t sent;
+    struct bugz_upload_block_t *block;
+};
+
+static void bugz_upload_lock(struct bugz_upload_t *up) {
+#ifdef HAVE_PTHREAD
+    if (up->started)
+        pthread_mutex_lock(&up->lock);
+#endif
+}
+
+static void bugz_upload_unlock(struct bugz_upload_t *up) {
+#ifdef HAVE_PTHREAD
+    if (up->started) {
+        pthread_cond_broadcast(&up->cond);
+        pthread_mutex_unlock(&up->lock);
+    }
+#endif
+}
+
+#ifdef HAVE_PTHREAD
+static void bugz_upload_wait(struct bugz_upload_t *up) {
+    pthread_cond_wait(&up->cond, &up->lock);
+}
+#endif
+
+static void bugz_upload_block_free(struct bugz_upload_block_t *block) {
+    if (block) {
+        free(block->text);
+        free(block);
+    }
+}
+
+/* producer side, FALSE once the sender gave up */
+static int bugz_upload_push(struct bugz_upload_t *up, struct bugz_upload_block_t *block) {
+    if (block->len == 0) {
+        free(block);
+        return TRUE;
+    }
+    bugz_upload_lock(up);
+#ifdef HAVE_PTHREAD
+    while (up->producing && up->queued >= BUGZ_UPLOAD_BLOCKS && !up->quit)
+        bugz_upload_wait(up);
+#endif
+    if (up->quit) {
+        bugz_upload_unlock(up);
+        free(block);
+        return FALSE;
+    }
+    if (up->last)
+        up->last->next = block;
+    else
+        up->first = block;
+    up->last = block;
+    if (up->todo == NULL)
+        up->todo = block;
+    up->queued++;
+    bugz_upload_unlock(up);
+    return TRUE;
+}
+
+static struct bugz_upload_block_t *bugz_upload_block_new(int compressed) {
+    struct bugz_upload_block_t *block;
+
+    block = (struct bugz_upload_block_t *)calloc(1, sizeof(*block) + (compressed ? BUGZ_UPLOAD_BLOCK : 0));
+    if (block && compressed)
+        block->data = block->buffer;
+    return block;
+}
+
+/* the compressed data goes into up->open, queued whenever it is full */
+static int bugz_upload_deflate(struct bugz_upload_t *up, const unsigned char *src, size_t n, int end) {
+    int full;
+
+    if (up->open == NULL && (up->open = bugz_upload_block_new(TRUE)) == NULL)
+        return FALSE;
+    switch (up->method) {
+#ifdef HAVE_ZLIB
+    case bugz_compress_gzip :
+        up->z.next_in = (Bytef *)src;
+        up->z.avail_in = (uInt)n;
+        do {
+            up->z.next_out = up->open->buffer + up->open->len;
+            up->z.avail_out = (uInt)(BUGZ_UPLOAD_BLOCK - up->open->len);
+            if (deflate(&up->z, end ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR)
+                return FALSE;
+            up->packed += BUGZ_UPLOAD_BLOCK - up->open->len - up->z.avail_out;
+            up->open->len = BUGZ_UPLOAD_BLOCK - up->z.avail_out;
+            if ((full = up->z.avail_out == 0)) {
+                if (bugz_upload_push(up, up->open) == FALSE) {
+                    up->open = NULL;
+                    return FALSE;
+                }
+                if ((up->open = bugz_upload_block_new(TRUE)) == NULL)
+                    return FALSE;
+            }
+        } while (full);
+        break;
+#endif
+#ifdef HAVE_ZSTD
+    case bugz_compress_zstd : {
+        size_t left;
+        ZSTD_inBuffer input = { src, n, 0 };
+        do {
+            ZSTD_outBuffer output = { up->open->buffer, BUGZ_UPLOAD_BLOCK, up->open->len };
+            left = ZSTD_compressStream2(up->zstd, &output, &input, end ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(left))
+                return FALSE;
+            up->packed += output.pos - up->open->len;
+            up->open->len = output.pos;
+            if (output.pos == BUGZ_UPLOAD_BLOCK) {
+                if (bugz_upload_push(up, up->open) == FALSE) {
+                    up->open = NULL;
+                    return FALSE;
+                }
+                if ((up->open = bugz_upload_block_new(TRUE)) == NULL)
+                    return FALSE;
+            }
+        } while (end ? left != 0 : input.pos < input.size);
+        break;
+    }
+#endif
+    default :
+        return FALSE;
+    }
+    if (end) {
+        full = bugz_upload_push(up, up->open);
+        up->open = NULL;
+        return full;
+    }
+    return TRUE;
+}
+
+/* reads or compresses the next block of input, FALSE on failure */
+static int bugz_upload_step(struct bugz_upload_t *up) {
+    size_t i, n = up->in->len - up->consumed;
+    const unsigned char *src = (const unsigned char *)up->in->data + up->consumed;
+    struct bugz_upload_block_t *block;
+    volatile unsigned char touch;
+    int end, retval;
+
+    if (up->method == bugz_compress_none) {
+        if (n > BUGZ_UPLOAD_BLOCK)
+            n = BUGZ_UPLOAD_BLOCK;
+        /* the page faults here rather than in the encoders */
+        if (up->in->mapped) {
+            for (i=0; i<n; i+=BUGZ_UPLOAD_PAGE)
+                touch = src[i];
+            (void)touch;
+        }
+        if ((block = bugz_upload_block_new(FALSE)) != NULL) {
+            block->data = src;
+            block->len = n;
+        }
+        retval = block && bugz_upload_push(up, block);
+    }
+    else {
+        if (n > BUGZ_UPLOAD_INPUT)
+            n = BUGZ_UPLOAD_INPUT;
+        retval = bugz_upload_deflate(up, src, n, up->consumed + n == up->in->len);
+    }
+    up->consumed += n;
+    end = up->consumed == up->in->len;
+    if (retval == FALSE || end) {
+        bugz_upload_lock(up);
+        if (retval == FALSE && !up->quit) /* not if the sender gave up */
+            up->error = TRUE;
+        up->done = TRUE;
+        bugz_upload_unlock(up);
+    }
+    return retval && !end;
+}
+
+static int bugz_upload_encode(struct bugz_upload_block_t *block) {
+    if ((block->text = (char *)malloc((block->len + 2) / 3 * 4)) == NULL)
+        return FALSE;
+    block->tlen = bugz_base64_encode_block(block->data, block->len, block->text);
+    return TRUE;
+}
+
+#ifdef HAVE_PTHREAD
+static void *bugz_upload_producer(void *arg) {
+    struct bugz_upload_t *up = (struct bugz_upload_t *)arg;
+    while (bugz_upload_step(up))
+        ;
+    return NULL;
+}
+
+static void *bugz_upload_worker(void *arg) {
+    struct bugz_upload_t *up = (struct bugz_upload_t *)arg;
+    struct bugz_upload_block_t *block;
+    int ok;
+
+    pthread_mutex_lock(&up->lock);
+    for (;;) {
+        while (up->todo == NULL && !up->done && !up->quit)
+            bugz_upload_wait(up);
+        if (up->todo == NULL || up->quit)
+            break;
+        block = up->todo;
+        up->todo = block->next;
+        block->state = 1;
+        pthread_mutex_unlock(&up->lock);
+        ok = bugz_upload_encode(block);
+        pthread_mutex_lock(&up->lock);
+        block->state = 2;
+        if (!ok)
+            up->error = TRUE;
+        pthread_cond_broadcast(&up->cond);
+    }
+    pthread_mutex_unlock(&up->lock);
+    return NULL;
+}
+#endif
+
+/* sender side, next encoded block or NULL at the end */
+static struct bugz_upload_block_t *bugz_upload_pop(struct bugz_upload_t *up) {
+    struct bugz_upload_block_t *block;
+    int ok;
+
+    bugz_upload_lock(up);
+    while (!up->error) {
+        if ((block = up->first) == NULL) {
+            if (up->done)
+                break;
+#ifdef HAVE_PTHREAD
+            if (up->producing) {
+                bugz_upload_wait(up);
+                continue;
+            }
+#endif
+            bugz_upload_unlock(up);
+            bugz_upload_step(up);
+            bugz_upload_lock(up);
+            continue;
+        }
+        if (block->state == 2)
+            break;
+        if (block->state == 1) {
+#ifdef HAVE_PTHREAD
+            bugz_upload_wait(up);
+#endif
+            continue;
+        }
+        /* nobody encoding the block the sender needs, do it here */
+        up->todo = block->next;
+        block->state = 1;
+        bugz_upload_unlock(up);
+        ok = bugz_upload_encode(block);
+        bugz_upload_lock(up);
+        block->state = 2;
+        if (!ok)
+            up->error = TRUE;
+    }
+    block = NULL;
+    if (!up->error && up->first && up->first->state == 2) {
+        block = up->first;
+        up->first = block->next;
+        if (up->first == NULL)
+            up->last = NULL;
+        up->queued--;
+    }
+    bugz_upload_unlock(up);
+    return block;
+}
+
+static size_t bugz_upload_read(char *buffer, size_t size, size_t nitems, void *userp) {
+    struct bugz_upload_t *up = (struct bugz_upload_t *)userp;
+    size_t n, room = size * nitems, used = 0;
+
+    if (up->stage == 0) {
+        used = up->head->used - up->sent < room ? up->head->used - up->sent : room;
+        memcpy(buffer, up->head->data + up->sent, used);
+        up->sent += used;
+        if (up->sent == up->head->used) {
+            up->stage = 1;
+            up->sent = 0;
+        }
+        return used;
+    }
+    while (up->stage == 1 && used < room) {
+        if (up->block == NULL || up->sent == up->block->tlen) {
+            bugz_upload_block_free(up->block);
+            up->sent = 0;
+            if ((up->block = bugz_upload_pop(up)) == NULL) {
+                if (up->error)
+                    return CURL_READFUNC_ABORT;
+                up->stage = 2;
+                break;
+            }
+        }
+        n = up->block->tlen - up->sent < room - used ? up->block->tlen - up->sent : room - used;
+        memcpy(buffer + used, up->block->text + up->sent, n);
+        up->sent += n;
+        used += n;
+    }
+    while (up->stage == 2 && used < room) {
+        buffer[used++] = "\"}"[up->sent++];
+        if (up->sent == 2)
+            up->stage = 3;
+    }
+    return used;
+}
+
+/*
+ * head is the request body so far, ending with the opening quote of the
+ * member holding the data (bugz_json_string_begin()), in must stay
+ * valid until bugz_upload_free(). NULL if method is not available.
+ */
+struct bugz_upload_t *bugz_upload_new(struct bugz_json_t *head, const struct bugz_input_t *in,
+                                      int method) {
+    struct bugz_upload_t *up;
+
+    if (!bugz_compress_available(method))
+        return NULL;
+    if ((up = (struct bugz_upload_t *)calloc(1, sizeof(*up))) == NULL)
+        return NULL;
+    up->head = head;
+    up->in = in;
+    up->method = method;
+    up->done = in->len == 0 && method == bugz_compress_none;
+#ifdef HAVE_ZLIB
+    /* 15 + 16, gzip header instead of zlib */
+    if (method == bugz_compress_gzip &&
+        deflateInit2(&up->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        free(up);
+        return NULL;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    if (method == bugz_compress_zstd) {
+        if ((up->zstd = ZSTD_createCCtx()) == NULL) {
+            free(up);
+            return NULL;
+        }
+        ZSTD_CCtx_setParameter(up->zstd, ZSTD_c_compressionLevel, 3);
+        ZSTD_CCtx_setPledgedSrcSize(up->zstd, in->len);
+    }
+#endif
+    if (in->mapped && method == bugz_compress_none)
+        madvise((void *)in->data, in->len, MADV_WILLNEED);
+    return up;
+}
+
+#ifdef HAVE_PTHREAD
+static void bugz_upload_start(struct bugz_upload_t *up) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (up->done)
+        return;
+    if (up->started == FALSE) {
+        pthread_mutex_init(&up->lock, NULL);
+        pthread_cond_init(&up->cond, NULL);
+        up->started = TRUE;
+    }
+    /* the sender and the producer have a core each, the encoders share the rest */
+    cpus = cpus > 2 ? cpus - 2 : 1;
+    if (cpus > BUGZ_UPLOAD_WORKERS)
+        cpus = BUGZ_UPLOAD_WORKERS;
+    if ((size_t)cpus > up->in->len / BUGZ_UPLOAD_BLOCK)
+        cpus = (long)(up->in->len / BUGZ_UPLOAD_BLOCK);
+    pthread_mutex_lock(&up->lock);
+    up->producing = pthread_create(&up->producer, NULL, bugz_upload_producer, up) == 0;
+    while (up->nworkers < cpus &&
+           pthread_create(&up->workers[up->nworkers], NULL, bugz_upload_worker, up) == 0)
+        up->nworkers++;
+    pthread_mutex_unlock(&up->lock);
+}
+#endif
+
+/* stops the threads and drops what is queued */
+static void bugz_upload_stop(struct bugz_upload_t *up) {
+    struct bugz_upload_block_t *block;
+
+    bugz_upload_lock(up);
+    up->quit = TRUE;
+    bugz_upload_unlock(up);
+#ifdef HAVE_PTHREAD
+    if (up->started) {
+        int i;
+        if (up->producing)
+            pthread_join(up->producer, NULL);
+        for (i=0; i<up->nworkers; i++)
+            pthread_join(up->workers[i], NULL);
+        up->producing = FALSE;
+        up->nworkers = 0;
+    }
+#endif
+    while ((block = up->first) != NULL) {
+        up->first = block->next;
+        bugz_upload_block_free(block);
+    }
+    up->last = up->todo = NULL;
+    up->queued = 0;
+    bugz_upload_block_free(up->block);
+    up->block = NULL;
+    free(up->open);
+    up->open = NULL;
+}
+
+/*
+ * curl rewinds the body to send it again, after a redirect or for
+ * authentication, the pipeline restarts from the beginning of the file
+ */
+static int bugz_upload_seek(void *userp, curl_off_t offset, int origin) {
+    struct bugz_upload_t *up = (struct bugz_upload_t *)userp;
+
+    if (offset != 0 || origin != SEEK_SET)
+        return CURL_SEEKFUNC_CANTSEEK;
+    if (up->stage == 0 && up->sent == 0)
+        return CURL_SEEKFUNC_OK; /* nothing sent yet */
+    bugz_upload_stop(up);
+#ifdef HAVE_ZLIB
+    if (up->method == bugz_compress_gzip && deflateReset(&up->z) != Z_OK)
+        return CURL_SEEKFUNC_FAIL;
+#endif
+#ifdef HAVE_ZSTD
+    if (up->method == bugz_compress_zstd) {
+        if (ZSTD_isError(ZSTD_CCtx_reset(up->zstd, ZSTD_reset_session_only)))
+            return CURL_SEEKFUNC_FAIL;
+        ZSTD_CCtx_setPledgedSrcSize(up->zstd, up->in->len);
+    }
+#endif
+    up->consumed = up->packed = 0;
+    up->done = up->in->len == 0 && up->method == bugz_compress_none;
+    up->error = up->quit = FALSE; /* nothing is running, a fresh start */
+    up->stage = 0;
+    up->sent = 0;
+#ifdef HAVE_PTHREAD
+    bugz_upload_start(up);
+#endif
+    return CURL_SEEKFUNC_OK;
+}
+
+/* body of the next request, starts the threads */
+void bugz_upload_setopt(CURL *curl, struct bugz_upload_t *up) {
+    curl_off_t size = -1;
+
+    /* uncompressed, the size is known */
+    if (up->method == bugz_compress_none)
+        size = (curl_off_t)(up->head->used + (up->in->len + 2) / 3 * 4 + 2);
+    curl_easy_setopt(curl, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, size);
+    curl_easy_setopt(curl, CURLOPT_READFUNCTION, bugz_upload_read);
+    curl_easy_setopt(curl, CURLOPT_READDATA, up);
+    curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, bugz_upload_seek);
+    curl_easy_setopt(curl, CURLOPT_SEEKDATA, up);
+#ifdef HAVE_PTHREAD
+    if (up->started == FALSE)
+        bugz_upload_start(up);
+#endif
+}
+
+/* FALSE if reading or compressing failed, packed is the compressed size */
+int bugz_upload_free(struct bugz_upload_t *up, size_t *packed) {
+    int retval;
+
+    bugz_upload_stop(up);
+#ifdef HAVE_PTHREAD
+    if (up->started) {
+        pthread_cond_destroy(&up->cond);
+        pthread_mutex_destroy(&up->lock);
+    }
+#endif
+#ifdef HAVE_ZLIB
+    if (up->method == bugz_compress_gzip)
+        deflateEnd(&up->z);
+#endif
+#ifdef HAVE_ZSTD
+    if (up->method == bugz_compress_zstd)
+        ZSTD_freeCCtx(up->zstd);
+#endif
+    retval = !up->error;
+    if (packed)
+        *packed = up->method == bugz_compress_none ? up->in->len : up->packed;
+    free(up);
+    return retval;
+}
@@ -18,6 +18,10 @@
 
 #include "bugz.h"
 
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+
 /* 
  * configuration files for pybugz, see
  * https://github.com/williamh/pybugz/blob/master/man/pybugz.d.5
@@ -296,6 +300,7 @@ struct bugz_config_t *bugz_config(void) {
     glob_t *files;
     struct bugz_config_t *config = NULL;
 
+    bugz_trace_begin("config", "config load");
     files = bugz_glob_conf();
     if (files) {
         int i;
@@ -311,6 +316,7 @@ struct bugz_config_t *bugz_config(void) {
         config = bugz_config_load(config, bugz_arguments.config_file);
     if (config)
         bugz_update_debug_and_columns(config);
+    bugz_trace_end();
 
     return config;
 }
@@ -572,20 +578,18 @@ struct bugz_parsed_url_t *bugz_urlparse(const char *url) {
 struct bugz_fetch_t {
     char *payload;
     size_t size;
+    int failed;  /* out of memory, the payload is incomplete */
 };
 
 static json_object *bugz_fetch_to_json(struct bugz_fetch_t *fetch) {
     json_object *json;
-    enum json_tokener_error err;
 
     if (fetch == NULL)
         return NULL;
-    json = json_tokener_parse_verbose(fetch->payload, &err);
-    if (err != json_tokener_success) {
+    bugz_trace_begin("json", "parse");
+    if (bugz_parse_json(fetch->payload, fetch->size, &json) == FALSE)
         fprintf(stderr, N_("ERROR: failed to parse json string\n"));
-        json_object_put(json);
-        return NULL;
-    }
+    bugz_trace_end();
     return json;
 }
 
@@ -611,48 +615,218 @@ struct bugz_trace_t {
     char trace_ascii; /* 0 or 1*/
 };
 
-static void debug_dump(const char *text, FILE *fp, unsigned char *ptr, size_t size, char nohex) {
+/*
+ * Debug dump (--debug 2/3), lines are formatted with lookup tables into
+ * a large buffer instead of one fprintf(3) per byte. A full buffer is
+ * handed to a writer thread (when built with pthreads) and filling goes
+ * on in the other one, so dumping hardly slows down the transfer. The
+ * buffer is flushed when a request is done and at exit.
+ */
+#define BUGZ_DEBUG_SIZE (1024 * 1024)
+
+static struct bugz_debug_t {
+    char *data[2];
+    size_t used;
+    int current;
+    char hex[256][2];
+    char ascii[256];
+#ifdef HAVE_PTHREAD
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const char *pending;
+    size_t pending_len;
+    int started;
+    int quit;
+#endif
+} *bugz_debug = NULL;
+
+#ifdef HAVE_PTHREAD
+static void *bugz_debug_writer(void *arg) {
+    struct bugz_debug_t *d = (struct bugz_debug_t *)arg;
+    pthread_mutex_lock(&d->lock);
+    for (;;) {
+        while (d->pending == NULL && !d->quit)
+            pthread_cond_wait(&d->cond, &d->lock);
+        if (d->pending == NULL)
+            break;
+        pthread_mutex_unlock(&d->lock);
+        fwrite(d->pending, 1, d->pending_len, stderr);
+        fflush(stderr);
+        pthread_mutex_lock(&d->lock);
+        d->pending = NULL;
+        pthread_cond_broadcast(&d->cond);
+    }
+    pthread_mutex_unlock(&d->lock);
+    return NULL;
+}
+#endif
+
+/* hand the current buffer over, wait for the writer if wait is set */
+static void bugz_debug_rotate(struct bugz_debug_t *d, int wait) {
+#ifdef HAVE_PTHREAD
+    if (d->started) {
+        pthread_mutex_lock(&d->lock);
+        while (d->pending)
+            pthread_cond_wait(&d->cond, &d->lock);
+        if (d->used) {
+            d->pending = d->data[d->current];
+            d->pending_len = d->used;
+            d->current ^= 1;
+            d->used = 0;
+            pthread_cond_broadcast(&d->cond);
+        }
+        while (wait && d->pending)
+            pthread_cond_wait(&d->cond, &d->lock);
+        pthread_mutex_unlock(&d->lock);
+        return;
+    }
+#endif
+    (void)wait;
+    fwrite(d->data[d->current], 1, d->used, stderr);
+    fflush(stderr);
+    d->used = 0;
+}
+
+static void bugz_debug_flush(void) {
+    if (bugz_debug && bugz_debug->used)
+        bugz_debug_rotate(bugz_debug, TRUE);
+}
+
+static void bugz_debug_atexit(void) {
+    struct bugz_debug_t *d = bugz_debug;
+    bugz_debug_flush();
+#ifdef HAVE_PTHREAD
+    if (d->started) {
+        pthread_mutex_lock(&d->lock);
+        d->quit = 1;
+        pthread_cond_broadcast(&d->cond);
+        pthread_mutex_unlock(&d->lock);
+        pthread_join(d->thread, NULL);
+    }
+#endif
+    (void)d;
+}
+
+static struct bugz_debug_t *bugz_debug_init(void) {
+    static const char digits[] = "0123456789abcdef";
+    struct bugz_debug_t *d;
+    int c;
+
+    if (bugz_debug)
+        return bugz_debug;
+    if ((d = (struct bugz_debug_t *)calloc(1, sizeof(*d))) == NULL)
+        return NULL;
+    if ((d->data[0] = (char *)malloc(2 * BUGZ_DEBUG_SIZE)) == NULL) {
+        free(d);
+        return NULL;
+    }
+    d->data[1] = d->data[0] + BUGZ_DEBUG_SIZE;
+    for (c=0; c<256; c++) {
+        d->hex[c][0] = digits[c >> 4];
+        d->hex[c][1] = digits[c & 0x0f];
+        d->ascii[c] = (c >= 0x20) && (c < 0x80) ? c : '.';
+    }
+#ifdef HAVE_PTHREAD
+    pthread_mutex_init(&d->lock, NULL);
+    pthread_cond_init(&d->cond, NULL);
+    d->started = pthread_create(&d->thread, NULL, bugz_debug_writer, d) == 0;
+#endif
+    bugz_debug = d;
+    atexit(bugz_debug_atexit);
+    return d;
+}
+
+/* make room for n bytes, n is always far below BUGZ_DEBUG_SIZE */
+static inline char *bugz_debug_reserve(struct bugz_debug_t *d, size_t n) {
+    if (d->used + n > BUGZ_DEBUG_SIZE)
+        bugz_debug_rotate(d, FALSE);
+    return d->data[d->current] + d->used;
+}
+
+static void bugz_debug_write(struct bugz_debug_t *d, const char *s, size_t len) {
+    while (len > 0) {
+        size_t n = len < 4096 ? len : 4096;
+        memcpy(bugz_debug_reserve(d, n), s, n);
+        d->used += n;
+        s += n;
+        len -= n;
+    }
+}
+
+/* " * Debug: %4.4lx: " */
+static void bugz_debug_offset(struct bugz_debug_t *d, size_t offset) {
+    char *p = bugz_debug_reserve(d, 32), *q;
+    int n = 4;
+    while (n < 16 && (offset >> (4 * n)))
+        n++;
+    memcpy(p, " * Debug: ", 10);
+    for (q = p + 10 + n; q > p + 10; offset >>= 4)
+        *--q = d->hex[offset & 0x0f][1];
+    p[10 + n] = ':';
+    p[11 + n] = '\x20';
+    d->used += 12 + n;
+}
+
+static inline void bugz_debug_hex(struct bugz_debug_t *d, unsigned char c) {
+    char *p = bugz_debug_reserve(d, 2);
+    p[0] = d->hex[c][0];
+    p[1] = d->hex[c][1];
+    d->used += 2;
+}
+
+static inline void bugz_debug_char(struct bugz_debug_t *d, char c) {
+    *bugz_debug_reserve(d, 1) = c;
+    d->used++;
+}
+
+static void debug_dump(const char *text, struct bugz_debug_t *d, unsigned char *ptr, size_t size, char nohex) {
     size_t i, c;
+    char line[128];
     unsigned int width=bugz_arguments.columns/2;
     if (nohex)
         width=bugz_arguments.columns;
-    fprintf(fp, " * Debug: %s, %10.10ld bytes (0x%8.8lx)\n", text, 
-           (long)size, (long)size);
+    c = snprintf(line, sizeof(line), " * Debug: %s, %10.10ld bytes (0x%8.8lx)\n", text,
+                 (long)size, (long)size);
+    bugz_debug_write(d, line, c < sizeof(line) ? c : sizeof(line) - 1);
     for(i=0; i<size; i+= width) {
         if (!nohex) {
-            fprintf(fp, " * Debug: %4.4lx: ", (long)i);
+            bugz_debug_offset(d, i);
             for (c=0; c<width; c++)
                 if (i+c < size)
-                    fprintf(fp, "%02x", ptr[i+c]);
+                    bugz_debug_hex(d, ptr[i+c]);
                 else
-                    fputs("\x20\x20", fp);
-            fputc('\n', fp);
+                    bugz_debug_write(d, "\x20\x20", 2);
+            bugz_debug_char(d, '\n');
         }
-        fprintf(fp, " * Debug: %4.4lx: ", (long)i);
+        bugz_debug_offset(d, i);
         for (c=0; (c<width)&&(i+c<size); c++) {
             if (nohex && (i+c+1 < size) && ptr[i+c]==0x0D && ptr[i+c+1]==0x0A) {
                 i+=(c+2-width);
                 break;
             }
-            fprintf(fp, "%c", (ptr[i+c]>=0x20) && (ptr[i+c]<0x80)?ptr[i+c]:'.');
+            bugz_debug_char(d, d->ascii[ptr[i+c]]);
             if (nohex && (i+c+2 < size) && ptr[i+c+1]==0x0D && ptr[i+c+2]==0x0A) {
                 i+=(c+3-width);
                 break;
             }
         }
-        fputc('\n', fp);
+        bugz_debug_char(d, '\n');
     }
-    fflush(fp);
 }
 
 static int debug_trace(CURL *curl, curl_infotype type, char *data, size_t size, void *userp) {
     struct bugz_trace_t *config = (struct bugz_trace_t *)userp;
+    struct bugz_debug_t *d;
     const char *text;
     (void)curl; /* prevent compiler warning */
 
+    if ((d = bugz_debug_init()) == NULL)
+        return 0;
     switch (type) {
     case CURLINFO_TEXT :
-        fprintf(stderr, " * Debug: %s", data);
+        bugz_debug_write(d, " * Debug: ", 10);
+        bugz_debug_write(d, data, size);
     default: /* in case a new one is introduced to shock us */
         return 0;
     case CURLINFO_HEADER_OUT :
@@ -675,22 +849,17 @@ static int debug_trace(CURL *curl, curl_infotype type, char *data, size_t size,
         break;
     }
 
-    debug_dump(text, stderr, (unsigned char *)data, size, config->trace_ascii);
+    debug_dump(text, d, (unsigned char *)data, size, config->trace_ascii);
     return 0;
 }
 
-static CURLcode bugz_get_fetch(CURL *curl, const char *url, struct bugz_fetch_t *fetch) {
-    CURLcode rcode;
-    struct bugz_trace_t debug_config;
-
-    if (fetch->payload)
-        free(fetch->payload);
-    fetch->payload = 0;
-    fetch->size = 0;
+static void bugz_get_setopt(CURL *curl, const char *url,
+                            size_t (*callback)(void *, size_t, size_t, void *), void *userp) {
+    static struct bugz_trace_t debug_config;
 
     curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, bugz_curl_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)fetch);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, userp);
     curl_easy_setopt(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 300);
     curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
@@ -702,11 +871,27 @@ static CURLcode bugz_get_fetch(CURL *curl, const char *url, struct bugz_fetch_t
         curl_easy_setopt(curl, CURLOPT_DEBUGDATA, &debug_config);
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 1L);
     }
+}
 
+static CURLcode bugz_get_perform(CURL *curl, const char *url,
+                                 size_t (*callback)(void *, size_t, size_t, void *), void *userp) {
+    CURLcode rcode;
+    bugz_get_setopt(curl, url, callback, userp);
     rcode = curl_easy_perform(curl);
+    bugz_debug_flush();
+    bugz_metrics_record(curl, rcode);
     return rcode;
 }
 
+static CURLcode bugz_get_fetch(CURL *curl, const char *url, struct bugz_fetch_t *fetch) {
+    if (fetch->payload)
+        free(fetch->payload);
+    fetch->payload = 0;
+    fetch->size = 0;
+
+    return bugz_get_perform(curl, url, bugz_curl_callback, (void *)fetch);
+}
+
 CURLcode bugz_get_result(CURL *curl, const char *url, json_object **jsonp) {
     CURLcode rcode;
     json_object *json = NULL;
@@ -724,6 +909,908 @@ CURLcode bugz_get_result(CURL *curl, const char *url, json_object **jsonp) {
     return rcode;
 }
 
+/*
+ * Incremental JSON tokenizer shared by bugz_get_records() and
+ * bugz_get_fields(). Bytes are fed as they are received and the
+ * consumer is told where values start and end, as offsets into the
+ * chunk being fed, so that it copies the spans it wants. Keys are
+ * collected into scan->key, a string value is unescaped and handed to
+ * text() only if the consumer sets decode when the value starts.
+ *
+ * A path component is a member name, '*' for any member or element,
+ * or "[N]" for element N of an array, e.g. "bugs.*.comments" or
+ * "ids[0]". The level of a container is the number of components
+ * matched by it, -1 if none.
+ */
+#define BUGZ_SCAN_DEPTH 64
+
+enum {
+    bugz_scan_value,        /* value starting at i, returns the level if it is a container */
+    bugz_scan_comma,        /* ',' at i */
+    bugz_scan_close,        /* '}' or ']' at i, already popped */
+    bugz_scan_scalar_end,   /* number or literal ending before i */
+    bugz_scan_string_end    /* closing quote of a string value at i */
+};
+
+struct bugz_scan_frame_t {
+    char type;  /* '{' or '[' */
+    char level;
+    long index; /* of the current element of an array */
+};
+
+struct bugz_scan_t {
+    char pattern[512];
+    char *components[16];
+    long indexes[16];   /* array index of a component, -1 for a name or '*' */
+    int ncomponents;
+
+    struct bugz_scan_frame_t stack[BUGZ_SCAN_DEPTH];
+    int depth;
+    int expect_key;
+    int in_string;
+    int in_scalar;
+    int escape;
+    int string_is_key;
+    int decode;         /* set by the consumer at bugz_scan_value */
+    int decoding;
+    int unicode;        /* hex digits of a \u escape still to come */
+    unsigned int codepoint;
+    unsigned int surrogate;
+    char key[128];
+    size_t keylen;
+    int stop;
+
+    int (*event)(struct bugz_scan_t *scan, int event, size_t i, char c);
+    void (*text)(struct bugz_scan_t *scan, const char *data, size_t len);
+};
+
+/* splits pattern into components, returns the "{...}" that may end it */
+static char *bugz_scan_path(struct bugz_scan_t *scan, const char *pattern) {
+    char *p, *q;
+
+    strncpy(scan->pattern, pattern, sizeof(scan->pattern) / 2 - 1); /* '[' is split in place */
+    for (p = scan->pattern; *p && scan->ncomponents < 16; p = q) {
+        if (*p == '.') {
+            q = p + 1;
+            continue;
+        }
+        if (*p == '{')
+            return p;
+        if (*p == '[') {
+            q = p + 1 + strcspn(p + 1, "]");
+            if (*q)
+                *q++ = '\0';
+            p++;
+        }
+        else {
+            q = p + strcspn(p, ".[");
+            if (*q == '.')
+                *q++ = '\0';
+            else if (*q == '[') {
+                memmove(q + 1, q, strlen(q) + 1); /* room for the terminator */
+                *q++ = '\0';
+            }
+        }
+        scan->components[scan->ncomponents] = p;
+        scan->indexes[scan->ncomponents] = *p && strspn(p, "0123456789") == strlen(p) ? atol(p) : -1;
+        scan->ncomponents++;
+    }
+    return NULL;
+}
+
+/* innermost open container, NULL at the top or too deep */
+static struct bugz_scan_frame_t *bugz_scan_top(struct bugz_scan_t *scan) {
+    if (scan->depth == 0 || scan->depth > BUGZ_SCAN_DEPTH)
+        return NULL;
+    return &scan->stack[scan->depth - 1];
+}
+
+/* level of a value starting in the innermost open container */
+static int bugz_scan_level(struct bugz_scan_t *scan) {
+    struct bugz_scan_frame_t *top = bugz_scan_top(scan);
+    const char *c;
+
+    if (scan->depth == 0)
+        return 0;
+    if (top == NULL || top->level < 0 || top->level >= scan->ncomponents)
+        return -1;
+    c = scan->components[(int)top->level];
+    if (strcmp(c, "*") == 0)
+        return top->level + 1;
+    if (top->type == '{')
+        return strcmp(c, scan->key) == 0 ? top->level + 1 : -1;
+    return top->index == scan->indexes[(int)top->level] ? top->level + 1 : -1;
+}
+
+static void bugz_scan_push(struct bugz_scan_t *scan, char type, int level) {
+    if (scan->depth < BUGZ_SCAN_DEPTH) {
+        scan->stack[scan->depth].type = type;
+        scan->stack[scan->depth].level = level;
+        scan->stack[scan->depth].index = 0;
+    }
+    scan->depth++;
+    scan->expect_key = type == '{';
+}
+
+static void bugz_scan_utf8(struct bugz_scan_t *scan, unsigned int cp) {
+    char u[4];
+    size_t n;
+    if (cp < 0x80)
+        u[0] = cp, n = 1;
+    else if (cp < 0x800)
+        u[0] = 0xc0 | (cp >> 6), u[1] = 0x80 | (cp & 0x3f), n = 2;
+    else if (cp < 0x10000)
+        u[0] = 0xe0 | (cp >> 12), u[1] = 0x80 | ((cp >> 6) & 0x3f),
+        u[2] = 0x80 | (cp & 0x3f), n = 3;
+    else
+        u[0] = 0xf0 | (cp >> 18), u[1] = 0x80 | ((cp >> 12) & 0x3f),
+        u[2] = 0x80 | ((cp >> 6) & 0x3f), u[3] = 0x80 | (cp & 0x3f), n = 4;
+    scan->text(scan, u, n);
+}
+
+/* a high surrogate not followed by a low one */
+static void bugz_scan_lone(struct bugz_scan_t *scan) {
+    if (scan->surrogate)
+        bugz_scan_utf8(scan, 0xfffd);
+    scan->surrogate = 0;
+}
+
+static void bugz_scan_escape(struct bugz_scan_t *scan, char c) {
+    unsigned int cp;
+    if (scan->unicode) {
+        scan->codepoint = (scan->codepoint << 4) | (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        if (--scan->unicode)
+            return;
+        cp = scan->codepoint & 0xffff;
+        if (cp >= 0xd800 && cp < 0xdc00) { /* high surrogate, wait for the low one */
+            bugz_scan_lone(scan);
+            scan->surrogate = cp;
+            return;
+        }
+        if (cp >= 0xdc00 && cp < 0xe000) {
+            if (scan->surrogate)
+                cp = 0x10000 + ((scan->surrogate - 0xd800) << 10) + (cp - 0xdc00);
+            else
+                cp = 0xfffd;
+            scan->surrogate = 0;
+        }
+        bugz_scan_lone(scan);
+        bugz_scan_utf8(scan, cp);
+        return;
+    }
+    if (c != 'u')
+        bugz_scan_lone(scan);
+    switch (c) {
+    case 'b' : c = '\b'; break;
+    case 'f' : c = '\f'; break;
+    case 'n' : c = '\n'; break;
+    case 'r' : c = '\r'; break;
+    case 't' : c = '\t'; break;
+    case 'u' :
+        scan->unicode = 4;
+        scan->codepoint = 0;
+        return;
+    }
+    scan->text(scan, &c, 1);
+}
+
+#define bugz_scan_delimiter(c) ((c) == ',' || (c) == ']' || (c) == '}' || \
+                                (c) == ' ' || (c) == '\t' || (c) == '\r' || (c) == '\n')
+
+static void bugz_scan_feed(struct bugz_scan_t *scan, const char *p, size_t len) {
+    struct bugz_scan_frame_t *top;
+    size_t i, j;
+    int level;
+
+    for (i=0; i<len && !scan->stop; i++) {
+        char c = p[i];
+        if (scan->in_string) {
+            if (scan->escape || scan->unicode) {
+                if (scan->decoding)
+                    bugz_scan_escape(scan, c);
+                else if (scan->unicode)
+                    scan->unicode--;
+                else if (c == 'u')
+                    scan->unicode = 4;
+                scan->escape = FALSE;
+                continue;
+            }
+            for (j=i; j<len && p[j] != '"' && p[j] != '\\'; j++)
+                ;
+            if (scan->decoding && j > i) {
+                bugz_scan_lone(scan);
+                scan->text(scan, p + i, j - i);
+            }
+            else if (scan->string_is_key) {
+                size_t n = j - i;
+                if (n > sizeof(scan->key) - 1 - scan->keylen)
+                    n = sizeof(scan->key) - 1 - scan->keylen;
+                memcpy(scan->key + scan->keylen, p + i, n);
+                scan->keylen += n;
+                scan->key[scan->keylen] = '\0';
+            }
+            if ((i = j) == len)
+                break;
+            if (p[i] == '\\')
+                scan->escape = TRUE;
+            else {
+                scan->in_string = FALSE;
+                if (scan->decoding)
+                    bugz_scan_lone(scan);
+                scan->decoding = FALSE;
+                if (!scan->string_is_key)
+                    scan->event(scan, bugz_scan_string_end, i, c);
+            }
+            continue;
+        }
+        if (scan->in_scalar) {
+            if (!bugz_scan_delimiter(c))
+                continue;
+            scan->in_scalar = FALSE;
+            scan->event(scan, bugz_scan_scalar_end, i, c);
+        }
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            continue;
+        if (c == '"' && scan->expect_key) {
+            scan->in_string = TRUE;
+            scan->string_is_key = TRUE;
+            scan->keylen = 0;
+            scan->key[0] = '\0';
+            continue;
+        }
+        if (c == ':') {
+            scan->expect_key = FALSE;
+            continue;
+        }
+        if (c == ',') {
+            if ((top = bugz_scan_top(scan)) != NULL) {
+                scan->expect_key = top->type == '{';
+                top->index++;
+                scan->event(scan, bugz_scan_comma, i, c);
+            }
+            continue;
+        }
+        if (c == '}' || c == ']') {
+            if (scan->depth > 0)
+                scan->depth--;
+            scan->expect_key = FALSE;
+            scan->event(scan, bugz_scan_close, i, c);
+            continue;
+        }
+        /* start of a value */
+        level = scan->event(scan, bugz_scan_value, i, c);
+        if (c == '{' || c == '[')
+            bugz_scan_push(scan, c, level);
+        else if (c == '"') {
+            scan->in_string = TRUE;
+            scan->string_is_key = FALSE;
+            scan->decoding = scan->decode;
+            scan->decode = FALSE;
+        }
+        else { /* rest of a number or literal */
+            scan->in_scalar = TRUE;
+            while (i + 1 < len && !bugz_scan_delimiter(p[i + 1]))
+                i++;
+        }
+    }
+}
+
+/* sets buf->failed rather than dropping bytes, the writers then abort */
+static void bugz_stream_append(struct bugz_fetch_t *buf, size_t *alloc, const char *data, size_t len) {
+    if (buf->failed)
+        return;
+    if (buf->size + len + 1 > *alloc) {
+        size_t n = *alloc ? *alloc : 4096;
+        char *t;
+        while (n < buf->size + len + 1)
+            n *= 2;
+        if ((t = (char *)realloc(buf->payload, n)) == NULL) {
+            fprintf(stderr, "ERROR: expand payload in bugz_stream_append failed\n");
+            buf->failed = TRUE;
+            return;
+        }
+        buf->payload = t;
+        *alloc = n;
+    }
+    memcpy(buf->payload + buf->size, data, len);
+    buf->size += len;
+    buf->payload[buf->size] = '\0';
+}
+
+/*
+ * Record streaming, splits the elements of the array found at path
+ * (e.g. "bugs.*.comments") out of the response while it is being
+ * received, each element is parsed on its own and handed to the
+ * callback. Everything else is kept as a skeleton document so that
+ * errors can still be checked with bugz_check_result().
+ *
+ * If the value found at path is not an array it is the only record.
+ */
+#define BUGZ_STREAM_RAW_SKELETON (64 * 1024)
+
+struct bugz_stream_t {
+    struct bugz_scan_t scan;    /* first, the events get it */
+    bugz_record_callback_t callback;
+    void *userp;
+    struct bugz_sink_t *raw;
+    const char *chunk;          /* being fed */
+    size_t start;               /* of the bytes not copied yet */
+
+    int capturing;
+    int capture_depth;
+    int capture_scalar;
+    int records;
+    int aborted;
+
+    struct bugz_fetch_t skeleton;
+    struct bugz_fetch_t record;
+    size_t skeleton_alloc;
+    size_t record_alloc;
+};
+
+static void bugz_stream_skeleton(struct bugz_stream_t *stream, const char *data, size_t len) {
+    if (stream->raw && stream->skeleton.size + len > BUGZ_STREAM_RAW_SKELETON) {
+        stream->skeleton.size = BUGZ_STREAM_RAW_SKELETON; /* only kept for errors */
+        return;
+    }
+    bugz_stream_append(&stream->skeleton, &stream->skeleton_alloc, data, len);
+}
+
+/* the record ends before end in the current chunk */
+static void bugz_stream_emit(struct bugz_stream_t *stream, size_t end) {
+    json_object *record;
+    int ok;
+
+    bugz_stream_append(&stream->record, &stream->record_alloc,
+                       stream->chunk + stream->start, end - stream->start);
+    stream->start = end;
+    stream->capturing = FALSE;
+    if (stream->record.failed) {
+        stream->aborted = stream->scan.stop = TRUE;
+        return;
+    }
+    ok = bugz_parse_json(stream->record.payload, stream->record.size, &record);
+    stream->record.size = 0;
+    if (ok == FALSE) {
+        fprintf(stderr, N_("ERROR: failed to parse json string\n"));
+        stream->aborted = stream->scan.stop = TRUE;
+        return;
+    }
+    stream->records++;
+    if (stream->callback(record, stream->userp))
+        stream->aborted = stream->scan.stop = TRUE;
+    json_object_put(record);
+}
+
+static int bugz_stream_event(struct bugz_scan_t *scan, int event, size_t i, char c) {
+    struct bugz_stream_t *stream = (struct bugz_stream_t *)scan;
+    struct bugz_scan_frame_t *top = bugz_scan_top(scan);
+    int level, in_records = top && top->type == '[' && top->level == scan->ncomponents;
+
+    switch (event) {
+    case bugz_scan_value :
+        if (stream->capturing)
+            return -1;
+        level = bugz_scan_level(scan);
+        if (in_records || (level == scan->ncomponents && c != '[')) {
+            bugz_stream_skeleton(stream, stream->chunk + stream->start, i - stream->start);
+            if (!in_records)
+                bugz_stream_skeleton(stream, "null", 4);
+            stream->start = i;
+            stream->capturing = TRUE;
+            stream->capture_depth = scan->depth;
+            stream->capture_scalar = c != '{' && c != '[';
+        }
+        return level;
+    case bugz_scan_comma :
+        if (!stream->capturing && in_records) {
+            bugz_stream_skeleton(stream, stream->chunk + stream->start, i - stream->start);
+            stream->start = i + 1; /* drop separators of streamed records */
+        }
+        break;
+    case bugz_scan_close :
+        if (stream->capturing && !stream->capture_scalar && scan->depth == stream->capture_depth)
+            bugz_stream_emit(stream, i + 1);
+        break;
+    case bugz_scan_scalar_end :
+    case bugz_scan_string_end :
+        if (stream->capturing && stream->capture_scalar && scan->depth == stream->capture_depth)
+            bugz_stream_emit(stream, event == bugz_scan_string_end ? i + 1 : i);
+        break;
+    }
+    return -1;
+}
+
+static size_t bugz_stream_callback(void *data, size_t size, size_t nmemb, void *userp) {
+    struct bugz_stream_t *stream = (struct bugz_stream_t *)userp;
+    const char *p = (const char *)data;
+    size_t len = size * nmemb;
+    int records = stream->records;
+
+    if (stream->raw) {
+        bugz_sink_write(stream->raw, p, len);
+        bugz_stream_skeleton(stream, p, len);
+        return stream->skeleton.failed ? 0 : len;
+    }
+
+    stream->chunk = p;
+    stream->start = 0;
+    bugz_scan_feed(&stream->scan, p, len);
+    if (stream->aborted)
+        return 0;
+    if (stream->capturing)
+        bugz_stream_append(&stream->record, &stream->record_alloc, p + stream->start, len - stream->start);
+    else
+        bugz_stream_skeleton(stream, p + stream->start, len - stream->start);
+    if (stream->skeleton.failed || stream->record.failed) {
+        stream->aborted = TRUE;
+        return 0;
+    }
+    if (stream->records != records)
+        bugz_sink_flush(&bugz_stdout); /* let consumers start on what we have */
+    return len;
+}
+
+CURLcode bugz_get_records(CURL *curl, const char *url, const char *path,
+                          bugz_record_callback_t callback, void *userp, json_object **jsonp) {
+    CURLcode rcode;
+    json_object *json = NULL;
+    struct bugz_stream_t *stream;
+
+    *jsonp = NULL;
+    if ((stream = (struct bugz_stream_t *)calloc(1, sizeof(struct bugz_stream_t))) == NULL)
+        return CURLE_OUT_OF_MEMORY;
+    stream->callback = callback;
+    stream->userp = userp;
+    stream->scan.event = bugz_stream_event;
+    if (path == NULL)
+        stream->raw = &bugz_stdout;
+    else
+        bugz_scan_path(&stream->scan, path);
+
+    bugz_trace_begin("render", "stream records");
+    rcode = bugz_get_perform(curl, url, bugz_stream_callback, (void *)stream);
+    bugz_trace_end();
+    if (stream->raw) {
+        long code = 0;
+        bugz_sink_flush(stream->raw);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        if (rcode != CURLE_OK)
+            fprintf(stderr, N_("ERROR: %s\n"), curl_easy_strerror(rcode));
+        else if (stream->skeleton.size >= BUGZ_STREAM_RAW_SKELETON)
+            json = code < 400 ? json_object_new_object() : NULL; /* too large to be an error */
+        else if (stream->skeleton.size > 0)
+            json = bugz_fetch_to_json(&stream->skeleton);
+    }
+    else if (stream->aborted && rcode == CURLE_WRITE_ERROR)
+        fprintf(stderr, N_("ERROR: aborted after %d record(s)\n"), stream->records);
+    else if (rcode != CURLE_OK || stream->skeleton.size < 1)
+        fprintf(stderr, N_("ERROR: %s\n"), curl_easy_strerror(rcode));
+    else
+        json = bugz_fetch_to_json(&stream->skeleton);
+
+    free(stream->skeleton.payload);
+    free(stream->record.payload);
+    free(stream);
+    *jsonp = json;
+
+    return rcode;
+}
+
+/*
+ * Event driven extraction of a few fields out of a response, pattern
+ * is a path as in bugz_get_records() where "name[*]" or "name[N]"
+ * selects the elements of an array, optionally followed by the members
+ * wanted out of each matched object, e.g. "bugs[*].{id,summary,status}".
+ * Fields are collected into a compact bugz_value_t array as bytes
+ * arrive, no json-c document is built for them. Everything outside the
+ * matches is kept as a skeleton so that bugz_check_result() still works.
+ */
+struct bugz_extract_t {
+    struct bugz_scan_t scan;    /* first, the events get it */
+    char *fields[BUGZ_EXTRACT_FIELDS];
+    int nfields;       /* 0 when the matched value itself is wanted */
+    bugz_value_callback_t callback;
+    int (*text_callback)(const char *data, size_t len, void *userp); /* string values, not kept */
+    void *userp;
+    const char *chunk; /* being fed */
+    size_t start;      /* of the bytes not copied yet */
+
+    int record_depth;  /* depth inside the matched object, 0 if none */
+    int capture;       /* 's'tring, 'n'umber or literal, 'c'ontainer, 0 if none */
+    int capture_depth;
+    int field;
+    size_t offsets[BUGZ_EXTRACT_FIELDS];
+    struct bugz_value_t values[BUGZ_EXTRACT_FIELDS];
+    int records;
+    int aborted;
+
+    struct bugz_fetch_t skeleton;
+    struct bugz_fetch_t record;
+    size_t skeleton_alloc;
+    size_t record_alloc;
+};
+
+static int bugz_extract_event(struct bugz_scan_t *scan, int event, size_t i, char c);
+static void bugz_extract_text(struct bugz_scan_t *scan, const char *data, size_t len);
+
+struct bugz_extract_t *bugz_extract_new(const char *pattern, bugz_value_callback_t callback,
+                                        void *userp) {
+    char *p, *q;
+    struct bugz_extract_t *x;
+
+    if ((x = (struct bugz_extract_t *)calloc(1, sizeof(struct bugz_extract_t))) == NULL)
+        return NULL;
+    x->callback = callback;
+    x->userp = userp;
+    x->scan.event = bugz_extract_event;
+    x->scan.text = bugz_extract_text;
+    if ((p = bugz_scan_path(&x->scan, pattern)) != NULL) { /* members, always last */
+        for (q = strtok(p + 1, ",}"); q && x->nfields < BUGZ_EXTRACT_FIELDS; q = strtok(NULL, ",}"))
+            x->fields[x->nfields++] = q;
+    }
+    return x;
+}
+
+/* elements of the innermost array are all matched and left out of the skeleton */
+static int bugz_extract_in_records(struct bugz_extract_t *x) {
+    struct bugz_scan_frame_t *top = bugz_scan_top(&x->scan);
+    if (top == NULL || top->type != '[')
+        return FALSE;
+    return top->level == x->scan.ncomponents - 1 && strcmp(x->scan.components[(int)top->level], "*") == 0;
+}
+
+static void bugz_extract_begin(struct bugz_extract_t *x) {
+    int i;
+    x->record.size = 0;
+    for (i=0; i<BUGZ_EXTRACT_FIELDS; i++) {
+        x->values[i].data = NULL;
+        x->values[i].len = 0;
+        x->values[i].type = json_type_null;
+    }
+}
+
+static void bugz_extract_emit(struct bugz_extract_t *x) {
+    int i;
+    if (x->record.failed) {
+        x->aborted = x->scan.stop = TRUE;
+        return;
+    }
+    for (i=0; i<BUGZ_EXTRACT_FIELDS; i++) {
+        if (x->values[i].len || x->values[i].type != json_type_null)
+            x->values[i].data = x->record.payload + x->offsets[i];
+    }
+    x->records++;
+    if (x->callback(x->values, x->userp))
+        x->aborted = x->scan.stop = TRUE;
+}
+
+/* start capturing a value into the record buffer */
+static void bugz_extract_capture(struct bugz_extract_t *x, int field, char c) {
+    x->field = field;
+    x->offsets[field] = x->record.size;
+    x->capture_depth = x->scan.depth;
+    switch (c) {
+    case '"' :
+        x->capture = 's';
+        x->scan.decode = TRUE;
+        x->values[field].type = json_type_string;
+        break;
+    case '{' :
+    case '[' :
+        x->capture = 'c';
+        x->values[field].type = c == '{' ? json_type_object : json_type_array;
+        break;
+    default :
+        x->capture = 'n';
+        x->values[field].type = c == 't' || c == 'f' ? json_type_boolean :
+                                c == 'n' ? json_type_null : json_type_int;
+    }
+}
+
+static void bugz_extract_done(struct bugz_extract_t *x) {
+    struct bugz_value_t *v = &x->values[x->field];
+    v->len = x->record.size - x->offsets[x->field];
+    bugz_stream_append(&x->record, &x->record_alloc, "", 0); /* terminated */
+    if (x->record.failed) {
+        x->capture = 0;
+        x->aborted = x->scan.stop = TRUE;
+        return;
+    }
+    x->record.size++;
+    if (v->type == json_type_int &&
+        strpbrk(x->record.payload + x->offsets[x->field], ".eE"))
+        v->type = json_type_double;
+    x->capture = 0;
+    if (x->nfields == 0)
+        bugz_extract_emit(x);
+}
+
+/* pending bytes up to end go to the skeleton, the captured value or nowhere */
+static void bugz_extract_flush(struct bugz_extract_t *x, size_t end) {
+    const char *data = x->chunk + x->start;
+    size_t len = end - x->start;
+
+    x->start = end;
+    if (len == 0)
+        return;
+    if (x->capture == 'c' || x->capture == 'n')
+        bugz_stream_append(&x->record, &x->record_alloc, data, len);
+    else if (x->capture == 0 && x->record_depth == 0)
+        bugz_stream_append(&x->skeleton, &x->skeleton_alloc, data, len);
+}
+
+static void bugz_extract_text(struct bugz_scan_t *scan, const char *data, size_t len) {
+    struct bugz_extract_t *x = (struct bugz_extract_t *)scan;
+    if (x->text_callback == NULL)
+        bugz_stream_append(&x->record, &x->record_alloc, data, len);
+    else if (x->text_callback(data, len, x->userp))
+        x->aborted = scan->stop = TRUE;
+}
+
+static int bugz_extract_event(struct bugz_scan_t *scan, int event, size_t i, char c) {
+    struct bugz_extract_t *x = (struct bugz_extract_t *)scan;
+    struct bugz_scan_frame_t *top;
+    int f, level;
+
+    switch (event) {
+    case bugz_scan_value :
+        if (x->capture == 0 && x->record_depth == 0) {
+            level = bugz_scan_level(scan);
+            if (level == scan->ncomponents && (x->nfields == 0 || c == '{')) {
+                bugz_extract_flush(x, i);
+                if (!bugz_extract_in_records(x))
+                    bugz_stream_append(&x->skeleton, &x->skeleton_alloc, "null", 4);
+                bugz_extract_begin(x);
+                if (x->nfields == 0)
+                    bugz_extract_capture(x, 0, c);
+                else
+                    x->record_depth = scan->depth + 1;
+                level = -1;
+            }
+            return level;
+        }
+        top = bugz_scan_top(scan);
+        if (x->capture == 0 && scan->depth == x->record_depth && top && top->type == '{') {
+            for (f=0; f<x->nfields && strcmp(x->fields[f], scan->key); f++)
+                ;
+            if (f < x->nfields) {
+                x->start = i;
+                bugz_extract_capture(x, f, c);
+            }
+        }
+        return -1;
+    case bugz_scan_comma :
+        if (x->capture == 0 && x->record_depth == 0 && bugz_extract_in_records(x)) {
+            bugz_extract_flush(x, i);
+            x->start = i + 1; /* drop separators of extracted records */
+        }
+        break;
+    case bugz_scan_close :
+        if (x->capture == 'c' && scan->depth == x->capture_depth) {
+            bugz_extract_flush(x, i + 1);
+            bugz_extract_done(x);
+        }
+        else if (x->capture == 0 && x->record_depth && scan->depth == x->record_depth - 1) {
+            x->record_depth = 0;
+            x->start = i + 1;
+            bugz_extract_emit(x);
+        }
+        break;
+    case bugz_scan_scalar_end :
+        if (x->capture == 'n') {
+            bugz_extract_flush(x, i);
+            bugz_extract_done(x);
+        }
+        break;
+    case bugz_scan_string_end :
+        if (x->capture == 's') {
+            bugz_extract_done(x);
+            x->start = i + 1;
+        }
+        break;
+    }
+    return -1;
+}
+
+size_t bugz_extract_feed(struct bugz_extract_t *x, const char *p, size_t len) {
+    int records = x->records;
+
+    x->chunk = p;
+    x->start = 0;
+    bugz_scan_feed(&x->scan, p, len);
+    if (x->aborted)
+        return 0;
+    if (x->capture != 's')
+        bugz_extract_flush(x, len);
+    if (x->skeleton.failed || x->record.failed) {
+        x->aborted = TRUE;
+        return 0;
+    }
+    if (x->records != records)
+        bugz_sink_flush(&bugz_stdout); /* let consumers start on what we have */
+    return len;
+}
+
+/* number of values extracted, the skeleton is parsed into *jsonp */
+int bugz_extract_free(struct bugz_extract_t *x, json_object **jsonp) {
+    int records = x->records;
+    if (jsonp)
+        *jsonp = x->skeleton.size > 0 && !x->aborted ? bugz_fetch_to_json(&x->skeleton) : NULL;
+    free(x->skeleton.payload);
+    free(x->record.payload);
+    free(x);
+    return records;
+}
+
+static size_t bugz_extract_callback(void *data, size_t size, size_t nmemb, void *userp) {
+    return bugz_extract_feed((struct bugz_extract_t *)userp, (const char *)data, size * nmemb);
+}
+
+CURLcode bugz_get_fields(CURL *curl, const char *url, const char *pattern,
+                         bugz_value_callback_t callback, void *userp, json_object **jsonp) {
+    CURLcode rcode;
+    int ok = FALSE;
+    struct bugz_extract_t *x;
+
+    *jsonp = NULL;
+    if ((x = bugz_extract_new(pattern, callback, userp)) == NULL)
+        return CURLE_OUT_OF_MEMORY;
+    bugz_trace_begin("json", "extract fields");
+    rcode = bugz_get_perform(curl, url, bugz_extract_callback, (void *)x);
+    bugz_trace_end();
+    if (x->aborted && rcode == CURLE_WRITE_ERROR)
+        fprintf(stderr, N_("ERROR: aborted after %d record(s)\n"), x->records);
+    else if (rcode != CURLE_OK || x->skeleton.size < 1)
+        fprintf(stderr, N_("ERROR: %s\n"), curl_easy_strerror(rcode));
+    else
+        ok = TRUE;
+    bugz_extract_free(x, ok ? jsonp : NULL);
+    return rcode;
+}
+
+/*
+ * Concurrent GET of many URLs over at most jobs transfers at a time,
+ * callback is called with the parsed response (NULL on failure) of
+ * each URL in order of completion. Returns the number of failures.
+ *
+ * With bugz_get_multi_text(), the string found at pattern in each
+ * response (e.g. "attachments.*.data") is not kept but handed to text()
+ * unescaped, in pieces as it is received, and once more with data NULL
+ * when it ends. callback then gets the rest of the response.
+ */
+struct bugz_multi_slot_t {
+    CURL *curl;
+    int index;
+    struct bugz_fetch_t fetch;
+    struct bugz_extract_t *x;
+    bugz_multi_text_t text;
+    void *userp;
+};
+
+static int bugz_multi_text(const char *data, size_t len, void *userp) {
+    struct bugz_multi_slot_t *slot = (struct bugz_multi_slot_t *)userp;
+    return slot->text(slot->index, data, len, slot->userp);
+}
+
+static int bugz_multi_text_end(const struct bugz_value_t *values, void *userp) {
+    struct bugz_multi_slot_t *slot = (struct bugz_multi_slot_t *)userp;
+    return slot->text(slot->index, NULL, 0, slot->userp);
+}
+
+static size_t bugz_multi_extract_callback(void *data, size_t size, size_t nmemb, void *userp) {
+    struct bugz_multi_slot_t *slot = (struct bugz_multi_slot_t *)userp;
+    return bugz_extract_feed(slot->x, (const char *)data, size * nmemb);
+}
+
+/* next URL of the slot */
+static void bugz_multi_start(struct bugz_multi_slot_t *slot, const char *url, const char *pattern) {
+    if (pattern == NULL) {
+        bugz_get_setopt(slot->curl, url, bugz_curl_callback, &slot->fetch);
+        return;
+    }
+    if ((slot->x = bugz_extract_new(pattern, bugz_multi_text_end, slot)) == NULL) {
+        fprintf(stderr, "ERROR: allocate memory in bugz_get_multi failed\n");
+        exit(1);
+    }
+    slot->x->text_callback = bugz_multi_text;
+    bugz_get_setopt(slot->curl, url, bugz_multi_extract_callback, slot);
+}
+
+int bugz_get_multi_text(struct curl_slist *headers, char **urls, int n, int jobs, const char *pattern,
+                        bugz_multi_text_t text, bugz_multi_callback_t callback, void *userp) {
+    CURLM *multi;
+    CURLMsg *msg;
+    int i, next = 0, running = 0, left, failures = 0;
+    struct bugz_multi_slot_t *slots, *slot;
+
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > n)
+        jobs = n;
+    if ((multi = curl_multi_init()) == NULL)
+        return n;
+    if ((slots = (struct bugz_multi_slot_t *)calloc(jobs, sizeof(*slots))) == NULL) {
+        curl_multi_cleanup(multi);
+        return n;
+    }
+    for (i=0; i<jobs; i++) {
+        slot = &slots[i];
+        if ((slot->curl = curl_easy_init()) == NULL)
+            break;
+        curl_easy_setopt(slot->curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(slot->curl, CURLOPT_PRIVATE, slot);
+        slot->index = next++;
+        slot->text = text;
+        slot->userp = userp;
+        bugz_multi_start(slot, urls[slot->index], pattern);
+        curl_multi_add_handle(multi, slot->curl);
+    }
+
+    do {
+        curl_multi_perform(multi, &running);
+        while ((msg = curl_multi_info_read(multi, &left)) != NULL) {
+            json_object *json = NULL;
+            CURLcode result;
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&slot);
+            result = msg->data.result; /* msg is gone with the handle */
+            curl_multi_remove_handle(multi, slot->curl);
+            bugz_debug_flush();
+            bugz_metrics_record(slot->curl, result);
+            if (result != CURLE_OK ||
+                (slot->x == NULL && slot->fetch.size < 1)) {
+                char *masked = bugz_mask_url(urls[slot->index]);
+                fprintf(stderr, N_("ERROR: %s: %s\n"), masked ? masked : "",
+                                curl_easy_strerror(result));
+                free(masked);
+            }
+            else if (slot->x == NULL)
+                json = bugz_fetch_to_json(&slot->fetch);
+            if (slot->x) {
+                bugz_extract_free(slot->x, json == NULL && result == CURLE_OK ? &json : NULL);
+                slot->x = NULL;
+            }
+            if (json == NULL)
+                failures++;
+            callback(slot->index, json, userp);
+            json_object_put(json);
+            free(slot->fetch.payload);
+            slot->fetch.payload = NULL;
+            slot->fetch.size = 0;
+            if (next < n) { /* reuse the handle, and its connection */
+                slot->index = next++;
+                bugz_multi_start(slot, urls[slot->index], pattern);
+                curl_multi_add_handle(multi, slot->curl);
+                running++;
+            }
+        }
+        if (running)
+            curl_multi_wait(multi, NULL, 0, 1000, NULL);
+    } while (running);
+
+    for (i=0; i<jobs; i++) {
+        if (slots[i].curl)
+            curl_easy_cleanup(slots[i].curl);
+    }
+    free(slots);
+    curl_multi_cleanup(multi);
+    failures += n - next; /* never started */
+    return failures;
+}
+
+int bugz_get_multi(struct curl_slist *headers, char **urls, int n, int jobs,
+                   bugz_multi_callback_t callback, void *userp) {
+    return bugz_get_multi_text(headers, urls, n, jobs, NULL, NULL, callback, userp);
+}
+
+/* for bugz_get_fields() of a single number, userp is an int */
+int bugz_int_callback(const struct bugz_value_t *values, void *userp) {
+    *(int *)userp = values[0].data ? atoi(values[0].data) : 0;
+    return 0;
+}
+
 char *bugz_get_base(struct bugz_config_t *config) {
     static char base[PATH_MAX];
 
@@ -799,7 +1886,7 @@ char *bugz_get_base(struct bugz_config_t *config) {
     return NULL;
 }
 
-char *bugz_get_auth(struct bugz_config_t *config, char **pass) {
+static char *bugz_resolve_auth(struct bugz_config_t *config, char **pass) {
     static char username[PATH_MAX]; /* might be api_key */
     static char password[PATH_MAX]; /* might be empty */
     char *pu, *pp, *pc;
@@ -925,6 +2012,14 @@ char *bugz_get_auth(struct bugz_config_t *config, char **pass) {
     return NULL;
 }
 
+char *bugz_get_auth(struct bugz_config_t *config, char **pass) {
+    char *username;
+    bugz_trace_begin("auth", "auth resolution");
+    username = bugz_resolve_auth(config, pass);
+    bugz_trace_end();
+    return username;
+}
+
 struct curl_slist *bugz_get_search_statuses(struct bugz_config_t *config) {
     struct curl_slist *search_statuses = NULL;
     if (config) {
@@ -959,61 +2054,28 @@ struct curl_slist *bugz_get_search_statuses(struct bugz_config_t *config) {
     return search_statuses;
 }
 
-static char* word_wrap(char *wrap, char *word, int width) {
-    int len, eol, pos, next;
+#include "bugz_fields_table.h"
 
-    *wrap = '\0';
-    for (pos = 0; pos < strlen(word); pos = next) {
-        char *p = strchr(word + pos, '\n');
-        eol = p ? p - word : -1;
-        if (eol == -1)
-            next = eol = pos + strlen(word + pos);
-        else
-            next = eol + 1;
-        if (eol > pos) {
-            do {
-                len = eol - pos;
-                if (len > width) {
-                    int i = width;
-                    while (i >=0 && !isspace(word[pos + i]))
-                        i--;
-                    if (i < 0)
-                        len = width;
-                    else {
-                        while (i >= 0 && isspace(word[pos + i]))
-                            i--;
-                        len = i + 1;
-                    } 
-                }
-                strncat(wrap, word + pos, len);
-                strcat(wrap, "\n");
-                pos += len;
-                while (pos < eol && isspace(word[pos]))
-                    pos++;
-            } while (eol > pos);
-        }
-        else
-            strcat(wrap, "\n");
-    }
-    return wrap;
-}
+const struct bugz_field_t bugz_fields[] = {
+    #define _field_macro_(n,l,f,w) {#n, l, bugz_field_format_##f, w},
+    #include "bugz_fields.h"
+    { 0 }
+};
 
-/* https://en.wikipedia.org/wiki/Jenkins_hash_function */
-static inline uint32_t jenkins_one_at_a_time_hash(char *key, size_t len) {
-    uint32_t i, hash;
-    for(i = hash = 0; i < len; ++i) {
-        hash += key[i];
-        hash += (hash << 10);
-        hash ^= (hash >> 6);
-    }
-    hash += (hash << 3);
-    hash ^= (hash >> 11);
-    hash += (hash << 15);
-    return hash;
+const struct bugz_field_t *bugz_field_lookup(const char *key, size_t len) {
+    int id;
+    uint32_t hash = jenkins_one_at_a_time_hash(key, len);
+    id = bugz_field_slots[bugz_field_slot(hash, BUGZ_FIELD_SEED, BUGZ_FIELD_SHIFT)];
+    if (id < 0 || bugz_field_hashes[id] != hash ||
+        strncmp(bugz_fields[id].name, key, len) || bugz_fields[id].name[len])
+        return NULL;
+    return &bugz_fields[id];
 }
 
-void bugz_show_bug_info(json_object *bug, json_object *attachments, json_object *comments) {
-    int i;
+void bugz_render_bug_info(struct bugz_sink_t *sink, json_object *bug,
+                          json_object *attachments, json_object *comments) {
+    int i, n, format;
+    const struct bugz_field_t *field;
     json_object_object_foreach(bug,key,val) {
         if (json_object_is_type(val, json_type_null))
             continue;
@@ -1023,292 +2085,319 @@ void bugz_show_bug_info(json_object *bug, json_object *attachments, json_object
         if (json_object_is_type(val, json_type_string) &&
             json_object_get_string_len(val) == 0)
             continue;
-        switch (jenkins_one_at_a_time_hash(key,strlen(key))) {
-        case 0x70021a42 : /* assigned_to_detail */
-        case 0xef259686 : /* is_cc_accessible */
-        case 0xf22b1ac9 : /* creator_detail */
-        case 0x71e45014 : /* estimated_time */
-        case 0x27625455 : /* remaining_time */
-        case 0x02751e9b : /* update_token */
-        case 0xc95953dd : /* classification */
-        case 0x64e45528 : /* cc_detail */
-        case 0x1485bb6c : /* is_open */
-        case 0x3b214c7a : /* actual_time */
-        case 0x1893ebbc : /* is_creator_accessible */
-        case 0xd05616fd : /* target_milestone */
-        case 0x6af36a3d : /* is_confirmed */
-        case 0x1b60404d : /* id */
-            break;        /* skip fields */
-
-        #define _farray1_(f) for (i=0; i<json_object_array_length(val); i++) {               \
-                                 fprintf(stdout, "%-12s: %s\n", #f,                          \
-                                 json_object_get_string(json_object_array_get_idx(val, i))); \
-                             }
-        #define _farray2_(f) fprintf(stdout, "%-12s: ", #f);                                 \
-                             for (i=0; i<json_object_array_length(val)-1; i++) {             \
-                                 fprintf(stdout, "%s, ",                                     \
-                                 json_object_get_string(json_object_array_get_idx(val, i))); \
-                             }                                                               \
-                             fprintf(stdout, "%s\n",                                         \
-                             json_object_get_string(json_object_array_get_idx(val, i)));
-        #define _fstring_(f) fprintf(stdout, "%-12s: %s\n", #f, \
-                                     json_object_get_string(val))
-
-        case 0x1470edc0 : /* priority */
-            _fstring_(Priority);
-            break;
-        case 0xb02e4c82 : /* blocks */
-            _farray2_(Blocks);
-            break;
-        case 0xfd2a3542 : /* creator */
-            _fstring_(Reporter);
-            break;
-        case 0x1ef6bc45 : /* last_change_time */
-            _fstring_(Updated);
-            break;
-        case 0xcb093908 : /* keywords */
-            _farray2_(Keywords);
-            break;
-        case 0x82bf95ca : /* cc */
-            _farray1_(CC)
-            break;
-        case 0xbc113f8c : /* url */
-            _fstring_(URL);
-            break;
-        case 0x7f3f554c : /* assigned_to */
-            _fstring_(Assignee);
-            break;
-        case 0x9150e7cc : /* groups */
-            _farray2_(Groups);
-            break;
-        case 0x324627cc : /* see_also */
-            _farray1_(See Also);
-            break;
-        case 0x1bc9514d : /* whiteboard */
-            _fstring_(Whiteboard);
-            break;
-        case 0x23bf264d : /* creation_time */
-            _fstring_(Reported);
-            break;
-        case 0x9746780d : /* qa_contact */
-            _fstring_(qaContact);
-            break;
-        case 0x15adaa4f : /* depends_on */
-            _fstring_(dependsOn);
-            break;
-        case 0xd74c2a53 : /* dupe_of */
-            _fstring_(dupeOf);
-            break;
-        case 0x135bd2dc : /* resolution */
-            _fstring_(Resolution);
-            break;
-        case 0x3e0ac7de : /* alias */
-            _farray2_(Alias);
-            break;
-        case 0x2a6825df : /* op_sys */
-            _fstring_(OpSystem);
-            break;
-        case 0x6609b863 : /* status */
-            _fstring_(Status);
-            break;
-        case 0x2d4e7caa : /* summary */
-            _fstring_(Title);
-            break;
-        case 0x2fbe482d : /* platform */
-            _fstring_(Platform);
-            break;
-        case 0x33a7556e : /* severity */
-            _fstring_(Severity);
-            break;
-        case 0x67d26872 : /* flags */
-            _farray2_(Flags);
-            break;
-        case 0x68c27e33 : /* version */
-            _fstring_(Version);
+        field = bugz_field_lookup(key, strlen(key));
+        if (field == NULL) {
+            bugz_sink_printf(sink, "%-12s: %s\n", key,
+                             json_object_to_json_string(val));
+            continue;
+        }
+        format = field->format;
+        if (format != bugz_field_format_skip &&
+            json_object_is_type(val, json_type_array) == FALSE)
+            format = bugz_field_format_string;
+        switch (format) {
+        case bugz_field_format_skip :
             break;
-        case 0x5f6b0634 : /* deadline */
-            _fstring_(Deadline);
+        case bugz_field_format_string :
+            bugz_sink_printf(sink, "%-12s: %s\n", field->label,
+                             json_object_get_string(val));
             break;
-        case 0x51d7187a : /* component */
-            _fstring_(Component);
+        case bugz_field_format_list :
+            bugz_sink_printf(sink, "%-12s: ", field->label);
+            n = json_object_array_length(val);
+            for (i=0; i<n; i++) {
+                bugz_sink_printf(sink, i < n - 1 ? "%s, " : "%s\n",
+                json_object_get_string(json_object_array_get_idx(val, i)));
+            }
             break;
-        case 0x05ac6a7d : /* product */
-            _fstring_(Product);
+        case bugz_field_format_lines :
+            n = json_object_array_length(val);
+            for (i=0; i<n; i++) {
+                bugz_sink_printf(sink, "%-12s: %s\n", field->label,
+                json_object_get_string(json_object_array_get_idx(val, i)));
+            }
             break;
-        default :
-            fprintf(stdout, "%-12s: %s\n", key,
-                    json_object_to_json_string(val));
         }
     }
 
     if (attachments) {
-        json_object *attachment, *id, *when, *desc;
-        fprintf(stdout, "%-12s: %d\n", "Attachments",
-                json_object_array_length(attachments));
-        for (i=0; i<json_object_array_length(attachments); i++) {
-            attachment = json_object_array_get_idx(attachments, i);
-            json_object_object_get_ex(attachment, "id", &id);
-            json_object_object_get_ex(attachment, "summary", &desc);
-            json_object_object_get_ex(attachment, "creation_time", &when);
-            fprintf(stdout, "[Attachment] [%s] [%s] [%s]\n",
-                    json_object_get_string(id),
-                    json_object_get_string(when),
-                    json_object_get_string(desc));
+        json_object *attachment;
+        n = bugz_doc_length(attachments);
+        bugz_sink_printf(sink, "%-12s: %d\n", "Attachments", n);
+        for (i=0; i<n; i++) {
+            attachment = bugz_doc_index(attachments, i);
+            bugz_sink_printf(sink, "[Attachment] [%s] [%s] [%s]\n",
+                    bugz_doc_string(attachment, "id"),
+                    bugz_doc_string(attachment, "creation_time"),
+                    bugz_doc_string(attachment, "summary"));
         }
     }
     
     if (comments) {
-        int j, len;
-        char *line, *wrap = NULL;
-        json_object *comment, *who, *when, *what;
-        fprintf(stdout, "%-12s: %d\n\n", "Comments",
-                json_object_array_length(comments));
-        for (i=0; i<json_object_array_length(comments); i++) {
-            comment = json_object_array_get_idx(comments, i);
-            json_object_object_get_ex(comment, "creator", &who);
-            json_object_object_get_ex(comment, "time", &when);
-            json_object_object_get_ex(comment, "text", &what);
-            fprintf(stdout, "[Comment #%d] %s : %s\n", i,
-                            json_object_get_string(who),
-                            json_object_get_string(when));
-            for (j=0; j<bugz_arguments.columns; j++) fprintf(stdout, "%c", '-');
-            fprintf(stdout, "\n");
-            
-            len = json_object_get_string_len(what);
-            line = (char *)json_object_get_string(what);
-            wrap = (char *)realloc(wrap, len * 2 + 1);
-            memset(wrap, 0, len * 2 + 1);
-            word_wrap(wrap, line, bugz_arguments.columns);
-            fprintf(stdout, "%s\n", wrap);
-            fflush(stdout);
+        json_object *comment;
+        n = bugz_doc_length(comments);
+        bugz_sink_printf(sink, "%-12s: %d\n\n", "Comments", n);
+        for (i=0; i<n; i++) {
+            comment = bugz_doc_index(comments, i);
+            /* count is the position on the bug, also for a --comments slice */
+            bugz_sink_printf(sink, "[Comment #%d] %s : %s\n",
+                             bugz_doc_int(comment, "count", i),
+                             bugz_doc_string(comment, "creator"),
+                             bugz_doc_string(comment, "time"));
+            bugz_sink_fill(sink, '-', bugz_arguments.columns);
+            bugz_sink_write(sink, "\n", 1);
+            bugz_sink_wrap(sink, bugz_doc_string(comment, "text"),
+                           bugz_doc_string_len(comment, "text"), bugz_arguments.columns);
+            bugz_sink_write(sink, "\n", 1);
         }
-        free(wrap);
     }
 }
 
-const char *bugz_get_content_type(const char *filename) {
-    magic_t cookie = magic_open(MAGIC_MIME);
-    magic_load(cookie, NULL);
-    return magic_file(cookie, filename);
+void bugz_show_bug_info(json_object *bug, json_object *attachments, json_object *comments) {
+    bugz_trace_begin("render", "render bug");
+    bugz_render_bug_info(&bugz_stdout, bug, attachments, comments);
+    bugz_sink_flush(&bugz_stdout);
+    bugz_trace_end();
+}
+
+/*
+ * Content type of a file to attach. Common types are recognized from
+ * the first bytes of the file, or from the extension of text files
+ * whose first bytes are ASCII or UTF-8, libmagic is only used for the
+ * others. Its database takes a while to load, so there is one handle
+ * for the whole process, opened on first use.
+ */
+static magic_t bugz_magic = NULL;
+
+static void bugz_magic_atexit(void) {
+    magic_close(bugz_magic);
+    bugz_magic = NULL;
 }
 
-char *bugz_base64_encode(FILE *infile) {
-    struct stat stat;
-    char *p, *encode = NULL;
-    unsigned char in[3] = {0};
-    unsigned char out[4]= {0};
-    int i, len, cur, total = 0;
-    const char eb64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const struct {
+    const char *signature;
+    size_t len;
+    const char *type;
+    const char *extension;  /* only with it, others share the signature */
+} bugz_content_signatures[] = {
+    { "\x89PNG\r\n\x1a\n",        8, "image/png; charset=binary" },
+    { "\xff\xd8\xff",             3, "image/jpeg; charset=binary" },
+    { "GIF87a",                   6, "image/gif; charset=binary" },
+    { "GIF89a",                   6, "image/gif; charset=binary" },
+    { "%PDF-",                    5, "application/pdf; charset=binary" },
+    { "\x1f\x8b",                 2, "application/gzip; charset=binary" },
+    { "BZh",                      3, "application/x-bzip2; charset=binary" },
+    { "\xfd" "7zXZ\0",            6, "application/x-xz; charset=binary" },
+    { "\x28\xb5\x2f\xfd",         4, "application/zstd; charset=binary" },
+    { "PK\x03\x04",               4, "application/zip; charset=binary", "zip" }, /* docx, jar, .. */
+    { "7z\xbc\xaf\x27\x1c",       6, "application/x-7z-compressed; charset=binary" },
+    { NULL }
+};
 
-    if (fstat(fileno(infile), &stat))
-        return NULL;
-    total = (stat.st_size + 2)/3*4 + 1;
-    if ((encode = (char *)malloc(total + 1)) == NULL)
-        return NULL;
+static const struct {
+    const char *extension;
+    const char *type;
+} bugz_content_extensions[] = {
+    { "txt",   "text/plain" },
+    { "log",   "text/plain" },
+    { "patch", "text/x-diff" },
+    { "diff",  "text/x-diff" },
+    { "c",     "text/x-c" },
+    { "h",     "text/x-c" },
+    { "cpp",   "text/x-c++" },
+    { "py",    "text/x-script.python" },
+    { "sh",    "text/x-shellscript" },
+    { "json",  "application/json" },
+    { "xml",   "text/xml" },
+    { "html",  "text/html" },
+    { NULL }
+};
 
-    cur = 0;
-    memset(encode, 0, total+1);
-    while (feof(infile) == 0) {
-        len = 0;
-        for (i=0; i<3; i++) {
-            in[i] = (unsigned char)getc(infile);
-            if (feof(infile) == 0)
-                len++;
-            else
-                in[i] = (unsigned char)0;
-        }
-        if (len > 0) {
-            out[0] = (unsigned char)eb64[(int)(in[0] >> 2)];
-            out[1] = (unsigned char)eb64[(int)(((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4))];
-            out[2] = (unsigned char)(len > 1 ? eb64[(int)(((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6))] : '=');
-            out[3] = (unsigned char)(len > 2 ? eb64[(int)(in[2] & 0x3f)] : '=');
-            if (cur + 4 > total) {
-                if ((p = (char *)malloc(total + 5)) == NULL) {
-                    free(encode);
-                    return NULL;
-                }
-                total += 4;
-                memset(p, 0, total+1);
-                memcpy(p, encode, cur);
-                free(encode);
-                encode = p;
-            }
-            for (i=0; i<4; i++) {
-                encode[cur++] = out[i];
-            }
+/* 0 binary, 1 ASCII, 2 UTF-8, a sequence cut at the end is accepted */
+static int bugz_content_text(const unsigned char *p, size_t len) {
+    size_t i, k, n;
+    int utf8 = 0;
+
+    for (i=0; i<len; i++) {
+        if (p[i] < 0x80) {
+            if (p[i] < 0x20 && p[i] != '\n' && p[i] != '\r' && p[i] != '\t' &&
+                p[i] != '\f' && p[i] != '\033')
+                return 0;
+            continue;
+        }
+        if (p[i] >= 0xc2 && p[i] <= 0xdf)
+            n = 1;
+        else if (p[i] >= 0xe0 && p[i] <= 0xef)
+            n = 2;
+        else if (p[i] >= 0xf0 && p[i] <= 0xf4)
+            n = 3;
+        else
+            return 0;
+        for (k=1; k<=n && i+k<len; k++) {
+            if ((p[i+k] & 0xc0) != 0x80)
+                return 0;
         }
+        i += n;
+        utf8 = 1;
     }
-    return encode;
+    return utf8 ? 2 : 1;
 }
 
-char *bugz_base64_decode(const char *decode, FILE *outfile) {
-    unsigned char in[4] = {0};
-    unsigned char out[3]= {0};
-    int v, i, len;
-    const char db64[] = "|$$$}rstuvwxyz{$$$$$$$>?@ABCDEFGHIJKLMNOPQRSTUVW$$$$$$XYZ[\\]^_`abcdefghijklmnopq";
-
-    char *p = (char *)decode;
-    while (*p) {
-        for (len=0, i=0; i<4 && *p; i++) {
-            v = 0;
-            while (*p && v == 0) {
-                v = *p++;
-                if (*p) {
-                    v = ((v < 43 || v > 122) ? 0 : (int)db64[v-43]);
-                    if (v)
-                        v = ((v == (int)'$') ? 0 : v-61);
-                }
-            }
-            if (*p) {
-                len++;
-                if (v)
-                    in[i] = (unsigned char)(v-1);
-            }
-            else
-                in[i] = (unsigned char)0;
-        }
-        if (len > 0) {
-            out[0] = (unsigned char)(in[0] << 2 | in[1] >> 4);
-            out[1] = (unsigned char)(in[1] << 4 | in[2] >> 2);
-            out[2] = (unsigned char)(((in[2] << 6) & 0xc0) | in[3]);
-            for (i=0; i<len-1; i++) {
-                if (putc((int)out[i], outfile) == EOF) {
-                    if (ferror(outfile))
-                        return NULL;
-                    break;
-                }
-            }
+const char *bugz_get_content_type(const char *filename) {
+    int i, text;
+    FILE *fp;
+    const char *type;
+    size_t len = 0;
+    unsigned char head[4096];
+    const char *ext = strrchr(filename, '.');
+
+    if ((fp = fopen(filename, "rb")) != NULL) {
+        len = fread(head, 1, sizeof(head), fp);
+        fclose(fp);
+    }
+    for (i=0; bugz_content_signatures[i].signature; i++) {
+        if (bugz_content_signatures[i].extension &&
+           (ext == NULL || strcasecmp(ext + 1, bugz_content_signatures[i].extension) != 0))
+            continue;
+        if (len >= bugz_content_signatures[i].len &&
+            memcmp(head, bugz_content_signatures[i].signature, bugz_content_signatures[i].len) == 0)
+            return bugz_content_signatures[i].type;
+    }
+    if (ext && strchr(ext, '/') == NULL && (text = bugz_content_text(head, len)) != 0) {
+        for (i=0; bugz_content_extensions[i].extension; i++) {
+            if (strcasecmp(ext + 1, bugz_content_extensions[i].extension) == 0)
+                return bugz_arena_printf(&bugz_arena, "%s; charset=%s", bugz_content_extensions[i].type,
+                                         text == 2 ? "utf-8" : "us-ascii");
+        }
+    }
+
+    if (bugz_magic == NULL) {
+        if ((bugz_magic = magic_open(MAGIC_MIME)) == NULL)
+            return "application/octet-stream";
+        if (magic_load(bugz_magic, NULL) != 0) {
+            magic_close(bugz_magic);
+            bugz_magic = NULL;
+            return "application/octet-stream";
+        }
+        atexit(bugz_magic_atexit);
+    }
+    type = magic_file(bugz_magic, filename);
+    return type ? type : "application/octet-stream";
+}
+
+/*
+ * Encode len bytes of in, out must hold (len + 2) / 3 * 4 bytes, only
+ * the last block of a stream may have a length which is not a multiple
+ * of 3. Returns the number of bytes written.
+ */
+size_t bugz_base64_encode_block(const unsigned char *in, size_t len, char *out) {
+    static const char eb64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char *p = out;
+    size_t i;
+
+    for (i=0; i+3<=len; i+=3) {
+        p[0] = eb64[in[i] >> 2];
+        p[1] = eb64[((in[i] & 0x03) << 4) | (in[i+1] >> 4)];
+        p[2] = eb64[((in[i+1] & 0x0f) << 2) | (in[i+2] >> 6)];
+        p[3] = eb64[in[i+2] & 0x3f];
+        p += 4;
+    }
+    if (i < len) {
+        unsigned char c = i + 1 < len ? in[i+1] : 0;
+        p[0] = eb64[in[i] >> 2];
+        p[1] = eb64[((in[i] & 0x03) << 4) | (c >> 4)];
+        p[2] = i + 1 < len ? eb64[(c & 0x0f) << 2] : '=';
+        p[3] = '=';
+        p += 4;
+    }
+    return p - out;
+}
+
+/*
+ * Characters other than the base64 alphabet (line breaks) are skipped,
+ * the data ends at the first '=' or at the end of the string, the
+ * last group may be short with or without padding.
+ *
+ * Incremental, the text may be given in pieces of any size, out has
+ * room for len / 4 * 3 + 3 bytes, bugz_base64_decode_end() writes the
+ * 1 or 2 bytes of a short last group.
+ */
+size_t bugz_base64_decode_block(struct bugz_base64_t *state, const char *in, size_t len,
+                                unsigned char *out) {
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static signed char db64[256];
+    const unsigned char *p = (const unsigned char *)in, *end = p + len;
+    unsigned char *q = out;
+    int i, v;
+
+    if (db64[0] == 0) {
+        memset(db64, -1, sizeof(db64));
+        for (i=0; i<64; i++)
+            db64[(unsigned char)b64[i]] = (signed char)i;
+    }
+    for (; p < end && !state->end; p++) {
+        if (*p == '=') {
+            state->end = TRUE;
+            break;
+        }
+        if ((v = db64[*p]) < 0)
+            continue;
+        state->bits = state->bits << 6 | (unsigned int)v;
+        if (++state->n == 4) {
+            *q++ = (unsigned char)(state->bits >> 16);
+            *q++ = (unsigned char)(state->bits >> 8);
+            *q++ = (unsigned char)state->bits;
+            state->bits = 0;
+            state->n = 0;
         }
     }
+    return q - out;
+}
+
+/* 2 or 3 characters left give 1 or 2 bytes */
+size_t bugz_base64_decode_end(struct bugz_base64_t *state, unsigned char *out) {
+    size_t used = 0;
+    if (state->n >= 2) {
+        state->bits <<= 6 * (4 - state->n);
+        out[used++] = (unsigned char)(state->bits >> 16);
+        if (state->n == 3)
+            out[used++] = (unsigned char)(state->bits >> 8);
+    }
+    state->bits = 0;
+    state->n = 0;
+    state->end = TRUE;
+    return used;
+}
+
+char *bugz_base64_decode(const char *decode, FILE *outfile) {
+    struct bugz_base64_t state = { 0 };
+    unsigned char out[4096 / 4 * 3 + 3];
+    size_t i, n, used, len = strlen(decode);
+
+    for (i=0; i<len; i+=n) {
+        n = len - i < 4096 ? len - i : 4096;
+        used = bugz_base64_decode_block(&state, decode + i, n, out);
+        if (used > 0 && fwrite(out, 1, used, outfile) != used)
+            return NULL;
+    }
+    used = bugz_base64_decode_end(&state, out);
+    if (used > 0 && fwrite(out, 1, used, outfile) != used)
+        return NULL;
 
     return (char *)decode;
 }
 
+/* everything typed or piped on stdin, never NULL */
 char *bugz_raw_input(const char *prompt) {
-    char *p, *q;
-    int i = 0, s = 1024;
+    struct bugz_input_t in;
 
     if (prompt)
         fprintf(stderr, "%s", prompt);
-
-    p = q = NULL;
-    while (feof(stdin) == 0) {
-        if (i == 0) {
-            i += s;
-            p = (char *)malloc(i);
-            memset(p, 0, i);
-        }
-        if (strlen(p) >= i-1) {
-            i += s;
-            q = (char *)malloc(i);
-            memset(q, 0, i);
-            strcpy(q, p);
-            free(p);
-            p = q;
-        }
-        fgets(p+strlen(p), i - strlen(p), stdin);
+    if (bugz_input_file(&in, stdin, BUGZ_INPUT_TEXT_MAX) == FALSE) {
+        fprintf(stderr, N_("ERROR: unable to read from stdin: %s\n"), strerror(errno));
+        exit(1);
     }
-    return p;
+    return in.buffer;
 }
 
 json_object *bugz_slist_to_json_array(struct curl_slist *list, int jtype) {
@@ -0,0 +1,436 @@
+/* -*- mode: c; c-basic-offset: 4; -*-
+ * vim: noexpandtab sw=4 ts=4 sts=0:
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public
+ * License version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ */
+
+#include "bugz.h"
+
+static struct option bugz_watch_options[] = {
+    {"help",         no_argument,       0, 'h'},
+    {"search",       required_argument, 0, 's'},
+    {"interval",     required_argument, 0, 'i'},
+    {"max-interval", required_argument, 0,  0 },
+    {"count",        required_argument, 0, 'c'},
+    {"jobs",         required_argument, 0, 'j'},
+    { 0 }
+};
+
+typedef enum bugz_watch_longopt_t {
+    opt_watch_help = 0,
+    opt_watch_search,
+    opt_watch_interval,
+    opt_watch_max_interval,
+    opt_watch_count,
+    opt_watch_jobs,
+    opt_watch_end
+} bugz_watch_longopt_t;
+
+void bugz_watch_helper(int status) {
+    char help_header[] =
+    N_("Usage: bugz watch [options] bug [bug ...]\n"
+       "       bugz watch [options] --search NAME\n"
+       "Watch bugs and show their changes as they happen\n"
+       "\n"
+       "Arguments:\n"
+       "bug      : the ID of a bug to watch\n"
+       "\n"
+       "Valid options:\n"
+       "-h [--help]              : show this help message and exit\n"
+       "-s [--search] NAME       : watch the bugs of a saved search (bugz search\n"
+       "                           --save NAME)\n"
+       "-i [--interval] SECONDS  : poll interval while bugs change (default: 30)\n"
+       "--max-interval SECONDS   : longest poll interval when idle (default: 600)\n"
+       "-c [--count] COUNT       : stop after COUNT polls (default: never)\n"
+       "-j [--jobs] JOBS         : number of changed bugs fetched at a time\n"
+       "                           (default: 8)\n"
+       "\n"
+       "Type 'bugz --help' for valid global options\n");
+    fprintf(stderr, "%s", help_header);
+    exit(status);
+}
+
+struct bugz_watch_arguments_t {
+    int *bugs;
+    int nbugs;
+    char *search;
+    int interval;
+    int max_interval;
+    int count;
+    int jobs;
+};
+static struct bugz_watch_arguments_t bugz_watch_arguments = { 0 };
+
+static int bugz_watch_add_bug(int bug) {
+    int *p;
+    if ((bugz_watch_arguments.nbugs & 63) == 0) {
+        p = (int *)realloc(bugz_watch_arguments.bugs, (bugz_watch_arguments.nbugs + 64) * sizeof(int));
+        if (p == NULL)
+            return FALSE;
+        bugz_watch_arguments.bugs = p;
+    }
+    bugz_watch_arguments.bugs[bugz_watch_arguments.nbugs++] = bug;
+    return TRUE;
+}
+
+/*
+ * Each poll asks only for the id and last_change_time of the watched
+ * bugs. For the ones which changed, the history and comments newer than
+ * the previous last_change_time are fetched and shown. The interval
+ * doubles on every poll without changes, up to --max-interval, and
+ * drops back to --interval as soon as something changes.
+ */
+static int bugz_watch_collect(const struct bugz_value_t *values, void *userp) {
+    char id[32];
+    if (values[0].data == NULL || values[1].data == NULL || values[0].len >= sizeof(id))
+        return 0;
+    memcpy(id, values[0].data, values[0].len);
+    id[values[0].len] = '\0';
+    json_object_object_add((json_object *)userp, id,
+                           json_object_new_string_len(values[1].data, values[1].len));
+    return 0;
+}
+
+struct bugz_watch_changes_t {
+    json_object **results;  /* history and comments of each changed bug */
+};
+
+static void bugz_watch_multi_callback(int index, json_object *json, void *userp) {
+    struct bugz_watch_changes_t *changes = (struct bugz_watch_changes_t *)userp;
+    if (bugz_check_result(json))
+        changes->results[index] = json_object_get(json);
+}
+
+static void bugz_watch_show_history(int bug, json_object *json) {
+    int i, k;
+    const char *name;
+    const struct bugz_field_t *field;
+    json_object *history, *entry, *changes, *item;
+
+    history = bugz_doc_get(bugz_doc_index(bugz_doc_get(json, "bugs"), 0), "history");
+    for (i=0; i<(int)bugz_doc_length(history); i++) {
+        entry = bugz_doc_index(history, i);
+        if (bugz_arguments.output_format != bugz_output_text) {
+            json_object_object_add(entry, "bug_id", json_object_new_int(bug));
+            bugz_output_record(&bugz_stdout, bugz_record_history, entry);
+            continue;
+        }
+        bugz_sink_printf(&bugz_stdout, "[Bug %d] %s %s\n", bug,
+                         bugz_doc_string(entry, "when"), bugz_doc_string(entry, "who"));
+        changes = bugz_doc_get(entry, "changes");
+        for (k=0; k<(int)bugz_doc_length(changes); k++) {
+            item = bugz_doc_index(changes, k);
+            name = bugz_doc_string(item, "field_name");
+            field = name ? bugz_field_lookup(name, strlen(name)) : NULL;
+            if (field && field->label)
+                name = field->label;
+            bugz_sink_printf(&bugz_stdout, "    %-12s: %s -> %s\n", name,
+                             bugz_doc_string(item, "removed"), bugz_doc_string(item, "added"));
+        }
+    }
+}
+
+static void bugz_watch_show_comments(int bug, json_object *json) {
+    int i;
+    char id[32];
+    const char *text;
+    json_object *comments, *comment;
+
+    snprintf(id, sizeof(id), "%d", bug);
+    comments = bugz_doc_get(bugz_doc_get(bugz_doc_get(json, "bugs"), id), "comments");
+    for (i=0; i<(int)bugz_doc_length(comments); i++) {
+        comment = bugz_doc_index(comments, i);
+        if (bugz_arguments.output_format != bugz_output_text) {
+            if (!json_object_object_get_ex(comment, "bug_id", NULL))
+                json_object_object_add(comment, "bug_id", json_object_new_int(bug));
+            bugz_output_record(&bugz_stdout, bugz_record_comment, comment);
+            continue;
+        }
+        bugz_sink_printf(&bugz_stdout, "[Bug %d] %s %s, comment #%d\n", bug,
+                         bugz_doc_string(comment, "time"), bugz_doc_string(comment, "creator"),
+                         bugz_doc_int(comment, "count", 0));
+        text = bugz_doc_string(comment, "text");
+        if (text)
+            bugz_sink_wrap(&bugz_stdout, text, strlen(text), bugz_arguments.columns);
+    }
+}
+
+/* history and comments of the changed bugs, since their previous change */
+static int bugz_watch_changes(struct bugz_arena_t *arena, struct curl_slist *headers,
+                              const char *base, const char *auth, int *bugs, char **since, int n) {
+    int i, failures;
+    char **urls;
+    struct bugz_watch_changes_t changes;
+
+    urls = (char **)malloc(2 * n * sizeof(char *));
+    changes.results = (json_object **)calloc(2 * n, sizeof(json_object *));
+    if (urls == NULL || changes.results == NULL) {
+        fprintf(stderr, "ERROR: allocate memory in bugz_watch_changes failed\n");
+        exit(1);
+    }
+    for (i=0; i<n; i++) {
+        urls[2 * i] = bugz_arena_printf(arena, "%s/rest/bug/%d/history?new_since=%s%s%s",
+                                        base, bugs[i], since[i], *auth ? "&" : "", auth);
+        urls[2 * i + 1] = bugz_arena_printf(arena, "%s/rest/bug/%d/comment?new_since=%s%s%s",
+                                            base, bugs[i], since[i], *auth ? "&" : "", auth);
+    }
+    failures = bugz_get_multi(headers, urls, 2 * n, bugz_watch_arguments.jobs,
+                              bugz_watch_multi_callback, &changes);
+    bugz_trace_begin("render", "render changes");
+    for (i=0; i<n; i++) {
+        if (changes.results[2 * i])
+            bugz_watch_show_history(bugs[i], changes.results[2 * i]);
+        if (changes.results[2 * i + 1])
+            bugz_watch_show_comments(bugs[i], changes.results[2 * i + 1]);
+        json_object_put(changes.results[2 * i]);
+        json_object_put(changes.results[2 * i + 1]);
+    }
+    bugz_trace_end();
+    bugz_sink_flush(&bugz_stdout);
+    free(changes.results);
+    free(urls);
+    if (failures)
+        fprintf(stderr, N_("ERROR: failed to get changes of %d bug(s)\n"), (failures + 1) / 2);
+    return failures;
+}
+
+/* a bug which now matches or no longer matches, as a delta record like bugz search --refresh */
+static void bugz_watch_match(const char *id, json_object *last_change_time, const char *change) {
+    json_object *bug;
+
+    if (bugz_arguments.output_format == bugz_output_text) {
+        if (last_change_time)
+            bugz_sink_printf(&bugz_stdout, "[Bug %s] %s now matches\n",
+                             id, json_object_get_string(last_change_time));
+        else
+            bugz_sink_printf(&bugz_stdout, "[Bug %s] no longer matches\n", id);
+        return;
+    }
+    bug = json_object_new_object();
+    json_object_object_add(bug, "change", json_object_new_string(change));
+    json_object_object_add(bug, "id", json_object_new_int(atoi(id)));
+    if (last_change_time)
+        json_object_object_add(bug, "last_change_time", json_object_get(last_change_time));
+    bugz_output_record(&bugz_stdout, bugz_record_delta, bug);
+    json_object_put(bug);
+}
+
+/* one poll, returns the number of bugs changed since the previous one or -1 */
+static int bugz_watch_poll(CURL *curl, struct curl_slist *headers, const char *url,
+                           const char *base, const char *auth, json_object **statep) {
+    /* watch runs until killed, what one poll allocates goes with it */
+    struct bugz_arena_t arena = { 0 };
+    int n = 0, *bugs;
+    char **since;
+    json_object *json, *now = json_object_new_object(), *state = *statep, *old;
+
+    bugz_get_fields(curl, url, "bugs[*].{id,last_change_time}", bugz_watch_collect, now, &json);
+    if (bugz_check_result(json) == FALSE) {
+        json_object_put(json);
+        json_object_put(now);
+        return -1;
+    }
+    json_object_put(json);
+    *statep = now;
+    if (state == NULL)
+        return 0; /* first poll */
+
+    bugs = (int *)malloc((json_object_object_length(now) + 1) * sizeof(int));
+    since = (char **)malloc((json_object_object_length(now) + 1) * sizeof(char *));
+    json_object_object_foreach(now, key, val) {
+        if (!json_object_object_get_ex(state, key, &old)) {
+            bugz_watch_match(key, val, "new");
+            continue;
+        }
+        if (strcmp(json_object_get_string(old), json_object_get_string(val)) == 0)
+            continue;
+        bugs[n] = atoi(key);
+        since[n++] = bugz_arena_strdup(&arena, json_object_get_string(old));
+    }
+    json_object_object_foreach(state, k, v) {
+        (void)v;
+        if (!json_object_object_get_ex(now, k, NULL))
+            bugz_watch_match(k, NULL, "dropped");
+    }
+    bugz_sink_flush(&bugz_stdout);
+    if (n > 0)
+        bugz_watch_changes(&arena, headers, base, auth, bugs, since, n);
+    json_object_put(state);
+    free(bugs);
+    free(since);
+    bugz_arena_release(&arena);
+    return n;
+}
+
+int bugz_watch_main(int argc, char **argv) {
+    CURL *curl;
+    json_object *json, *criteria = NULL, *state = NULL, *val;
+    char *url, *base, *username, *password, *auth;
+    int i, opt, longindex, interval, polls, changed;
+    struct bugz_config_t *config;
+    struct curl_slist *headers = NULL;
+
+    optind++;
+    bugz_watch_arguments.interval = 30;
+    bugz_watch_arguments.max_interval = 600;
+    bugz_watch_arguments.jobs = 8;
+    while (optind < argc) {
+        opt = getopt_long(argc, argv, "-:hs:i:c:j:", bugz_watch_options, &longindex);
+        switch (opt) {
+        case ':' :
+        case '?' :
+            fprintf(stderr, opt == ':' ?
+                            N_("ERROR: %s watch: '%s' requires an argument\n") :
+                            N_("ERROR: %s watch: '%s' is not a recognized option\n") ,
+                            argv[0], argv[optind - 1]);
+        case 'h' :
+            bugz_watch_helper(opt == 'h' ? 0 : 1);
+        case 's' :
+            bugz_watch_arguments.search = optarg;
+            break;
+        case 'i' :
+            bugz_watch_arguments.interval = atoi(optarg);
+            break;
+        case 'c' :
+            bugz_watch_arguments.count = atoi(optarg);
+            break;
+        case 'j' :
+            bugz_watch_arguments.jobs = atoi(optarg);
+            break;
+        case 0 :
+            if (longindex == opt_watch_max_interval)
+                bugz_watch_arguments.max_interval = atoi(optarg);
+            break;
+        case -1 :
+            if (atoi(argv[optind]) <= 0 || bugz_watch_add_bug(atoi(argv[optind])) == FALSE) {
+                fprintf(stderr, N_("ERROR: %s watch: invalid bug specified\n"), argv[0]);
+                exit(1);
+            }
+            optind++;
+            break;
+        }
+    }
+    if ((bugz_watch_arguments.nbugs == 0) == (bugz_watch_arguments.search == NULL)) {
+        fprintf(stderr, N_("ERROR: %s watch: give either bugs or --search\n"), argv[0]);
+        exit(1);
+    }
+    if (bugz_watch_arguments.interval < 1)
+        bugz_watch_arguments.interval = 1;
+    if (bugz_watch_arguments.max_interval < bugz_watch_arguments.interval)
+        bugz_watch_arguments.max_interval = bugz_watch_arguments.interval;
+    if (bugz_arguments.output_format == bugz_output_raw) {
+        fprintf(stderr, N_("ERROR: %s watch: raw output is not supported\n"), argv[0]);
+        exit(1);
+    }
+    if (bugz_watch_arguments.search) {
+        json_object *saved = bugz_search_saved_load(bugz_watch_arguments.search);
+        if (saved == NULL)
+            exit(1);
+        json_object_object_get_ex(saved, "criteria", &val);
+        criteria = json_tokener_parse(json_object_to_json_string(val));
+        json_object_put(saved);
+    }
+
+    config = bugz_config();
+    base = bugz_get_base(config);
+    if (base == NULL) {
+        fprintf(stderr, N_("ERROR: No base URL specified\n"));
+        bugz_config_free(config);
+        exit(1);
+    }
+    username = password = NULL;
+    if (bugz_arguments.skip_auth == NULL) {
+        username = bugz_get_auth(config, &password);
+        if (username == NULL) {
+            fprintf(stderr, N_("ERROR: failed to get auth\n"));
+            bugz_config_free(config);
+            exit(1);
+        }
+    }
+    bugz_config_free(config);
+
+    json = json_object_new_object();
+    if (password) {
+        json_object_object_add(json, "login",
+        json_object_new_string(username));
+        json_object_object_add(json, "password",
+        json_object_new_string(password));
+    }
+    else if (username) {
+        json_object_object_add(json, "api_key",
+        json_object_new_string(username));
+    }
+    auth = json_object_object_length(json) > 0 ? bugz_urlencode(json) : NULL;
+    json_object_put(json);
+
+    /* the poll, ids and change times only */
+    if (criteria)
+        json = criteria;
+    else {
+        json_object *ids = json_object_new_array();
+        json = json_object_new_object();
+        for (i=0; i<bugz_watch_arguments.nbugs; i++)
+            json_object_array_add(ids, json_object_new_int(bugz_watch_arguments.bugs[i]));
+        json_object_object_add(json, "id", ids);
+    }
+    json_object_object_add(json, "include_fields", json_object_new_string("id,last_change_time"));
+    if ((url = bugz_urlencode(json)) != NULL) {
+        int n = strlen(base) + strlen("/rest/bug?&") + strlen(url) + (auth ? strlen(auth) : 0);
+        char *p = (char *)malloc(n+1);
+        sprintf(p, "%s/rest/bug?%s%s%s", base, url, auth ? "&" : "", auth ? auth : "");
+        free(url);
+        url = p;
+    }
+    json_object_put(json);
+    if (url == NULL) {
+        fprintf(stderr, N_("ERROR: %s watch: urlencode failed\n"), argv[0]);
+        exit(1);
+    }
+
+    if ((curl = curl_easy_init()) == NULL) {
+        fprintf(stderr, N_("ERROR: %s watch: curl_easy_init() failed\n"), argv[0]);
+        exit(1);
+    }
+    headers = curl_slist_append(headers, "charsets: utf-8");
+    headers = curl_slist_append(headers, "Accept: application/json");
+    headers = curl_slist_append(headers, "Content-Type: application/json");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+
+    fprintf(stderr, N_(" * Info: Using %s\n"), base);
+    if (bugz_arguments.output_format != bugz_output_text)
+        bugz_output_headers(&bugz_stdout, 1 << bugz_record_history | 1 << bugz_record_comment |
+                                          1 << bugz_record_delta);
+    interval = bugz_watch_arguments.interval;
+    for (polls = 1; ; polls++) {
+        changed = bugz_watch_poll(curl, headers, url, base, auth ? auth : "", &state);
+        if (polls == 1 && state)
+            fprintf(stderr, N_(" * Info: Watching %d bug(s), every %d to %d seconds ..\n"),
+                            json_object_object_length(state), bugz_watch_arguments.interval,
+                            bugz_watch_arguments.max_interval);
+        if (bugz_watch_arguments.count > 0 && polls >= bugz_watch_arguments.count)
+            break;
+        if (changed > 0)
+            interval = bugz_watch_arguments.interval;
+        else if (polls > 1)
+            interval = interval * 2 < bugz_watch_arguments.max_interval ?
+                       interval * 2 : bugz_watch_arguments.max_interval;
+        if (bugz_arguments.debug)
+            fprintf(stderr, " * Info: next poll in %d seconds\n", interval);
+        sleep(interval);
+    }
+    json_object_put(state);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+    free(bugz_watch_arguments.bugs);
+    free(auth);
+    free(url);
+    return 0;
+}